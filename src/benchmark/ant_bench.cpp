@@ -1,10 +1,64 @@
 
 #include <benchmark/benchmark.h>
+#include <google/protobuf/util/message_differencer.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "app/engine_state.hpp"
 #include "app/facade.hpp"
+#include "engine.pb.h"
+#include "entity/ant.hpp"
+#include "entity/entity_manager.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/compiler.hpp"
+#include "hardware/hardware_manager.hpp"
+#include "hardware/interpreter.hpp"
+#include "hardware/jit.hpp"
+#include "hardware/lockstep.hpp"
+#include "hardware/machine_code.hpp"
+#include "hardware/op_def.hpp"
+#include "hardware/parser.hpp"
+#include "hardware/profiler.hpp"
+#include "hardware/program_executor.hpp"
+#include "hardware/program_image.hpp"
+#include "map/manager.hpp"
+#include "map/map.hpp"
+#include "map/scent_field.hpp"
+#include "map/world.hpp"
+#include "ui/colors.hpp"
+#include "ui/render.hpp"
+#include "utils/serializer.hpp"
+#include "utils/thread_pool.hpp"
+
+static std::string const saves_path = "../assets/saves/";
+
+// Reads a save under assets/saves - false unless it is a whole EngineState.
+// The saves written before the state was a single message have no levels.
+static bool load_save(std::string const& filename,
+                      ant_proto::EngineState& msg) {
+    Unpacker unpacker(saves_path + filename);
+    if(!unpacker.is_valid()) return false;
+    unpacker >> msg;
+    return msg.map_world().levels_size() > 0;
+}
 
 static void run_save(benchmark::State& state, std::string const& filename) {
-    ProjectArguments config("", "../assets/saves/" + filename, false, false, true);
+    // the engine would start a new world in place of a save it can not load
+    ant_proto::EngineState msg;
+    if(!load_save(filename, msg)) {
+        state.SkipWithError("Not an EngineState save");
+        return;
+    }
+    ProjectArguments config("", saves_path + filename, false, false, true);
     AntGameFacade game(config);
     for(auto _ : state) {
         for(ulong i = 0; i < 600; ++i) {
@@ -24,8 +78,1073 @@ static void run_counter(benchmark::State& state) {
 }
 // BENCHMARK(run_small);
 BENCHMARK(run_mid);
-// BENCHMARK(run_counter);
+BENCHMARK(run_counter);
+
+// Pure async program so a single run executes the whole tick budget
+static std::vector<std::string> const compute_program = {
+    "TOP:",    "LOAD A 100", "LOAD B 1", "LOOP:",   "ADD A B", "SUB A B",
+    "COPY B A", "INC B",     "DEC A",    "JNZ LOOP", "JMP TOP",
+};
+static ulong const tick_budget = 499;
+
+static void compile_code(MachineCode const& machine_code, ProgramImage& image,
+                         bool is_optimized = true) {
+    CommandMap command_map;
+    Compiler compiler(command_map);
+    CompileArgs args(machine_code.code, image.instructions);
+    args.is_optimized = is_optimized;
+    compiler.compile(args);
+    image.seal();
+    image.loops = std::move(args.loops);
+    image.is_busy = args.is_busy;
+}
+
+static void compile_program(std::vector<std::string> const& program,
+                            ProgramImage& image, bool is_optimized = true) {
+    CommandMap command_map;
+    Parser parser(command_map);
+    MachineCode machine_code;
+    Status status;
+    parser.parse(program, machine_code, status);
+    compile_code(machine_code, image, is_optimized);
+}
+
+static void compile_compute_program(ProgramImage& image,
+                                    bool is_optimized = true) {
+    compile_program(compute_program, image, is_optimized);
+}
+
+static void interpreter_async(benchmark::State& state) {
+    DualRegisters cpu;
+    ProgramImage image;
+    compile_compute_program(image);
+    for(auto _ : state) {
+        cpu.instr_ptr_register = 0;
+        benchmark::DoNotOptimize(
+            Interpreter::run_async(image, cpu, tick_budget));
+    }
+    state.SetItemsProcessed(state.iterations() * tick_budget);
+}
+BENCHMARK(interpreter_async);
+
+// Same program counted per address by the profiler policy - arg: NoProfiler /
+// AddressProfiler
+static void interpreter_profiled(benchmark::State& state) {
+    DualRegisters cpu;
+    ProgramImage image;
+    compile_compute_program(image);
+    image.profile = std::make_unique<ProgramProfile>(image.size());
+    for(auto _ : state) {
+        cpu.instr_ptr_register = 0;
+        if(state.range(0)) {
+            benchmark::DoNotOptimize(Interpreter::run_async<AddressProfiler>(
+                image, cpu, tick_budget));
+        } else {
+            benchmark::DoNotOptimize(
+                Interpreter::run_async<NoProfiler>(image, cpu, tick_budget));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tick_budget);
+}
+BENCHMARK(interpreter_profiled)->Arg(0)->Arg(1);
+
+// Same program run as native code with the interpreter finishing the run
+static void jit_async(benchmark::State& state) {
+    DualRegisters cpu;
+    ProgramImage image;
+    compile_compute_program(image);
+    image.jit = JitProgram::compile(image);
+    if(!image.jit) {
+        state.SkipWithError("No jit for this host");
+        return;
+    }
+    for(auto _ : state) {
+        cpu.instr_ptr_register = 0;
+        ulong const executed = image.jit->run(cpu, tick_budget);
+        benchmark::DoNotOptimize(
+            Interpreter::run_async(image, cpu, tick_budget - executed));
+    }
+    state.SetItemsProcessed(state.iterations() * tick_budget);
+}
+BENCHMARK(jit_async);
+
+// Ants sharing the compute program, each run on its own or the whole batch
+// in lockstep - arg: lockstep off / on
+static void lockstep_async(benchmark::State& state) {
+    ulong const num_ants = 1024;
+    ulong const instr_clock = 0;
+    ProgramImage image;
+    compile_compute_program(image);
+    std::vector<DualRegisters> cpus(num_ants);
+    std::vector<std::unique_ptr<ProgramExecutor>> execs;
+    std::vector<ProgramExecutor*> batch;
+    for(DualRegisters& cpu : cpus) {
+        execs.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, tick_budget + 1, cpu));
+        execs.back()->image = &image;
+        batch.push_back(execs.back().get());
+    }
+
+    ulong executed = 0;
+    for(auto _ : state) {
+        for(DualRegisters& cpu : cpus) cpu.instr_ptr_register = 0;
+        if(state.range(0)) {
+            executed = Lockstep::run(batch.data(), num_ants);
+        } else {
+            executed = 0;
+            for(ProgramExecutor* exec : batch) {
+                exec->reset();
+                executed += exec->execute_async();
+            }
+        }
+        benchmark::DoNotOptimize(cpus.data());
+    }
+    state.SetItemsProcessed(state.iterations() * executed);
+}
+BENCHMARK(lockstep_async)->Arg(0)->Arg(1);
+
+// The program of the count save - a countdown from 10000 before each MOVE, so
+// it spends the whole budget of about 40 ticks per move in a counted loop.
+// Each iteration is one tick and steps the MOVE it stops at - arg: optimizer
+// off / on. Reports if the program was flagged busy and the ticks per move.
+static void count_save_async(benchmark::State& state) {
+    ant_proto::EngineState msg;
+    if(!load_save("count", msg)) {
+        state.SkipWithError("Not an EngineState save");
+        return;
+    }
+    CommandMap command_map;
+    SoftwareManager software_manager(msg.software_manger(), command_map);
+    DualRegisters cpu;
+    ProgramImage image;
+    compile_code(software_manager[0], image, state.range(0));
+
+    ulong executed = 0, moves = 0;
+    for(auto _ : state) {
+        executed += Interpreter::run_async(image, cpu, tick_budget);
+        if(image.instructions[cpu.instr_ptr_register].num_ticks == 0) continue;
+        Interpreter::step(image.instructions.data(), cpu);
+        ++moves;
+    }
+    state.SetItemsProcessed(executed);
+    state.counters["busy"] = image.is_busy;
+    state.counters["ticks_per_move"] =
+        moves ? double(state.iterations()) / moves : 0.0;
+}
+BENCHMARK(count_save_async)->Arg(0)->Arg(1);
+
+// The dispatch used before the interpreter - one type erased closure per
+// instruction with the instruction pointer checked around every call
+static void legacy_function_async(benchmark::State& state) {
+    DualRegisters cpu;
+    ProgramImage image;
+    compile_compute_program(image, false);
+    std::vector<Instruction> const& instructions = image.instructions;
+
+    std::vector<std::function<void()>> ops;
+    for(Instruction const& instr : instructions) {
+        switch(static_cast<CommandEnum>(instr.command)) {
+#define LEGACY_OP(command, T)                                   \
+    case CommandEnum::command:                                  \
+        ops.push_back([&cpu, instr]() { T::exec(cpu, instr); }); \
+        break;
+            FOR_EACH_OP(LEGACY_OP)
+#undef LEGACY_OP
+        }
+    }
+
+    for(auto _ : state) {
+        cpu.instr_ptr_register = 0;
+        for(ulong i = 0; i < tick_budget && cpu.instr_ptr_register < ops.size();
+            ++i) {
+            if(instructions[cpu.instr_ptr_register].num_ticks != 0) break;
+            ops[cpu.instr_ptr_register]();
+            ++cpu.instr_ptr_register;
+        }
+        benchmark::DoNotOptimize(cpu.registers);
+    }
+    state.SetItemsProcessed(state.iterations() * tick_budget);
+}
+BENCHMARK(legacy_function_async);
+
+// Counted loops and register shuffles up to a sync point so the source
+// instructions per run are fixed - arg: optimizer on / off
+static std::vector<std::string> const counted_loop_program = {
+    "LOAD A 200", "COPY A B", "LOOP:",     "INC B", "DEC A", "JNZ LOOP",
+    "LOAD A 4",   "INNER:",   "SUB A B",   "JNZ INNER", "JMP TURN", "TURN:",
+    "LT",         "MOVE",
+};
+
+static void interpreter_counted_loop(benchmark::State& state) {
+    DualRegisters cpu;
+    ProgramImage plain;
+    ProgramImage image;
+    compile_program(counted_loop_program, plain, false);
+    compile_program(counted_loop_program, image, state.range(0));
+    ulong const source_instructions = Interpreter::run_async(
+        plain.instructions.data(), plain.size(), cpu, -1UL);
+    // stepping does not fast forward so this counts every dispatch of the
+    // optimized code
+    cpu.instr_ptr_register = 0;
+    ulong dispatched = 0;
+    for(; image.instructions[cpu.instr_ptr_register].num_ticks == 0;
+        ++dispatched)
+        Interpreter::step(image.instructions.data(), cpu);
+
+    for(auto _ : state) {
+        cpu.instr_ptr_register = 0;
+        benchmark::DoNotOptimize(Interpreter::run_async(image, cpu, -1UL));
+        Interpreter::step(image.instructions.data(), cpu);
+        benchmark::DoNotOptimize(cpu.registers);
+    }
+    state.SetItemsProcessed(state.iterations() * source_instructions);
+    state.counters["dispatched"] = dispatched;
+}
+BENCHMARK(interpreter_counted_loop)->Arg(0)->Arg(1);
+
+// Superinstructions are charged both of their source instructions and a
+// threaded JMP the JMPs it skips so the optimized program ends every tick where
+// the unoptimized one does. The optimized image runs on the interpreter, the
+// native code and in lockstep - arg: 0 / 1 / 2 - and after every tick each ant
+// has to be on the same instruction with the same registers and flags as with
+// the unoptimized image.
+static std::vector<std::vector<std::string>> const fused_budget_programs = {
+    {"LOAD A 0", "LOAD B 777", "L:", "ADD B B", "DEC A", "INC A", "JNZ L"},
+    {"TOP:", "LOAD A 3", "L:", "DEC A", "JNZ L", "LT", "MOVE", "RT", "DIG",
+     "LOAD B 5", "COPY B A", "SUB A B", "JNZ TOP", "JMP TOP"},
+    compute_program,
+    counted_loop_program,
+    // a chain of JMPs long enough to cross the budget in most ticks, closed
+    // by a jump back into the chain after it was threaded
+    {"INC A", "JMP J1", "J3:", "JMP J4", "J1:", "JMP J2", "J2:", "JMP J3",
+     "J4:", "INC B", "JMP J1"},
+    // a branch into a chain that closes the loop and one that ends on a move
+    {"TOP:", "LOAD A 5", "L:", "DEC A", "JNZ J1", "JMP J2", "J1:", "JMP L",
+     "J2:", "JMP J3", "J3:", "MOVE", "JMP TOP"},
+    // a cycle of JMPs is threaded up to the longest length
+    {"INC A", "X:", "JMP Y", "Y:", "JMP X"},
+};
+
+// Ticks the executors of every ant in a program image
+class FusedTicks {
+   public:
+    FusedTicks(ProgramImage const& image, ulong budget, bool is_lockstep,
+               ulong num_ants)
+        : is_lockstep(is_lockstep), cpus(num_ants) {
+        for(DualRegisters& cpu : cpus) {
+            execs.push_back(
+                std::make_unique<ProgramExecutor>(instr_clock, budget, cpu));
+            execs.back()->image = &image;
+            batch.push_back(execs.back().get());
+        }
+    }
+
+    void tick() {
+        if(is_lockstep) {
+            Lockstep::run(batch.data(), batch.size());
+        } else {
+            for(ProgramExecutor* exec : batch) {
+                exec->reset();
+                exec->execute_async();
+            }
+        }
+        for(ProgramExecutor* exec : batch) exec->execute_sync();
+        ++instr_clock;
+    }
+
+    DualRegisters const& operator[](size_t ant) const { return cpus[ant]; }
+
+   private:
+    bool const is_lockstep;
+    ulong instr_clock = 0;
+    std::vector<DualRegisters> cpus;
+    std::vector<std::unique_ptr<ProgramExecutor>> execs;
+    std::vector<ProgramExecutor*> batch;
+};
+
+static bool is_same_tick_end(DualRegisters const& a, DualRegisters const& b) {
+    return a.instr_ptr_register == b.instr_ptr_register &&
+           a.registers[0] == b.registers[0] &&
+           a.registers[1] == b.registers[1] && a.zero_flag == b.zero_flag &&
+           a.instr_trigger == b.instr_trigger && a.dir_flag1 == b.dir_flag1 &&
+           a.dir_flag2 == b.dir_flag2 && a.is_move_flag == b.is_move_flag &&
+           a.is_dig_flag == b.is_dig_flag;
+}
+
+static void fused_budget_parity(benchmark::State& state) {
+    ulong const mode = state.range(0);
+    std::vector<std::unique_ptr<ProgramImage>> plain, fused;
+    for(auto const& program : fused_budget_programs) {
+        plain.push_back(std::make_unique<ProgramImage>());
+        fused.push_back(std::make_unique<ProgramImage>());
+        compile_program(program, *plain.back(), false);
+        compile_program(program, *fused.back());
+        if(mode == 1) fused.back()->jit = JitProgram::compile(*fused.back());
+    }
+    if(mode == 1 && !fused.front()->jit) {
+        state.SkipWithError("No jit for this host");
+        return;
+    }
+
+    ulong const num_ants = 8;  // enough for one lockstep group
+    ulong checked = 0;
+    for(auto _ : state) {
+        for(size_t i = 0; i < plain.size(); ++i) {
+            for(ulong budget = 2; budget < 40; ++budget) {
+                FusedTicks expected(*plain[i], budget, false, num_ants);
+                FusedTicks ticks(*fused[i], budget, mode == 2, num_ants);
+                for(ulong tick = 0; tick < 64; ++tick) {
+                    expected.tick();
+                    ticks.tick();
+                    for(ulong ant = 0; ant < num_ants; ++ant) {
+                        if(is_same_tick_end(expected[ant], ticks[ant]))
+                            continue;
+                        state.SkipWithError(
+                            ("Fused program " + std::to_string(i) +
+                             " diverged at budget " + std::to_string(budget) +
+                             " tick " + std::to_string(tick))
+                                .c_str());
+                        return;
+                    }
+                    ++checked;
+                }
+            }
+        }
+    }
+    state.counters["checked"] = checked;
+}
+BENCHMARK(fused_budget_parity)->Arg(0)->Arg(1)->Arg(2);
+
+// Names the first part of the two states that differs - empty if they match.
+// The registers and positions of the ants and the maps they dig are checked
+// level by level.
+static std::string find_state_mismatch(ant_proto::EngineState const& a,
+                                       ant_proto::EngineState const& b) {
+    using google::protobuf::util::MessageDifferencer;
+    auto const& a_levels = a.map_world().levels();
+    auto const& b_levels = b.map_world().levels();
+    if(a_levels.size() != b_levels.size()) return "levels";
+    for(int depth = 0; depth < a_levels.size(); ++depth) {
+        auto const& a_workers = a_levels[depth].workers();
+        auto const& b_workers = b_levels[depth].workers();
+        std::string const level = "level " + std::to_string(depth);
+        if(a_workers.size() != b_workers.size()) return level + " workers";
+        for(int i = 0; i < a_workers.size(); ++i) {
+            std::string const ant = level + " ant " + std::to_string(i);
+            if(!MessageDifferencer::Equals(a_workers[i].dual_registers(),
+                                           b_workers[i].dual_registers()))
+                return ant + " registers";
+            if(!MessageDifferencer::Equals(a_workers[i], b_workers[i]))
+                return ant;
+        }
+        if(!MessageDifferencer::Equals(a_levels[depth].map(),
+                                       b_levels[depth].map()))
+            return level + " map";
+    }
+    return MessageDifferencer::Equals(a, b) ? "" : "engine state";
+}
+
+// Every EngineState save runs under the interpreter and with --jit. After each
+// tick the two have to agree on the registers of every ant and on the map.
+static void jit_save_parity(benchmark::State& state) {
+    ProgramImage probe;
+    compile_program({"INC A"}, probe);
+    if(!JitProgram::compile(probe)) {
+        state.SkipWithError("No jit for this host");
+        return;
+    }
+    std::vector<std::string> saves;
+    for(auto const& entry : std::filesystem::directory_iterator(saves_path))
+        saves.push_back(entry.path().filename().string());
+    std::sort(saves.begin(), saves.end());
+
+    // one thread so any difference comes from the native code
+    char const* interpreted_args[] = {"ants", "--threads", "1"};
+    char const* jit_args[] = {"ants", "--threads", "1", "--jit"};
+    ProjectArguments interpreted_config(3,
+                                        const_cast<char**>(interpreted_args));
+    ProjectArguments jit_config(4, const_cast<char**>(jit_args));
+    NoneRenderer renderer;
+    ulong checked = 0;
+    for(auto _ : state) {
+        for(std::string const& save : saves) {
+            ant_proto::EngineState msg;
+            if(!load_save(save, msg)) continue;
+            EngineState interpreted(msg, interpreted_config, &renderer);
+            EngineState jit(msg, jit_config, &renderer);
+            for(ulong tick = 0; tick < 200; ++tick) {
+                interpreted.tick();
+                jit.tick();
+                std::string const mismatch = find_state_mismatch(
+                    interpreted.get_proto(), jit.get_proto());
+                if(mismatch.empty()) {
+                    ++checked;
+                    continue;
+                }
+                state.SkipWithError((save + " diverged at tick " +
+                                     std::to_string(tick) + " - " + mismatch)
+                                        .c_str());
+                return;
+            }
+        }
+    }
+    state.counters["checked"] = checked;
+}
+BENCHMARK(jit_save_parity);
+
+// Generated program of about n lines like the program search emits - a label
+// every 8 lines and a jump to the one before it
+static void generate_program(ulong num_lines,
+                             std::vector<std::string>& program) {
+    static std::vector<std::string> const body = {
+        "LOAD A 17", "ADD A B", "DEC A", "PUSH B", "POP A", "SWP B -3", "CHK",
+    };
+    program.clear();
+    for(ulong i = 0; program.size() < num_lines; ++i) {
+        program.push_back("L" + std::to_string(i) + ":");
+        for(std::string const& line : body) program.push_back("    " + line);
+        program.push_back("JNZ L" + std::to_string(i / 2));
+    }
+}
+
+// Source lines to machine code - arg: lines
+static void assemble_program(benchmark::State& state) {
+    CommandMap command_map;
+    Parser parser(command_map);
+    std::vector<std::string> program;
+    generate_program(state.range(0), program);
+    for(auto _ : state) {
+        MachineCode machine_code;
+        Status status;
+        parser.parse(program, machine_code, status);
+        benchmark::DoNotOptimize(machine_code.code.data());
+    }
+    state.SetItemsProcessed(state.iterations() * program.size());
+}
+BENCHMARK(assemble_program)->Arg(100)->Arg(10000);
+
+// Machine code back to source lines - arg: lines
+static void deparse_program(benchmark::State& state) {
+    CommandMap command_map;
+    Parser parser(command_map);
+    std::vector<std::string> program, lines;
+    generate_program(state.range(0), program);
+    MachineCode machine_code;
+    Status status;
+    parser.parse(program, machine_code, status);
+    for(auto _ : state) {
+        lines.clear();
+        parser.deparse(machine_code, lines, status);
+        benchmark::DoNotOptimize(lines.data());
+    }
+    state.SetItemsProcessed(state.iterations() * program.size());
+}
+BENCHMARK(deparse_program)->Arg(100)->Arg(10000);
+
+// Spawn cost and program memory of n workers running the same program
+static std::vector<std::string> const worker_program = {
+    "TOP:",    "DIG",  "MOVE", "LT",  "DIG",     "MOVE", "RT",  "CHK",
+    "JNF TOP", "LOAD A 3", "LOOP:", "DEC A", "JNZ LOOP", "RT", "JMP TOP",
+};
+
+static void parse_worker_program(MachineCode& machine_code) {
+    CommandMap command_map;
+    Parser parser(command_map);
+    Status status;
+    parser.parse(worker_program, machine_code, status);
+}
+
+// Previous behaviour - every worker compiles its own copy of the program
+static void spawn_compile_per_ant(benchmark::State& state) {
+    CommandMap command_map;
+    Compiler compiler(command_map);
+    MachineCode machine_code;
+    parse_worker_program(machine_code);
+
+    std::vector<std::vector<Instruction>> programs(state.range(0));
+    for(auto _ : state) {
+        for(auto& instructions : programs) {
+            instructions.clear();
+            CompileArgs args(machine_code.code, instructions);
+            compiler.compile(args);
+        }
+        benchmark::DoNotOptimize(programs.data());
+    }
+    state.counters["bytes_per_ant"] =
+        sizeof(std::vector<Instruction>) +
+        programs[0].size() * sizeof(Instruction);
+}
+BENCHMARK(spawn_compile_per_ant)->Arg(100)->Arg(10000);
+
+static void spawn_shared_image(benchmark::State& state) {
+    CommandMap command_map;
+    MachineCode machine_code;
+    parse_worker_program(machine_code);
+
+    std::vector<ProgramImage const*> programs(state.range(0));
+    ulong const instr_clock = 0;
+    for(auto _ : state) {
+        HardwareManager hardware_manager(command_map, instr_clock);
+        for(auto& image : programs) {
+            image = hardware_manager.compile(machine_code);
+        }
+        benchmark::DoNotOptimize(programs.data());
+    }
+    state.counters["bytes_per_ant"] = sizeof(ProgramImage const*);
+}
+BENCHMARK(spawn_shared_image)->Arg(100)->Arg(10000);
+
+// Code cut inside an instruction and opcodes past the last command are
+// rejected through the status. Every cut of the worker program is compiled.
+static void compile_rejects_bad_code(benchmark::State& state) {
+    std::vector<std::string> program = worker_program;
+    program.push_back("SWP B -3");
+    CommandMap command_map;
+    Parser parser(command_map);
+    Compiler compiler(command_map);
+    MachineCode machine_code;
+    Status status;
+    parser.parse(program, machine_code, status);
+    std::vector<uchar> const& code = machine_code.code;
+
+    // the operand bytes after each opcode
+    std::vector<bool> is_operand(code.size(), false);
+    for(size_t at = 0; at < code.size();) {
+        CommandEnum const command = static_cast<CommandEnum>(code[at] >> 3);
+        size_t operands = 0;
+        if(command == CommandEnum::LOAD) operands = 4;
+        if(command == CommandEnum::JMP || command == CommandEnum::JNZ ||
+           command == CommandEnum::JNF || command == CommandEnum::CALL)
+            operands = 2;
+        if(command == CommandEnum::SET_SCENT_PRIORITY) operands = 1;
+        for(size_t i = 1; i <= operands; ++i) is_operand[at + i] = true;
+        at += operands + 1;
+    }
+
+    ulong rejected = 0;
+    for(auto _ : state) {
+        for(size_t size = 1; size < code.size(); ++size) {
+            if(!is_operand[size]) continue;
+            std::vector<uchar> const cut(code.begin(), code.begin() + size);
+            std::vector<Instruction> instructions;
+            CompileArgs args(cut, instructions);
+            compiler.compile(args);
+            if(!args.status.p_err) {
+                state.SkipWithError(("Code cut to " + std::to_string(size) +
+                                     " bytes compiled")
+                                        .c_str());
+                return;
+            }
+            ++rejected;
+        }
+        for(uchar opcode = CommandEnum::TURN_SCENT + 1; opcode < 32; ++opcode) {
+            std::vector<uchar> const unknown = {uchar(opcode << 3)};
+            std::vector<Instruction> instructions;
+            CompileArgs args(unknown, instructions);
+            compiler.compile(args);
+            if(!args.status.p_err) {
+                state.SkipWithError(("Opcode " + std::to_string(opcode) +
+                                     " compiled")
+                                        .c_str());
+                return;
+            }
+            ++rejected;
+        }
+    }
+    state.counters["rejected"] = rejected;
+}
+BENCHMARK(compile_rejects_bad_code);
+
+// Loading a save - one machine code per ant drawn from a few distinct
+// programs - args: ants, distinct programs, threads
+static void load_compile_all(benchmark::State& state) {
+    CommandMap command_map;
+    Parser parser(command_map);
+    std::vector<MachineCode> distinct(state.range(1));
+    for(ulong i = 0; i < distinct.size(); ++i) {
+        std::vector<std::string> program = worker_program;
+        program.push_back("LOAD B " + std::to_string(i));
+        Status status;
+        parser.parse(program, distinct[i], status);
+    }
+    std::vector<MachineCode const*> codes(state.range(0));
+    for(ulong i = 0; i < codes.size(); ++i)
+        codes[i] = &distinct[i % distinct.size()];
+
+    std::vector<ProgramImage const*> images;
+    ulong const instr_clock = 0;
+    ThreadPool<PoolJob> job_pool(state.range(2));
+    for(auto _ : state) {
+        HardwareManager hardware_manager(command_map, instr_clock);
+        hardware_manager.compile_all(codes, images, job_pool);
+        benchmark::DoNotOptimize(images.data());
+    }
+    state.SetItemsProcessed(state.iterations() * codes.size());
+}
+BENCHMARK(load_compile_all)
+    ->Args({50000, 1, 1})
+    ->Args({50000, 64, 1})
+    ->Args({50000, 64, 8})
+    ->UseRealTime();
+
+// Swapping every ant between two versions of the program at a tick boundary
+// and running the tick - args: ants
+static void hardware_swap(benchmark::State& state) {
+    ulong const num_ants = state.range(0);
+    CommandMap command_map;
+    Parser parser(command_map);
+    ulong instr_clock = 0;
+    HardwareManager hardware_manager(command_map, instr_clock);
+    ThreadPool<PoolJob> job_pool(1);
+    MachineCode versions[2];
+    parse_worker_program(versions[0]);
+    std::vector<std::string> edited = worker_program;
+    edited.insert(edited.begin() + 4, "LOAD B 1");
+    Status status;
+    parser.parse(edited, versions[1], status);
+    ProgramImage const* image = hardware_manager.compile(versions[0]);
+
+    std::vector<DualRegisters> cpus(num_ants);
+    std::vector<ProgramExecutor> execs;
+    std::vector<ProgramExecutor*> exec_ptrs;
+    execs.reserve(num_ants);
+    for(DualRegisters& cpu : cpus) {
+        execs.emplace_back(instr_clock, 500, cpu);
+        execs.back().image = image;
+        hardware_manager.push_back(&execs.back());
+        exec_ptrs.push_back(&execs.back());
+    }
+
+    ulong version = 0;
+    for(auto _ : state) {
+        version ^= 1;
+        hardware_manager.swap(exec_ptrs, versions[version]);
+        ++instr_clock;
+        hardware_manager.execute_async(job_pool);
+        hardware_manager.execute_sync();
+    }
+    state.SetItemsProcessed(state.iterations() * num_ants);
+}
+BENCHMARK(hardware_swap)->Arg(10000);
+
+// Submit and await one tick worth of small jobs - args: jobs, threads
+struct SpinJob {
+    ulong iterations;
+    void run() {
+        for(ulong i = 0; i < iterations; ++i) benchmark::ClobberMemory();
+    }
+};
+
+static void thread_pool_tick(benchmark::State& state) {
+    ThreadPool<SpinJob> pool(state.range(1));
+    for(auto _ : state) {
+        for(long i = 0; i < state.range(0); ++i) {
+            SpinJob job{500};
+            pool.submit_job(job);
+        }
+        pool.await_jobs();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(thread_pool_tick)
+    ->Args({100, 1})
+    ->Args({100, 8})
+    ->Args({10000, 1})
+    ->Args({10000, 8})
+    ->UseRealTime();
+
+// VM side of a tick without the map - args: ants, threads
+static void hardware_tick(benchmark::State& state) {
+    ulong const num_ants = state.range(0);
+    CommandMap command_map;
+    ulong instr_clock = 0;
+    HardwareManager hardware_manager(command_map, instr_clock);
+    ThreadPool<PoolJob> job_pool(state.range(1));
+    MachineCode machine_code;
+    parse_worker_program(machine_code);
+    ProgramImage const* image = hardware_manager.compile(machine_code);
+
+    std::vector<DualRegisters> cpus(num_ants);
+    std::vector<ProgramExecutor> execs;
+    execs.reserve(num_ants);
+    for(DualRegisters& cpu : cpus) {
+        execs.emplace_back(instr_clock, 500, cpu);
+        execs.back().image = image;
+        hardware_manager.push_back(&execs.back());
+    }
+
+    for(auto _ : state) {
+        ++instr_clock;
+        hardware_manager.execute_async(job_pool);
+        hardware_manager.execute_sync();
+    }
+    state.SetItemsProcessed(state.iterations() * num_ants);
+}
+BENCHMARK(hardware_tick)
+    ->ArgsProduct({{100, 1000, 10000, 100000}, {1, 8}})
+    ->UseRealTime();
+
+// VM side of a tick over heap allocated workers, which is how the game lays
+// them out, with the bytes per ant of each part - arg: ants
+static void worker_tick(benchmark::State& state) {
+    ulong const num_ants = state.range(0);
+    CommandMap command_map;
+    ItemInfoMap item_info_map;
+    ulong instr_clock = 0;
+    HardwareManager hardware_manager(command_map, instr_clock);
+    ThreadPool<PoolJob> job_pool(1);
+    MachineCode machine_code;
+    parse_worker_program(machine_code);
+    ProgramImage const* image = hardware_manager.compile(machine_code);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for(ulong i = 0; i < num_ants; ++i) {
+        workers.emplace_back(
+            new Worker(EntityData('w', 10, color::light_green), instr_clock,
+                       item_info_map));
+        workers.back()->program_executor.image = image;
+        hardware_manager.push_back(&workers.back()->program_executor);
+    }
+
+    for(auto _ : state) {
+        ++instr_clock;
+        hardware_manager.execute_async(job_pool);
+        hardware_manager.execute_sync();
+    }
+    state.SetItemsProcessed(state.iterations() * num_ants);
+    state.counters["bytes_per_ant"] = sizeof(Worker);
+    state.counters["cpu_hot_bytes"] = DualRegisters::hot_size();
+    state.counters["cpu_bytes"] = sizeof(DualRegisters);
+    state.counters["executor_bytes"] = sizeof(ProgramExecutor);
+    state.counters["inventory_bytes"] = sizeof(Inventory);
+}
+BENCHMARK(worker_tick)->Arg(10000)->Arg(100000);
+
+// Tile lookups over an already generated square of the map - arg: side length
+static void map_tile_lookup(benchmark::State& state) {
+    long const half = state.range(0) / 2;
+    Map map(true, [](long, long) {});
+    map.dig(-half, -half, half - 1, half - 1);
+
+    for(auto _ : state) {
+        ulong walls = 0;
+        for(long y = -half; y < half; ++y) {
+            for(long x = -half; x < half; ++x) walls += map.is_wall(x, y);
+        }
+        benchmark::DoNotOptimize(walls);
+    }
+    state.SetItemsProcessed(state.iterations() * 4 * half * half);
+}
+BENCHMARK(map_tile_lookup)->Arg(64)->Arg(1024);
+
+// The lookup used before the chunk table - node based map of heap chunks
+static void legacy_map_tile_lookup(benchmark::State& state) {
+    long const half = state.range(0) / 2;
+    Chunks ids;
+    std::unordered_map<ulong, Chunk*> chunks;
+    for(long y = -half; y < half; y += globals::CHUNK_LENGTH) {
+        for(long x = -half; x < half; x += globals::CHUNK_LENGTH) {
+            chunks.emplace(ids.get_chunk_id(x, y),
+                           new Chunk(ids.align(x), ids.align(y), false));
+        }
+    }
+
+    for(auto _ : state) {
+        ulong walls = 0;
+        for(long y = -half; y < half; ++y) {
+            for(long x = -half; x < half; ++x) {
+                Chunk& chunk = *chunks[ids.get_chunk_id(x, y)];
+                long idx = (x - chunk.x) + (y - chunk.y) * 8;
+                walls += (chunk.is_wall >> idx) & 1;
+            }
+        }
+        benchmark::DoNotOptimize(walls);
+    }
+    state.SetItemsProcessed(state.iterations() * 4 * half * half);
+    for(auto& [chunk_id, chunk] : chunks) delete chunk;
+}
+BENCHMARK(legacy_map_tile_lookup)->Arg(64)->Arg(1024);
+
+// Entity without any behaviour
+struct BenchEntity : public MapEntity {
+    EntityData data;
 
+    BenchEntity(long x, long y) : data(x, y, 'b', 0, color::white) {}
+    EntityData& get_data() override { return data; }
+    void move_callback(EntityMoveUpdate const&) override {}
+    void click_callback(long, long) override {}
+    MapEntityType get_type() const override { return WORKER; }
+};
 
+// Entities on a dug out square from the origin to (size, size), added to the
+// map. The map generates no features so every run measures the same tiles.
+struct BenchMap {
+    Map map;
+    std::vector<BenchEntity> entities;
+
+    // the entities two tiles apart in rows of sqrt(num_entities) + 1, so some
+    // sit on chunk borders
+    explicit BenchMap(long num_entities)
+        : BenchMap(2 * grid_row(num_entities) + 1, num_entities,
+                   [row = grid_row(num_entities)](long i) {
+                       return std::pair(1 + 2 * (i % row), 1 + 2 * (i / row));
+                   }) {}
+
+    // the entity i at place(i)
+    template <class Place>
+    BenchMap(long size, long num_entities, Place place)
+        : map(true, [](long, long) {}) {
+        map.dig(0, 0, size, size);
+        entities.reserve(num_entities);
+        for(long i = 0; i < num_entities; ++i) {
+            auto [x, y] = place(i);
+            entities.emplace_back(x, y);
+        }
+        for(BenchEntity& entity : entities) map.add_entity(entity);
+    }
+
+   private:
+    static long grid_row(long num_entities) {
+        return std::sqrt(num_entities) + 1;
+    }
+};
+
+// A generated world with the game components wired as in the engine state
+// minus the rendering and the software manager - the seed is fixed so every
+// run measures the same map
+struct BenchWorld {
+    static constexpr ulong seed = 1234;
+    ProjectArguments config;
+    ThreadPool<PoolJob> job_pool;
+    MapWorld map_world;
+    MapManager map_manager;
+    EntityManager entity_manager;
+    CommandMap command_map;
+    HardwareManager hardware_manager;
+
+    explicit BenchWorld(bool is_walls_enabled)
+        : config("", "", false, false, is_walls_enabled),
+          job_pool(config.num_threads),
+          map_world(Rect(0, 0, globals::COLS, globals::ROWS),
+                    is_walls_enabled, seed),
+          map_manager(globals::COLS * 2, globals::ROWS * 2, config, map_world),
+          entity_manager(map_manager, map_world,
+                         map_world.current_level().start_info->player_x,
+                         map_world.current_level().start_info->player_y),
+          hardware_manager(command_map, map_world.instr_action_clock) {}
+
+    ~BenchWorld() {
+        for(Level& level : map_world.levels) {
+            for(Worker* worker : level.workers) delete worker;
+        }
+    }
+
+    // Places the ants two tiles apart on a dug out square next to the player,
+    // spread round robin over the first num_levels levels
+    void spawn(ulong num_ants, ulong num_levels,
+               std::vector<std::string> const& program) {
+        Parser parser(command_map);
+        MachineCode machine_code;
+        Status status;
+        parser.parse(program, machine_code, status);
+
+        long const per_level = (num_ants + num_levels - 1) / num_levels;
+        long const per_row = std::sqrt(per_level) + 1;
+        long const x0 = entity_manager.player.data.x + 2;
+        long const y0 = entity_manager.player.data.y + 2;
+        for(ulong depth = 0; depth < num_levels; ++depth) {
+            map_world.levels[depth].map.dig(x0, y0, x0 + 2 * per_row,
+                                            y0 + 2 * per_row);
+        }
+
+        for(ulong i = 0; i < num_ants; ++i) {
+            Level& level = map_world.levels[i % num_levels];
+            long const level_idx = i / num_levels;
+            Worker* worker = entity_manager.create_worker_data();
+            worker->data.x = x0 + 2 * (level_idx % per_row);
+            worker->data.y = y0 + 2 * (level_idx / per_row);
+            entity_manager.build_ant(hardware_manager, *worker, machine_code);
+            worker->set_map(level.map);
+            level.map.add_entity(*worker);
+            level.workers.push_back(worker);
+        }
+    }
+};
+
+// One move of every entity per iteration on a dug out square, the entities sit
+// two tiles apart - arg: entities
+static void map_entity_move(benchmark::State& state) {
+    BenchMap bench(state.range(0));
+    Map& map = bench.map;
+    std::vector<BenchEntity>& entities = bench.entities;
+
+    long dy = 1;
+    for(auto _ : state) {
+        for(BenchEntity& entity : entities) map.move_entity(entity, 0, dy);
+        dy = -dy;
+    }
+    state.SetItemsProcessed(state.iterations() * entities.size());
+}
+BENCHMARK(map_entity_move)->Arg(100)->Arg(10000);
+
+// Rows of entities shoulder to shoulder stepping together, so every move but
+// the head of a row waits on the entity in front - arg: entities
+static void map_move_batch(benchmark::State& state) {
+    long const per_row = 32;
+    long const rows = (state.range(0) + per_row - 1) / per_row;
+    BenchMap bench(std::max(per_row + 2, 2 * rows + 1), state.range(0),
+                   [](long i) {
+                       return std::pair(1 + i % per_row, 1 + 2 * (i / per_row));
+                   });
+    Map& map = bench.map;
+    std::vector<BenchEntity>& entities = bench.entities;
+    std::vector<MoveIntent> intents;
+    for(ulong i = 0; i < entities.size(); ++i)
+        intents.push_back({&entities[i], 0, 0, i, true});
+
+    long dx = 1;
+    for(auto _ : state) {
+        for(MoveIntent& intent : intents) intent.dx = dx;
+        map.move_entities(intents.data(), intents.size());
+        dx = -dx;
+    }
+    state.SetItemsProcessed(state.iterations() * entities.size());
+}
+BENCHMARK(map_move_batch)->Arg(100)->Arg(10000);
+
+// What a CHECK of every entity reads on a dug out square with the entities two
+// tiles apart, so some sit on chunk borders - arg: entities
+static void map_empty_neighbours(benchmark::State& state) {
+    BenchMap bench(state.range(0));
+    Map& map = bench.map;
+    std::vector<BenchEntity>& entities = bench.entities;
+
+    for(auto _ : state) {
+        ulong empty = 0;
+        for(BenchEntity& entity : entities)
+            empty += map.empty_neighbours(entity.data.x, entity.data.y);
+        benchmark::DoNotOptimize(empty);
+    }
+    state.SetItemsProcessed(state.iterations() * entities.size());
+}
+BENCHMARK(map_empty_neighbours)->Arg(100)->Arg(10000);
+
+// One chunk of scents spreading into and out of its four neighbours
+static void scent_field_step(benchmark::State& state) {
+    std::array<ScentField::Plane, 5> planes;
+    for(ulong i = 0; i < planes.size(); ++i) {
+        for(long idx = 0; idx < globals::CHUNK_AREA; ++idx)
+            planes[i][idx] = (idx * 0x9E3779B97F4A7C15UL) >> i;
+    }
+    ScentField::Neighbours neighbours;
+    for(ulong side = 0; side < neighbours.planes.size(); ++side)
+        neighbours.planes[side] = &planes[side + 1];
+
+    ScentField::Plane out;
+    bool is_evaporating = false;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(
+            ScentField::step(planes[0], neighbours, is_evaporating, out));
+        benchmark::ClobberMemory();
+        is_evaporating = !is_evaporating;
+    }
+    state.SetItemsProcessed(state.iterations() * globals::CHUNK_AREA);
+}
+BENCHMARK(scent_field_step);
+
+// A square of chunks with an entity laying scent in the middle of each, so
+// every chunk keeps its plane - arg: chunks per side
+static void map_scent_update(benchmark::State& state) {
+    long const length = globals::CHUNK_LENGTH;
+    long const chunks = state.range(0);
+    BenchMap bench(chunks * length - 1, chunks * chunks, [=](long i) {
+        return std::pair(length / 2 + i % chunks * length,
+                         length / 2 + i / chunks * length);
+    });
+    Map& map = bench.map;
+    std::vector<BenchEntity>& entities = bench.entities;
+
+    ulong tick = 0;
+    for(auto _ : state) {
+        for(BenchEntity& entity : entities) {
+            ulong& scents = map.get_tile_scents(entity);
+            scents = ScentField::add_saturated(scents, 0x4040404040404040);
+        }
+        map.update_scents(++tick);
+    }
+    state.SetItemsProcessed(state.iterations() * entities.size() *
+                            globals::CHUNK_AREA);
+}
+BENCHMARK(map_scent_update)->Arg(4)->Arg(32);
+
+// Ants writing and following scents so the scent planes see every tick
+static std::vector<std::string> const scent_program = {
+    "SWN A", "SWP A 10", "TOP:", "SRT", "DIG", "MOVE", "JMP TOP",
+};
+
+// Program shapes of the world tick matrix
+enum BenchShape : long { ALU_SHAPE, DIG_SHAPE, SCENT_SHAPE };
+
+static std::vector<std::string> const& shape_program(long shape) {
+    switch(shape) {
+        case ALU_SHAPE:
+            return compute_program;
+        case DIG_SHAPE:
+            return worker_program;
+        default:
+            return scent_program;
+    }
+}
+
+// Full game tick on a generated world - args: ants, program shape, walls,
+// levels. Reports the time per tick of each subsystem, the VM time per async
+// instruction and the executors visited per tick.
+static void world_tick(benchmark::State& state) {
+    using std::chrono::steady_clock;
+    ulong const num_ants = state.range(0);
+    BenchWorld world(state.range(2));
+    world.spawn(num_ants, state.range(3), shape_program(state.range(1)));
+    // the first tick generates the chunks around every ant
+    world.entity_manager.update(world.job_pool);
+
+    double entity_seconds = 0;
+    double vm_seconds = 0;
+    ulong instructions = 0;
+    ulong visited = 0;
+    for(auto _ : state) {
+        auto const start = steady_clock::now();
+        world.entity_manager.update(world.job_pool);
+        auto const entity_end = steady_clock::now();
+        world.hardware_manager.execute_async(world.job_pool);
+        visited += world.hardware_manager.num_ready();
+        world.hardware_manager.execute_sync();
+        auto const vm_end = steady_clock::now();
+
+        entity_seconds +=
+            std::chrono::duration<double>(entity_end - start).count();
+        vm_seconds +=
+            std::chrono::duration<double>(vm_end - entity_end).count();
+        instructions += world.hardware_manager.instructions_last_tick();
+    }
+
+    using benchmark::Counter;
+    state.SetItemsProcessed(state.iterations() * num_ants);
+    state.counters["entity_us"] =
+        Counter(entity_seconds * 1e6, Counter::kAvgIterations);
+    state.counters["vm_us"] =
+        Counter(vm_seconds * 1e6, Counter::kAvgIterations);
+    state.counters["instr"] = Counter(instructions, Counter::kAvgIterations);
+    state.counters["visited"] = Counter(visited, Counter::kAvgIterations);
+    state.counters["vm_ns_per_instr"] =
+        instructions ? vm_seconds * 1e9 / instructions : 0;
+}
+BENCHMARK(world_tick)
+    ->ArgsProduct({benchmark::CreateRange(10, 100000, 10),
+                   {ALU_SHAPE, DIG_SHAPE, SCENT_SHAPE},
+                   {0, 1},
+                   {1, 4}})
+    ->ArgNames({"ants", "shape", "walls", "levels"})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
 
 BENCHMARK_MAIN();
@@ -1,6 +1,11 @@
 #include "app/arg_parse.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <thread>
 
 #include "spdlog/spdlog.h"
 // ArgumentParser
@@ -41,11 +46,31 @@ std::string const& ArgumentParser::getString(
     return default_value;
 }
 
-int ArgumentParser::getInt(const std::string& key, int default_value) const {
-    if(hasKey(key)) {
-        return std::stoi(arguments.at(key));
+template <typename T>
+T ArgumentParser::getNumber(const std::string& key, T default_value) const {
+    if(!hasKey(key)) return default_value;
+    std::string const& text = arguments.at(key);
+    T value = default_value;
+    auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if(error != std::errc() || end != text.data() + text.size()) {
+        std::cerr << "Invalid value for --" << key << ": '" << text
+                  << "' - expected a number from "
+                  << std::numeric_limits<T>::min() << " to "
+                  << std::numeric_limits<T>::max()
+                  << ". Run with --help for the options" << std::endl;
+        exit(1);
     }
-    return default_value;
+    return value;
+}
+
+int ArgumentParser::getInt(const std::string& key, int default_value) const {
+    return getNumber(key, default_value);
+}
+
+ulong ArgumentParser::getUlong(const std::string& key,
+                               ulong default_value) const {
+    return getNumber(key, default_value);
 }
 
 double ArgumentParser::getDouble(const std::string& key,
@@ -70,10 +95,19 @@ ProjectArguments::ProjectArguments(int argc, char* argv[])
     : parser(argc, argv),
       default_map_file_path(parser.getString("map_path")),
       save_path(parser.getString("save_path")),
-      is_render(!parser.getBool("no_render", false)),
+      is_render(!parser.getBool("no_render", false) &&
+                !parser.hasKey("headless")),
       is_debug_graphics(parser.getBool("debug_graphics", false)),
       is_walls_enabled(!parser.getBool("disable_walls", false)),
-      no_fov(!parser.getBool("no_fov", false)) {
+      no_fov(!parser.getBool("no_fov", false)),
+      num_threads(
+          std::max(parser.getInt("threads", default_num_threads()), 1)),
+      headless_ticks(std::max(parser.getInt("headless", 0), 0)),
+      out_path(parser.getString("out_path")),
+      is_jit(parser.getBool("jit", false)),
+      is_lockstep(parser.getBool("lockstep", false)),
+      profile_path(parser.getString("profile")),
+      seed(parser.hasKey("seed") ? parser.getUlong("seed") : default_seed()) {
     if(parser.hasKey("help")) {
         help();
         exit(0);
@@ -89,21 +123,53 @@ ProjectArguments::ProjectArguments(std::string const& default_map_file_path,
       save_path(save_path),
       is_render(is_render),
       is_debug_graphics(is_debug_graphics),
-      is_walls_enabled(is_walls_enabled) {
+      is_walls_enabled(is_walls_enabled),
+      num_threads(default_num_threads()),
+      seed(default_seed()) {
     setup_logging();
 }
 
+ulong ProjectArguments::default_num_threads() {
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+ulong ProjectArguments::default_seed() {
+    std::random_device device;
+    return static_cast<ulong>(device()) << 32 | device();
+}
+
 void ProjectArguments::help() const {
     std::cout << "Usage: ants [options]\n";
     std::cout << "Options:\n";
     std::cout << "  --map_path <path>    Path to the map file\n";
-    std::cout << "  --save_path <path>   Path to the file for auto-save\n";
+    std::cout << "  --save_path <path>   Path to the file for auto-save. An "
+                 "existing save is loaded on start\n";
     std::cout
         << "  --no_render          Does not render any graphics for the game\n";
     std::cout << "  --debug_graphics     Add debug graphics to the GUI\n";
     std::cout << "  --no_fov             Everything is in fov\n";
+    std::cout << "  --threads <count>    Total threads the game runs on, the "
+                 "main thread included - one pool runs the ant programs, the "
+                 "moves and the program compiles. default: number of cores\n";
     std::cout
         << "  --disable_walls      The player and ants can traverse walls\n";
+    std::cout
+        << "  --headless <ticks>   Runs the given number of ticks as fast as "
+           "possible without graphics or input then exits. Load a save with "
+           "--save_path - it has to be a state written by --out_path or the "
+           "auto-save key (\\). Of the saves under assets/saves only count "
+           "loads - the others are in an older format\n";
+    std::cout << "  --out_path <path>    File the state is written to after a "
+                 "headless run\n";
+    std::cout << "  --profile <path>     File the program profile is written to "
+                 "after a headless run - needs a PROFILE build\n";
+    std::cout << "  --seed <number>      Seed of the map generation and the "
+                 "ants - the same seed replays the same game. A loaded save "
+                 "keeps its own seed. default: random\n";
+    std::cout << "  --jit                Compiles the ant programs to native "
+                 "code where the host supports it\n";
+    std::cout << "  --lockstep           Runs the ants that share a program "
+                 "and instruction together on vector lanes\n";
     std::cout
         << "  --log_level <level>  Set the runtime log level - options: trace, "
            "debug, info, warn, error, critical, and off. default: info. Note "
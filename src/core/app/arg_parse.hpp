@@ -3,10 +3,15 @@
 #include <map>
 #include <string>
 
+using ulong = unsigned long;
+
 class ArgumentParser {
    private:
     std::map<std::string, std::string> arguments = {};
 
+    template <typename T>
+    T getNumber(const std::string& key, T default_value) const;
+
    public:
     ArgumentParser();
     ArgumentParser(int argc, char* argv[]);
@@ -15,7 +20,10 @@ class ArgumentParser {
 
     std::string const& getString(const std::string& key,
                                  const std::string& default_value = "") const;
+    // the number arguments exit with a usage error unless the whole value
+    // parses and fits the type
     int getInt(const std::string& key, int default_value = 0) const;
+    ulong getUlong(const std::string& key, ulong default_value = 0) const;
     double getDouble(const std::string& key, double default_value = 0.0) const;
     bool getBool(const std::string& key, bool default_value = false) const;
 };
@@ -25,6 +33,8 @@ class ProjectArguments {
     ArgumentParser parser = {};
     void help() const;
     void setup_logging() const;
+    static ulong default_num_threads();
+    static ulong default_seed();
 
    public:
     std::string const default_map_file_path = {};
@@ -33,6 +43,16 @@ class ProjectArguments {
     bool const is_debug_graphics = {};
     bool const is_walls_enabled = {};
     bool const no_fov = {};
+    // size of the one pool the ant programs, the entity updates and the
+    // program compiles run on - includes the main thread
+    ulong const num_threads = {};
+    ulong const headless_ticks = {};  // 0 runs the interactive game
+    std::string const out_path = {};  // state written after a headless run
+    bool const is_jit = {};           // run the ant programs as native code
+    bool const is_lockstep = {};      // run ants sharing a program together
+    // program profile written after a headless run
+    std::string const profile_path = {};
+    ulong const seed = {};  // the world and every ant draw from its streams
     ProjectArguments(int argc, char* argv[]);
     ProjectArguments(std::string const& default_map_file_path,
                      std::string const& save_path, bool is_render,
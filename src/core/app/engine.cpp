@@ -1,11 +1,36 @@
 #include "app/engine.hpp"
 
+#include <chrono>
+#include <fstream>
+
 #include "app/arg_parse.hpp"
 #include "app/engine_state.hpp"
 #include "engine.pb.h"
 #include "spdlog/spdlog.h"
 #include "ui/render.hpp"
 
+namespace {
+    // The saves written before the state became a single EngineState message
+    // parse into one without any levels
+    bool is_loadable(ant_proto::EngineState const& msg,
+                     std::string const& path) {
+        ant_proto::MapWorld const& map_world = msg.map_world();
+        if(map_world.levels_size() == 0) {
+            SPDLOG_ERROR("Save '{}' has no levels - it is not an EngineState "
+                         "written by --out_path or the auto-save",
+                         path);
+            return false;
+        }
+        if(map_world.current_depth() >= ulong(map_world.levels_size())) {
+            SPDLOG_ERROR("Save '{}' is on level {} but only has {} levels",
+                         path, map_world.current_depth(),
+                         map_world.levels_size());
+            return false;
+        }
+        return true;
+    }
+}  // namespace
+
 Engine::Engine()
     : config(0, nullptr), renderer(create_renderer()), state(create_state()) {
     initialize();
@@ -56,10 +81,21 @@ EngineState* Engine::create_state() {
     if(unpacker.is_valid()) {
         ant_proto::EngineState msg;
         unpacker >> msg;
-        return new EngineState(msg, config, renderer);
-    } else {
-        return new EngineState(config, renderer);
+        if(is_loadable(msg, config.save_path)) {
+            EngineState* state = new EngineState(msg, config, renderer);
+            // the save keeps the seed its world was generated with
+            SPDLOG_INFO("World seed: {} - loaded from '{}'",
+                        state->map_world.seed, config.save_path);
+            return state;
+        }
+        // a headless run would report on a world nobody asked for
+        if(is_headless()) exit(1);
+        SPDLOG_WARN("Starting a new world instead of '{}'", config.save_path);
     }
+    EngineState* state = new EngineState(config, renderer);
+    SPDLOG_INFO("World seed: {} - pass --seed {} to replay it",
+                state->map_world.seed, state->map_world.seed);
+    return state;
 }
 
 void Engine::update() {
@@ -71,6 +107,55 @@ void Engine::update() {
     // SPDLOG_TRACE("Engine update complete");
 }
 
+void Engine::run_headless() {
+    using clock = std::chrono::steady_clock;
+    SPDLOG_INFO("Running {} headless ticks", config.headless_ticks);
+
+    ulong instructions = 0;
+    clock::time_point const start = clock::now();
+    for(ulong i = 0; i < config.headless_ticks; ++i) {
+        state->tick();
+        instructions += state->primary_mode.instructions_last_tick();
+    }
+    double const seconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+
+    SPDLOG_INFO("Headless run completed - ticks: {} workers: {} time: {:.3f}s",
+                config.headless_ticks, state->entity_manager.num_workers(),
+                seconds);
+    SPDLOG_INFO(
+        "Headless run rates - {:.4f} ms/tick {:.1f} ticks/s {:.3e} async "
+        "instructions/s",
+        seconds * 1000 / config.headless_ticks,
+        config.headless_ticks / seconds, instructions / seconds);
+
+    if(!config.profile_path.empty()) write_profile();
+    if(config.out_path.empty()) return;
+    SPDLOG_INFO("Writing the headless run state to '{}'", config.out_path);
+    Packer p(config.out_path);
+    p << *state;
+}
+
+void Engine::get_profile(std::vector<ProfileLine>& lines) const {
+    state->get_profile(lines);
+}
+
+void Engine::write_profile() const {
+    if(!ExecutorProfiler::is_enabled) {
+        SPDLOG_WARN("Not writing a profile - the build does not profile the "
+                    "programs");
+        return;
+    }
+    std::vector<ProfileLine> lines;
+    get_profile(lines);
+    std::vector<std::string> rows;
+    format_profile(lines, rows);
+
+    SPDLOG_INFO("Writing the program profile to '{}'", config.profile_path);
+    std::ofstream out(config.profile_path);
+    for(std::string const& row : rows) out << row << '\n';
+}
+
 void Engine::render() {
     state->render();
     renderer->present();
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <vector>
+
 #include "app/arg_parse.hpp"
+#include "hardware/profiler.hpp"
 
 class Renderer;
 struct EngineState;
@@ -17,9 +20,15 @@ class Engine {
     ~Engine();
     void update();
     void render();
+    bool is_headless() const { return config.headless_ticks > 0; }
+    // runs the headless ticks back to back and writes the resulting state
+    void run_headless();
+    // the current program's source lines with their profile counts
+    void get_profile(std::vector<ProfileLine>& lines) const;
 
    private:
     void initialize();
+    void write_profile() const;
     Renderer* create_renderer() const;
     EngineState* create_state();
 };
@@ -22,22 +22,25 @@
 
 EngineState::EngineState(ProjectArguments& config, Renderer* renderer)
     : box_manager(globals::COLS, globals::ROWS),
-      job_pool(8),
+      job_pool(config.num_threads),
       map_world(Rect(0, 0, box_manager.map_box->get_width(),
                      box_manager.map_box->get_height()),
-                config.is_walls_enabled),
+                config.is_walls_enabled, config.seed),
       map_manager(globals::COLS * 2, globals::ROWS * 2, config, map_world),
       entity_manager(map_manager, map_world,
                      map_world.current_level().start_info->player_x,
-                     map_world.current_level().start_info->player_y, job_pool),
+                     map_world.current_level().start_info->player_y),
       software_manager(command_map),
       primary_mode(*box_manager.map_box, command_map, software_manager,
                    entity_manager, map_manager, map_world, *renderer,
                    is_reload_game, job_pool),
       editor_mode(*renderer, *box_manager.text_editor_content_box,
-                  software_manager, map_world.levels),
+                  software_manager, primary_mode.get_hardware_manager(),
+                  map_world.levels),
       state(&primary_mode, &editor_mode) {
     SPDLOG_INFO("Creating engine state");
+    if(config.is_jit) primary_mode.enable_jit();
+    if(config.is_lockstep) primary_mode.enable_lockstep();
     add_listeners(config);
     SPDLOG_INFO("Engine initialized without backup");
 }
@@ -45,17 +48,20 @@ EngineState::EngineState(ProjectArguments& config, Renderer* renderer)
 EngineState::EngineState(const ant_proto::EngineState& msg,
                          ProjectArguments& config, Renderer* renderer)
     : box_manager(globals::COLS, globals::ROWS),
-      job_pool(8),
-      map_world(msg.map_world(), job_pool, config.is_walls_enabled),
+      job_pool(config.num_threads),
+      map_world(msg.map_world(), config.is_walls_enabled),
       map_manager(msg.map_manager(), map_world),
-      entity_manager(msg.entity_manager(), map_manager, map_world, job_pool),
+      entity_manager(msg.entity_manager(), map_manager, map_world),
       software_manager(msg.software_manger(), command_map),
       primary_mode(msg.hardware_manager(), *box_manager.map_box, command_map,
                    software_manager, entity_manager, map_manager, map_world,
                    *renderer, is_reload_game, job_pool),
       editor_mode(*renderer, *box_manager.text_editor_content_box,
-                  software_manager, map_world.levels),
+                  software_manager, primary_mode.get_hardware_manager(),
+                  map_world.levels),
       state(&primary_mode, &editor_mode) {
+    if(config.is_jit) primary_mode.enable_jit();
+    if(config.is_lockstep) primary_mode.enable_lockstep();
     add_listeners(config);
     SPDLOG_INFO("Engine initialized with backup");
 }
@@ -76,7 +82,21 @@ void EngineState::add_listeners(ProjectArguments& config) {
 
 void EngineState::update() {
     // SPDLOG_TRACE("Updating engine");
+    poll_events();
+    tick();
+    // SPDLOG_TRACE("Engine state update complete");
+}
+
+void EngineState::tick() { state.update(); }
 
+void EngineState::get_profile(std::vector<ProfileLine>& lines) {
+    HardwareManager const& hardware_manager =
+        primary_mode.get_hardware_manager();
+    software_manager.get_profile(
+        hardware_manager.find_profile(software_manager.get()), lines);
+}
+
+void EngineState::poll_events() {
     SDL_Event event;
     MouseEvent mouse_event;
     KeyboardEvent keyboard_event;
@@ -118,20 +138,22 @@ void EngineState::update() {
                 break;
         }
     }
-    state.update();
-
-    // SPDLOG_TRACE("Engine state update complete");
 }
 
 void EngineState::render() { state.render(); }
 
-Packer& operator<<(Packer& p, EngineState const& obj) {
+ant_proto::EngineState EngineState::get_proto() const {
     ant_proto::EngineState msg;
-    *msg.mutable_entity_manager() = obj.entity_manager.get_proto();
-    *msg.mutable_software_manger() = obj.software_manager.get_proto();
-    *msg.mutable_hardware_manager() = obj.primary_mode.get_proto();
-    *msg.mutable_map_world() = obj.map_world.get_proto();
-    *msg.mutable_map_manager() = obj.map_manager.get_proto();
+    *msg.mutable_entity_manager() = entity_manager.get_proto();
+    *msg.mutable_software_manger() = software_manager.get_proto();
+    *msg.mutable_hardware_manager() = primary_mode.get_proto();
+    *msg.mutable_map_world() = map_world.get_proto();
+    *msg.mutable_map_manager() = map_manager.get_proto();
+    return msg;
+}
+
+Packer& operator<<(Packer& p, EngineState const& obj) {
+    ant_proto::EngineState msg = obj.get_proto();
 
     // UNCOMMMENT BELOW FOR DEBUGGING SERIALIZATION
     //
@@ -17,7 +17,9 @@ struct KeyboardEvent;
 
 struct EngineState {
     BoxManager box_manager;
-    ThreadPool<AsyncProgramJob> job_pool;
+    // runs the ant programs and the entity updates of each tick on the
+    // --threads threads, the main thread included
+    ThreadPool<PoolJob> job_pool;
     MapWorld map_world;
     MapManager map_manager;
     EntityManager entity_manager;
@@ -37,9 +39,14 @@ struct EngineState {
     EngineState(const ant_proto::EngineState&, ProjectArguments&, Renderer*);
     ~EngineState();
     void update();
+    void tick();  // one game tick without polling the input events
+    // the current program's source lines with their profile counts
+    void get_profile(std::vector<ProfileLine>& lines);
     void render();
+    ant_proto::EngineState get_proto() const;
 
    private:
     void add_listeners(ProjectArguments&);
+    void poll_events();
     friend Packer& operator<<(Packer&, EngineState const&);
 };
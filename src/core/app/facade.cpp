@@ -18,3 +18,9 @@ bool AntGameFacade::update() {
 }
 
 void AntGameFacade::engine_update() { engine.update(); }
+
+std::vector<ProfileLine> AntGameFacade::get_profile() const {
+    std::vector<ProfileLine> lines;
+    engine.get_profile(lines);
+    return lines;
+}
@@ -12,6 +12,9 @@ class AntGameFacade {
 
     bool update();
     void engine_update();
+    bool is_headless() const { return engine.is_headless(); }
+    void run_headless() { engine.run_headless(); }
+    std::vector<ProfileLine> get_profile() const;
 
    private:
     Engine engine = {};
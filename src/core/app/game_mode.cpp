@@ -6,8 +6,12 @@
 
 EditorMode::EditorMode(Renderer& renderer, LayoutBox& box,
                        SoftwareManager& software_manager,
+                       HardwareManager const& hardware_manager,
                        std::vector<Level> const& levels)
-    : renderer(renderer), box(box), editor(software_manager), levels(levels) {
+    : renderer(renderer),
+      box(box),
+      editor(software_manager, hardware_manager),
+      levels(levels) {
     // text editor listeners
     event_system.keyboard_events.add(RETURN_KEY_EVENT,
                                      new NewLineHandler(editor));
@@ -31,10 +35,9 @@ PrimaryMode::PrimaryMode(LayoutBox& box, CommandMap const& command_map,
                          SoftwareManager& software_manager,
                          EntityManager& entity_manager, MapManager& map_manager,
                          MapWorld& map_world, Renderer& renderer,
-                         bool& is_reload_game,
-                         const ThreadPool<AsyncProgramJob>& job_pool)
+                         bool& is_reload_game, ThreadPool<PoolJob>& job_pool)
     : box(box),
-      hardware_manager(command_map),
+      hardware_manager(command_map, map_world.instr_action_clock),
       entity_manager(entity_manager),
       map_manager(map_manager),
       map_world(map_world),
@@ -49,10 +52,9 @@ PrimaryMode::PrimaryMode(const ant_proto::HardwareManager msg, LayoutBox& box,
                          SoftwareManager& software_manager,
                          EntityManager& entity_manager, MapManager& map_manager,
                          MapWorld& map_world, Renderer& renderer,
-                         bool& is_reload_game,
-                         const ThreadPool<AsyncProgramJob>& job_pool)
+                         bool& is_reload_game, ThreadPool<PoolJob>& job_pool)
     : box(box),
-      hardware_manager(msg, command_map),
+      hardware_manager(msg, command_map, map_world.instr_action_clock),
       entity_manager(entity_manager),
       map_manager(map_manager),
       map_world(map_world),
@@ -61,7 +63,8 @@ PrimaryMode::PrimaryMode(const ant_proto::HardwareManager msg, LayoutBox& box,
       job_pool(job_pool) {
     SPDLOG_DEBUG("Unpacking primary mode object");
     initialize(software_manager);
-    entity_manager.rebuild_workers(hardware_manager, software_manager);
+    entity_manager.rebuild_workers(hardware_manager, software_manager,
+                                   job_pool);
     SPDLOG_TRACE("Completed unpacking the primary mode object");
 }
 
@@ -107,6 +110,11 @@ void PrimaryMode::initialize(SoftwareManager& software_manager) {
         A_KEY_EVENT, new CreateAntHandler(entity_manager, hardware_manager,
                                           software_manager));
 
+    // REPROGRAM THE ANTS ON THE LEVEL EVENT
+    event_system.keyboard_events.add(
+        U_KEY_EVENT, new ReprogramAntsHandler(entity_manager, hardware_manager,
+                                              software_manager));
+
     // GO UP AND DOWN LEVELS EVNETS
     event_system.keyboard_events.add(
         E_KEY_EVENT,
@@ -204,19 +212,8 @@ void PrimaryMode::render() {
 }
 
 void PrimaryMode::update() {
-    entity_manager.update();
-
-    for(ProgramExecutor* exec : hardware_manager) {
-        exec->reset();
-    }
+    entity_manager.update(job_pool);
 
-    for(ProgramExecutor* exec : hardware_manager) {
-        exec->execute_async();
-    }
-
-    job_pool.await_jobs();
-
-    for(ProgramExecutor* exec : hardware_manager) {
-        exec->execute_sync();
-    }
+    hardware_manager.execute_async(job_pool);
+    hardware_manager.execute_sync();
 }
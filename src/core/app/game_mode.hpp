@@ -46,6 +46,7 @@ class EditorMode : public Mode {
    public:
     EditorMode(Renderer& renderer, LayoutBox& box,
                SoftwareManager& software_manager,
+               HardwareManager const& hardware_manager,
                std::vector<Level> const& levels);
 
     bool is_editor() override { return true; }
@@ -89,21 +90,21 @@ class PrimaryMode : public Mode {
     MapWorld& map_world;
     Renderer& renderer;
     bool& is_reload_game;
-    const ThreadPool<AsyncProgramJob>& job_pool;
+    ThreadPool<PoolJob>& job_pool;  // shared by the programs and the ants
 
    public:
     PrimaryMode(LayoutBox& box, CommandMap const& command_map,
                 SoftwareManager& software_manager,
                 EntityManager& entity_manager, MapManager& map_manager,
                 MapWorld& map_world, Renderer& renderer, bool& is_reload_game,
-                const ThreadPool<AsyncProgramJob>& job_pool);
+                ThreadPool<PoolJob>& job_pool);
 
     PrimaryMode(const ant_proto::HardwareManager msg, LayoutBox& box,
                 CommandMap const& command_map,
                 SoftwareManager& software_manager,
                 EntityManager& entity_manager, MapManager& map_manager,
                 MapWorld& map_world, Renderer& renderer, bool& is_reload_game,
-                const ThreadPool<AsyncProgramJob>& job_pool);
+                ThreadPool<PoolJob>& job_pool);
 
     void initialize(SoftwareManager& software_manager);
     bool is_editor() override { return false; }
@@ -132,6 +133,15 @@ class PrimaryMode : public Mode {
         return event_system.char_keyboard_events;
     }
 
+    void enable_jit() { hardware_manager.enable_jit(); }
+    void enable_lockstep() { hardware_manager.enable_lockstep(); }
+    HardwareManager const& get_hardware_manager() const {
+        return hardware_manager;
+    }
+    ulong instructions_last_tick() const {
+        return hardware_manager.instructions_last_tick();
+    }
+
     ant_proto::HardwareManager get_proto() const {
         ant_proto::HardwareManager msg;
         return msg;
@@ -7,7 +7,7 @@
 #include "hardware/program_executor.hpp"
 #include "spdlog/spdlog.h"
 #include "ui/colors.hpp"
-#include "utils/thread_pool.hpp"
+#include "utils/random.hpp"
 
 Player::Player(EntityData const& data, ItemInfoMap const& info_map)
     : data(data), inventory(1, 1, 1000, info_map) {
@@ -23,10 +23,6 @@ EntityData& Player::get_data() { return data; }
 
 MapEntityType Player::get_type() const { return PLAYER; }
 
-void Player::request_move() {}
-void Player::handle_empty_space(uchar) {}
-void Player::handle_full_space(uchar) {}
-
 ant_proto::Player Player::get_proto() const {
     ant_proto::Player msg;
     *msg.mutable_data() = data.get_proto();
@@ -35,37 +31,27 @@ ant_proto::Player Player::get_proto() const {
 }
 
 Worker::Worker(EntityData const& data, ulong const& instr_clock,
-               ItemInfoMap const& info_map,
-               ThreadPool<AsyncProgramJob>& job_pool)
-    : data(data),
+               ItemInfoMap const& info_map)
+    : program_executor(instr_clock, max_instruction_per_tick, cpu),
       cpu(),
-      program_executor(instr_clock, max_instruction_per_tick,
-                       cpu.instr_ptr_register, job_pool),
+      data(data),
       inventory(1, 1, 1000, info_map) {}
 
 Worker::Worker(const ant_proto::Worker& msg, ulong const& instr_clock,
-               ItemInfoMap const& info_map,
-               ThreadPool<AsyncProgramJob>& job_pool)
-    : data(msg.data()),
+               ItemInfoMap const& info_map)
+    : program_executor(instr_clock, max_instruction_per_tick, cpu),
       cpu(msg.dual_registers()),
-      program_executor(msg.program_executor(), instr_clock,
-                       max_instruction_per_tick, cpu.instr_ptr_register,
-                       job_pool),
-      inventory(msg.inventory(), info_map) {
+      data(msg.data()),
+      inventory(msg.inventory(), info_map),
+      id(msg.id()) {
+    // the executor is built before the cpu it writes its state to
+    program_executor.unpack(msg.program_executor());
     SPDLOG_TRACE("Completed unpacking worker");
 }
 
 EntityData& Worker::get_data() { return data; }
 
-void Worker::request_move() { program_executor.execute_sync(); }
-
-void Worker::handle_empty_space(uchar bits) {
-    cpu.is_space_empty_flags |= bits;
-}
-
-void Worker::handle_full_space(uchar bits) {
-    cpu.is_space_empty_flags &= ~bits;
-}
+void Worker::set_map(Map const& map) { cpu.surroundings = {&map, &data}; }
 
 ant_proto::Worker Worker::get_proto() {
     ant_proto::Worker msg;
@@ -73,6 +59,7 @@ ant_proto::Worker Worker::get_proto() {
     *msg.mutable_inventory() = inventory.get_proto();
     *msg.mutable_program_executor() = program_executor.get_proto();
     *msg.mutable_dual_registers() = cpu.get_proto();
+    msg.set_id(id);
 
     return msg;
 }
@@ -101,22 +88,21 @@ void Worker::click_callback(long, long) {
 
 void Worker::move_callback(EntityMoveUpdate const& update) {
     ScentBehaviors& scent_behaviors = cpu.scent_behaviors;
-    scent_behaviors.read_scent_behavior((ulong*)update.abs_scents);
+    // a worker moves at most once a tick so the tick positions the stream
+    CounterRandom random(random_seed, id, program_executor.instr_clock);
+    scent_behaviors.read_scent_behavior((ulong*)update.abs_scents, random);
     scent_behaviors.write_scent_behavior();
-
-    // SPDLOG_INFO("Move callback - worker - {}", cpu.is_space_empty_flags);
 }
 
 void Worker::debug_empty_space_flags() {
-    SPDLOG_TRACE("Update worker full space flags: D:{} L:{} U:{} R:{}",
-                 (cpu.is_space_empty_flags >> 3) & 1,
-                 (cpu.is_space_empty_flags >> 2) & 1,
-                 (cpu.is_space_empty_flags >> 1) & 1,
-                 (cpu.is_space_empty_flags >> 0) & 1);
+    uchar const empty_bits = cpu.surroundings.empty_bits();
+    SPDLOG_TRACE("Worker empty space flags: D:{} L:{} U:{} R:{}",
+                 (empty_bits >> 3) & 1, (empty_bits >> 2) & 1,
+                 (empty_bits >> 1) & 1, (empty_bits >> 0) & 1);
     // Debug empty space flags
     // DLUR
     std::string facings = "+6894-7^23|>1V<o";
-    data.ch = facings[cpu.is_space_empty_flags];
+    data.ch = facings[empty_bits];
 }
 
 MapEntityType Worker::get_type() const { return WORKER; }
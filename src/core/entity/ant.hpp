@@ -1,14 +1,11 @@
 #pragma once
 
-#include <unordered_set>
-
 #include "entity.pb.h"
 #include "entity/entity_data.hpp"
 #include "entity/inventory.hpp"
 #include "hardware/brain.hpp"
 #include "hardware/command_config.hpp"
 #include "hardware/program_executor.hpp"
-#include "utils/thread_pool.hpp"
 
 struct Player : public MapEntity {
     EntityData data;
@@ -18,44 +15,52 @@ struct Player : public MapEntity {
     Player(const ant_proto::Player& msg, ItemInfoMap const&);
     EntityData& get_data();
     ~Player() = default;
-    void request_move();
     void move_callback(EntityMoveUpdate const&);
     void click_callback(long x, long y);
-    void handle_empty_space(uchar bits);
-    void handle_full_space(uchar bits);
     MapEntityType get_type() const;
 
     ant_proto::Player get_proto() const;
 };
 
+// The members are ordered by how often a tick touches them. The executor
+// shares the first cache line with the vtable pointer and the hot fields of
+// the cpu fill the next one, so a visit touches one aligned pair of lines. The
+// ram, the inventory and the command permissions are only read by some ops.
 struct Worker : public MapEntity {
-    EntityData data;
     ulong max_instruction_per_tick = 500;
+    ProgramExecutor program_executor;  // runs on cpu
     DualRegisters cpu = {};
-    ProgramExecutor program_executor;
+    EntityData data;
     Inventory inventory;
+    // the random stream of the worker is keyed by the world seed and its id
+    ulong id = 0;
+    ulong random_seed = 0;
 
-    std::unordered_set<CommandEnum> command_set = {
-        CommandEnum::ADD,  CommandEnum::DEC, CommandEnum::INC,
-        CommandEnum::JMP,  CommandEnum::JNZ, CommandEnum::LOAD,
-        CommandEnum::MOVE, CommandEnum::NOP, CommandEnum::SUB,
-        CommandEnum::COPY};
+    // commands the worker may run - one bit per CommandEnum
+    CommandMask command_permissions =
+        command_bit(CommandEnum::ADD) | command_bit(CommandEnum::DEC) |
+        command_bit(CommandEnum::INC) | command_bit(CommandEnum::JMP) |
+        command_bit(CommandEnum::JNZ) | command_bit(CommandEnum::LOAD) |
+        command_bit(CommandEnum::MOVE) | command_bit(CommandEnum::NOP) |
+        command_bit(CommandEnum::SUB) | command_bit(CommandEnum::COPY);
 
-    Worker(EntityData const& data, ulong const& instr_clock, ItemInfoMap const&,
-           ThreadPool<AsyncProgramJob>&);
+    Worker(EntityData const& data, ulong const& instr_clock,
+           ItemInfoMap const&);
     Worker(const ant_proto::Worker& msg, ulong const& instr_clock,
-           ItemInfoMap const&, ThreadPool<AsyncProgramJob>&);
+           ItemInfoMap const&);
     ~Worker() = default;
 
     EntityData& get_data();
-    void request_move();
     void move_callback(EntityMoveUpdate const&);
     void click_callback(long x, long y);
-    void handle_empty_space(uchar bits);
-    void handle_full_space(uchar bits);
     MapEntityType get_type() const;
+    // the map CHECK and the scent reader look at - the level of the worker
+    void set_map(Map const& map);
 
     ant_proto::Worker get_proto();
+    bool is_permitted(CommandEnum command) const {
+        return command_permissions & command_bit(command);
+    }
 
    private:
     void debug_empty_space_flags();
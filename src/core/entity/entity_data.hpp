@@ -40,8 +40,5 @@ struct MapEntity {
     virtual EntityData& get_data() = 0;
     virtual void move_callback(EntityMoveUpdate const&) = 0;
     virtual void click_callback(long x, long y) = 0;
-    virtual void request_move() = 0;
-    virtual void handle_empty_space(uchar bits) = 0;
-    virtual void handle_full_space(uchar bits) = 0;
     virtual MapEntityType get_type() const = 0;
 };
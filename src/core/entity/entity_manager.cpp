@@ -1,31 +1,91 @@
 #include "entity/entity_manager.hpp"
 
 #include "map/manager.hpp"
+#include "map/scent_field.hpp"
 #include "map/world.hpp"
 #include "spdlog/spdlog.h"
+#include "utils/math.hpp"
+
+// the actions of a worker stay within the neighbours of its chunk
+static_assert(Map::ACTION_REACH <= globals::CHUNK_LENGTH);
+
+namespace {
+    bool has_action(DualRegisters const& cpu) {
+        return cpu.is_move_flag || cpu.is_dig_flag || cpu.delta_scents;
+    }
+
+    // the position of the chunk modulo three on each axis
+    uchar chunk_color(long x, long y) {
+        auto mod3 = [](long pos) {
+            long const chunk = div_floor(pos, globals::CHUNK_LENGTH);
+            return ((chunk % 3) + 3) % 3;
+        };
+        return mod3(x) + 3 * mod3(y);
+    }
+
+    // Records the step of the worker in the direction it faces - the scents
+    // it reads on the way are those from before any worker acts this tick
+    MoveIntent plan_move(Map& map, TileStencil& stencil, Worker& worker) {
+        DualRegisters& cpu = worker.cpu;
+
+        // Direction Truth Table
+        // A B | DX DY
+        // 0 0 |  1  0
+        // 0 1 |  0 -1
+        // 1 0 | -1  0
+        // 1 1 |  0  1
+
+        long dx = (1 - cpu.dir_flag2) * (-2 * cpu.dir_flag1 + 1);
+        long dy = cpu.dir_flag2 * (2 * cpu.dir_flag1 - 1);
+        MoveIntent intent{&worker, dx, dy, worker.id, cpu.is_move_flag};
+        if(intent.is_move) {
+            cpu.is_move_flag = false;
+            SPDLOG_DEBUG("Moving worker - dx: {} dy: {}", dx, dy);
+            map.announce_move(stencil, worker, dx, dy);
+        }
+        return intent;
+    }
+
+    // Digs in the direction of the planned step from where the worker ended
+    // up and leaves its scents on that tile
+    void apply_actions(Map& map, TileStencil& stencil, Worker& worker,
+                       MoveIntent const& intent) {
+        DualRegisters& cpu = worker.cpu;
+        if(intent.is_move) cpu.instr_failed_flag = !intent.is_moved;
+        if(cpu.is_dig_flag) {
+            cpu.is_dig_flag = false;
+            SPDLOG_DEBUG("Digging worker - dx: {} dy: {}", intent.dx,
+                         intent.dy);
+            cpu.instr_failed_flag =
+                !map.dig(stencil, worker, intent.dx, intent.dy);
+        }
+        if(cpu.delta_scents) {
+            ulong& tile_scents = map.get_tile_scents(stencil, worker);
+            tile_scents =
+                ScentField::add_saturated(tile_scents, cpu.delta_scents);
+            cpu.delta_scents = 0;
+        }
+    }
+}  // namespace
 
 EntityManager::EntityManager(MapManager& map_manager, MapWorld& map_world,
-                             int player_start_x, int player_start_y,
-                             ThreadPool<AsyncProgramJob>& job_pool)
+                             int player_start_x, int player_start_y)
     : map_manager(map_manager),
       map_world(map_world),
       player(EntityData(40, 25, '@', 10, color::white),
              map_world.item_info_map),
       player_depth(0),
-      job_pool(job_pool),
       next_worker(create_worker_data()) {
     player.data.x = player_start_x;
     player.data.y = player_start_y;
 }
 
 EntityManager::EntityManager(ant_proto::EntityManager msg,
-                             MapManager& map_manager, MapWorld& map_world,
-                             ThreadPool<AsyncProgramJob>& job_pool)
+                             MapManager& map_manager, MapWorld& map_world)
     : map_manager(map_manager),
       map_world(map_world),
       player(msg.player(), map_world.item_info_map),
       player_depth(msg.player_depth()),
-      job_pool(job_pool),
       next_worker(create_worker_data()) {}
 
 EntityManager::~EntityManager() {
@@ -47,57 +107,136 @@ void EntityManager::update_fov() {
     SPDLOG_TRACE("FOV updated");
 }
 
-void EntityManager::update() {
+void EntityManager::update(ThreadPool<PoolJob>& job_pool) {
     ++map_world.instr_action_clock;
-    // Move / dig the ants on the map
+    partition_workers_by_chunk();
+
+    move_intents.resize(partition_workers.size());
+    run_partitions(job_pool, 0, color_partitions.size(), true);
+    move_workers();
+
+    // a colour only starts once the partitions of the last one are done
+    ulong begin = 0;
+    for(ulong end = 1; end <= color_partitions.size(); ++end) {
+        if(end < color_partitions.size() &&
+           color_partitions[end]->color == color_partitions[begin]->color)
+            continue;
+        run_partitions(job_pool, begin, end, false);
+        begin = end;
+    }
+    for(auto& level : map_world.levels)
+        level.map.update_scents(map_world.instr_action_clock);
+
+    if(!map_manager.update_current_level(player.get_data())) return;
+    SPDLOG_TRACE("Updating EntityManager");
+    update_fov();
+}
+
+// Groups the workers with an action by the chunk they stand in. The chunks
+// their actions reach are generated here on the main thread in the order of
+// the workers, as generating a chunk builds the map around it.
+void EntityManager::partition_workers_by_chunk() {
+    partitions.clear();
+    acting_workers.clear();
+    worker_partitions.clear();
     for(auto& level : map_world.levels) {
+        chunk_partitions.clear();
         for(Worker* worker : level.workers) {
-            DualRegisters& cpu = worker->cpu;
-
-            // Direction Truth Table
-            // A B | DX DY
-            // 0 0 |  1  0
-            // 0 1 |  0 -1
-            // 1 0 | -1  0
-            // 1 1 |  0  1
-
-            long dx = (1 - cpu.dir_flag2) * (-2 * cpu.dir_flag1 + 1);
-            long dy = cpu.dir_flag2 * (2 * cpu.dir_flag1 - 1);
-            if(cpu.is_move_flag) {
-                cpu.is_move_flag = false;
-                SPDLOG_DEBUG("Moving worker - dx: {} dy: {}", dx, dy);
-                cpu.instr_failed_flag = !level.map.move_entity(*worker, dx, dy);
-            }
-            if(cpu.is_dig_flag) {
-                cpu.is_dig_flag = false;
-                SPDLOG_DEBUG("Digging worker - dx: {} dy: {}", dx, dy);
-                cpu.instr_failed_flag = !level.map.dig(*worker, dx, dy);
-            }
-            if(cpu.delta_scents) {
-                ulong& tile_scents = level.map.get_tile_scents(*worker);
-
-                ulong updated_scents = 0;
-                ulong offset = 0;
-                while(cpu.delta_scents != 0) {
-                    ulong delta_scent = cpu.delta_scents & 0xFF;
-                    ulong prev_scent = tile_scents & 0xFF;
-                    ulong scent = (prev_scent + delta_scent) & 0xFF;
-                    updated_scents |= (scent << offset);
-
-                    tile_scents >>= 8;
-                    cpu.delta_scents >>= 8;
-                    offset += 8;
-                }
-                tile_scents = updated_scents;
-                // SPDLOG_INFO("Tile scent: {} - x: {} y: {}", tile_scents,
-                // worker->get_data().x, worker->get_data().y);
+            if(!has_action(worker->cpu)) continue;
+            EntityData& data = worker->get_data();
+            auto [it, is_new] = chunk_partitions.try_emplace(
+                level.map.get_chunk_id(data.x, data.y), partitions.size());
+            if(is_new) {
+                partitions.push_back({&level.map,
+                                      level.map.get_stencil(*worker),
+                                      chunk_color(data.x, data.y)});
             }
+            ChunkPartition& partition = partitions[it->second];
+            partition.stencil.resolve(data.x, data.y, Map::ACTION_REACH);
+            ++partition.end;  // counts the workers until the ranges are set
+            acting_workers.push_back(worker);
+            worker_partitions.push_back(it->second);
         }
     }
 
-    if(!map_manager.update_current_level(player.get_data())) return;
-    SPDLOG_TRACE("Updating EntityManager");
-    update_fov();
+    // stable counting sort of the workers by partition
+    ulong offset = 0;
+    for(ChunkPartition& partition : partitions) {
+        partition.begin = offset;
+        offset += partition.end;
+        partition.end = partition.begin;
+    }
+    partition_workers.resize(acting_workers.size());
+    for(ulong i = 0; i < acting_workers.size(); ++i) {
+        ChunkPartition& partition = partitions[worker_partitions[i]];
+        partition_workers[partition.end++] = acting_workers[i];
+    }
+
+    color_partitions.clear();
+    for(uchar color = 0; color < ChunkPartition::num_colors; ++color) {
+        for(ChunkPartition& partition : partitions) {
+            if(partition.color == color) color_partitions.push_back(&partition);
+        }
+    }
+    SPDLOG_TRACE("Partitioned {} acting workers into {} chunks",
+                 acting_workers.size(), partitions.size());
+}
+
+// Settles the recorded moves of each level in one batch. The partitions of a
+// level are next to each other and so are the intents of their workers.
+void EntityManager::move_workers() {
+    ulong begin = 0;
+    for(ulong i = 0; i < partitions.size(); ++i) {
+        ChunkPartition& partition = partitions[i];
+        if(i + 1 < partitions.size() && partitions[i + 1].map == partition.map)
+            continue;
+        partition.map->move_entities(move_intents.data() + begin,
+                                     partition.end - begin);
+        begin = partition.end;
+    }
+}
+
+// Runs a range of color_partitions as jobs of about the same number of workers
+// - returns once every job has finished
+void EntityManager::run_partitions(ThreadPool<PoolJob>& job_pool, ulong begin,
+                                   ulong end, bool is_planning) {
+    auto num_workers = [this](ulong idx) {
+        return color_partitions[idx]->end - color_partitions[idx]->begin;
+    };
+    ulong range_workers = 0;
+    for(ulong i = begin; i < end; ++i) range_workers += num_workers(i);
+    ulong const num_batches = job_pool.num_threads() * min_batches_per_thread;
+    ulong const batch_workers = std::max(
+        (range_workers + num_batches - 1) / num_batches, min_batch_workers);
+
+    ulong first = begin;
+    ulong batch_size = 0;
+    for(ulong i = begin; i < end; ++i) {
+        batch_size += num_workers(i);
+        if(batch_size < batch_workers && i + 1 < end) continue;
+        EntityUpdateJob job{color_partitions.data() + first, i + 1 - first,
+                            partition_workers.data(), move_intents.data(),
+                            is_planning};
+        job_pool.submit_job(job);
+        first = i + 1;
+        batch_size = 0;
+    }
+    job_pool.await_jobs();
+}
+
+void EntityUpdateJob::run() {
+    for(ulong i = 0; i < count; ++i) {
+        ChunkPartition& partition = *partitions[i];
+        for(ulong w = partition.begin; w < partition.end; ++w) {
+            if(is_planning) {
+                intents[w] =
+                    plan_move(*partition.map, partition.stencil, *workers[w]);
+            } else {
+                apply_actions(*partition.map, partition.stencil, *workers[w],
+                              intents[w]);
+            }
+        }
+    }
 }
 
 void EntityManager::create_ant(HardwareManager& hardware_manager,
@@ -154,10 +293,8 @@ bool EntityManager::build_ant(HardwareManager& hardware_manager, Worker& worker,
     SPDLOG_TRACE("Building ant program - x: {} y: {} - machine_code: {} bytes",
                  worker.get_data().x, worker.get_data().y, machine_code.size());
 
-    CompileArgs compile_args(machine_code.code, worker.cpu,
-                             worker.program_executor._ops);
-    hardware_manager.compile(compile_args);
-    if(compile_args.status.p_err) {
+    worker.program_executor.image = hardware_manager.compile(machine_code);
+    if(worker.program_executor.image == nullptr) {
         SPDLOG_ERROR("Failed to compile the program for the ant");
         return false;
     }
@@ -166,20 +303,86 @@ bool EntityManager::build_ant(HardwareManager& hardware_manager, Worker& worker,
     return true;
 }
 
+// Compiles each distinct program of the saved ants once, in parallel, and
+// hands the images to the workers. A worker whose saved registers do not fit
+// its program starts it over.
 void EntityManager::rebuild_workers(HardwareManager& hardware_manager,
-                                    SoftwareManager& software_manager) {
+                                    SoftwareManager& software_manager,
+                                    ThreadPool<PoolJob>& job_pool) {
     SPDLOG_DEBUG("Rebuilding worker ant programs - count: {}",
                  map_world.levels.size());
+    std::vector<MachineCode const*> codes;
+    std::vector<ProgramImage const*> images;
+    software_manager.get_codes(codes);
+    hardware_manager.compile_all(codes, images, job_pool);
+
     ulong ant_idx = 0;
     for(auto& level : map_world.levels) {
         for(Worker* worker : level.workers) {
-            build_ant(hardware_manager, *worker, software_manager[ant_idx]);
+            ProgramImage const* image =
+                images[software_manager.code_index(ant_idx)];
             ++ant_idx;
+            if(image == nullptr) {
+                SPDLOG_ERROR("Failed to compile the program for the ant");
+                continue;
+            }
+            ProgramExecutor& exec = worker->program_executor;
+            exec.image = image;
+            if(!exec.fits_image()) {
+                SPDLOG_WARN(
+                    "Saved registers do not fit the program - restarting ant "
+                    "{} - ip: {} bp: {} sp: {}",
+                    worker->id, worker->cpu.instr_ptr_register,
+                    worker->cpu.base_ptr_register,
+                    worker->cpu.stack_ptr_register);
+                exec.restart();
+            }
+            hardware_manager.push_back(&exec);
         }
     }
     SPDLOG_TRACE("Completed rebuilding worker ant programs");
 }
 
+// Gives the ants the current program. The running ants switch to it together
+// at the start of the next tick and keep their place in the program where it
+// did not change - see HardwareManager::swap.
+bool EntityManager::reprogram_ants(HardwareManager& hardware_manager,
+                                   SoftwareManager& software_manager,
+                                   std::vector<ulong> const& ant_idxs) {
+    if(!software_manager.has_code()) return false;
+
+    std::vector<ProgramExecutor*> execs;
+    ulong ant_idx = 0;
+    auto it = ant_idxs.begin();
+    for(auto& level : map_world.levels) {
+        for(Worker* worker : level.workers) {
+            if(it != ant_idxs.end() && *it == ant_idx) {
+                execs.push_back(&worker->program_executor);
+                ++it;
+            }
+            ++ant_idx;
+        }
+    }
+    if(!hardware_manager.swap(execs, software_manager.get())) return false;
+    for(ulong idx : ant_idxs) software_manager.assign(idx);
+    SPDLOG_DEBUG("Reprogramming {} worker ants", execs.size());
+    return true;
+}
+
+// Reprograms the workers on the current level
+bool EntityManager::reprogram_level(HardwareManager& hardware_manager,
+                                    SoftwareManager& software_manager) {
+    std::vector<ulong> ant_idxs;
+    ulong ant_idx = 0;
+    for(auto& level : map_world.levels) {
+        bool const is_current = &level == &map_world.current_level();
+        for(ulong i = 0; i < level.workers.size(); ++i, ++ant_idx) {
+            if(is_current) ant_idxs.push_back(ant_idx);
+        }
+    }
+    return reprogram_ants(hardware_manager, software_manager, ant_idxs);
+}
+
 // returns the total number of workers accross all levels
 ulong EntityManager::num_workers() {
     ulong n = 0;
@@ -190,14 +393,19 @@ ulong EntityManager::num_workers() {
 }
 
 void EntityManager::save_ant(Worker* worker) {
+    worker->set_map(map_world.current_level().map);
     map_world.current_level().map.add_entity(*worker);
     map_world.current_level().workers.push_back(worker);
 }
 
 Worker* EntityManager::create_worker_data() {
-    return new Worker(EntityData('w', 10, color::light_green),
-                      map_world.instr_action_clock, map_world.item_info_map,
-                      job_pool);
+    Worker* worker =
+        new Worker(EntityData('w', 10, color::light_green),
+                   map_world.instr_action_clock, map_world.item_info_map);
+    // workers are never removed so the count is a unique id
+    worker->id = num_workers();
+    worker->random_seed = map_world.seed;
+    return worker;
 }
 
 ant_proto::EntityManager EntityManager::get_proto() const {
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include "entity.pb.h"
 #include "entity/ant.hpp"
 #include "entity/entity_data.hpp"
@@ -10,32 +13,86 @@
 #include "map/world.hpp"
 #include "utils/thread_pool.hpp"
 
+// The workers of one chunk that move, dig or leave scents this tick. Their
+// actions only reach the chunk and its neighbours, so partitions whose chunks
+// are three apart on an axis can run at the same time. The partitions are
+// coloured by their chunk position modulo three and the nine colours run one
+// after the other.
+struct ChunkPartition {
+    Map* map;
+    TileStencil stencil;  // around the chunk - resolved before the jobs run
+    uchar color;
+    ulong begin = 0, end = 0;  // range of EntityManager::partition_workers
+
+    static constexpr uchar num_colors = 9;
+};
+
+// Records the moves of the workers of a run of partitions or applies their
+// digs and scents once the moves are settled
+struct EntityUpdateJob {
+    ChunkPartition* const* partitions;
+    ulong count;
+    Worker* const* workers;  // grouped by partition, in update order
+    MoveIntent* intents;     // one per worker
+    bool is_planning;        // only reads the map so any partitions can run
+    void run();
+};
+
 struct EntityManager {
     MapManager& map_manager;
     MapWorld& map_world;
     Player player;
     ulong player_depth;
-    ThreadPool<AsyncProgramJob>& job_pool;
     Worker* next_worker = nullptr;
 
+    // scratch of update kept between ticks
+    std::vector<ChunkPartition> partitions;
+    std::unordered_map<ulong, ulong> chunk_partitions;  // chunk id -> index
+    std::vector<ulong> worker_partitions;  // partition of each acting worker
+    std::vector<Worker*> acting_workers;
+    std::vector<Worker*> partition_workers;
+    std::vector<MoveIntent> move_intents;  // parallel to partition_workers
+    std::vector<ChunkPartition*> color_partitions;  // grouped by colour
+
+    // Each job aims to apply the actions of about this many workers
+    static constexpr ulong min_batch_workers = 64;
+    // lower bound on jobs per thread and colour so stealing can balance
+    static constexpr ulong min_batches_per_thread = 4;
+
     EntityManager(MapManager& map_manager, MapWorld& map_world,
-                  int player_start_x, int player_start_y,
-                  ThreadPool<AsyncProgramJob>& job_pool);
+                  int player_start_x, int player_start_y);
     EntityManager(ant_proto::EntityManager msg, MapManager& map_manager,
-                  MapWorld& map_world, ThreadPool<AsyncProgramJob>& job_pool);
+                  MapWorld& map_world);
     ~EntityManager();
 
     void update_fov();
-    void update();
+    // Applies the moves, digs and scent deposits of the workers. The moves
+    // are recorded in parallel and settled together per level, then the
+    // partitions of a colour dig and leave scents as parallel jobs. The
+    // outcome does not depend on the number of threads.
+    void update(ThreadPool<PoolJob>& job_pool);
     void create_ant(HardwareManager& hardware_manager,
                     SoftwareManager& software_manager);
     bool build_ant(HardwareManager& hardware_manager, Worker& worker,
                    MachineCode const& machine_code);
     void rebuild_workers(HardwareManager& hardware_manager,
+                         SoftwareManager& software_manager,
+                         ThreadPool<PoolJob>& job_pool);
+    // ant_idxs are sorted
+    bool reprogram_ants(HardwareManager& hardware_manager,
+                        SoftwareManager& software_manager,
+                        std::vector<ulong> const& ant_idxs);
+    bool reprogram_level(HardwareManager& hardware_manager,
                          SoftwareManager& software_manager);
     ulong
     num_workers();  // returns the total number of workers accross all levels
     void save_ant(Worker* worker);
     Worker* create_worker_data();
     ant_proto::EntityManager get_proto() const;
+
+   private:
+    void partition_workers_by_chunk();
+    void move_workers();
+    void run_partitions(ThreadPool<PoolJob>& job_pool, ulong begin, ulong end,
+                        bool is_planning);
 };
@@ -91,7 +91,7 @@ void Inventory::remove(ItemType item, ulong& delta) {
     stack_count += new_stack_count - current_stack_count;
 }
 
-bool Inventory::has(ItemType item) const { return items.at(item) > 0; }
+bool Inventory::has(ItemType item) const { return items[item] > 0; }
 
 ulong Inventory::size() const { return items.size(); }
 
@@ -101,21 +101,17 @@ ant_proto::Inventory Inventory::get_proto() const {
     msg.set_max_stack_count(max_stack_count);
     msg.set_stack_size(stack_size);
     msg.set_max_weight(max_weight);
-    for(const auto& item : items) {
+    for(ulong item = 0; item < items.size(); ++item) {
         ant_proto::InventoryRecord i_msg;
-        i_msg.set_type(item.first);
-        i_msg.set_count(item.second);
+        i_msg.set_type(item);
+        i_msg.set_count(items[item]);
         *msg.add_item_records() = i_msg;
     }
 
     return msg;
 }
 
-void Inventory::initialize() {
-    items[DIRT] = 0;
-    items[FOOD] = 0;
-    items[EGG] = 0;
-}
+void Inventory::initialize() { items.fill(0); }
 
 ulong Inventory::get_ceil_stack_count(ulong count) const {
     return count / stack_size + (count % stack_size == 0 ? 0 : 1);
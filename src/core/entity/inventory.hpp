@@ -3,6 +3,7 @@
 #include <google/protobuf/map.h>
 #include <google/protobuf/stubs/port.h>
 
+#include <array>
 #include <unordered_map>
 
 #include "proto/entity.pb.h"
@@ -12,6 +13,7 @@ using ulong = unsigned long;
 // Note: ItemType enum is also defined in protobuf so messing with numbering
 // will mess with the serialization
 enum ItemType { DIRT = 0, FOOD = 1, EGG = 2 };
+constexpr ulong num_item_types = 3;
 
 struct ItemInfo {
     ItemType item;
@@ -37,7 +39,7 @@ class ItemInfoMap {
 class Inventory {
     ulong max_stack_count = 0, stack_size = 0, max_weight = 0;
     ulong stack_count = 0, total_weight = 0;
-    std::unordered_map<ItemType, ulong> items;
+    std::array<ulong, num_item_types> items = {};  // count of each ItemType
     ItemInfoMap const& item_info_map;
 
    public:
@@ -24,14 +24,14 @@ void IncrementScent::operator()(ulong& delta_scent) {
 }
 
 ScentReader::ScentReader(bool& scent_dir1, bool& dir_flag2,
-                         uchar const& is_space_empty_flag,
+                         Surroundings const& surroundings,
                          ulong const& priorities)
     : scent_dir1(scent_dir1),
       scent_dir2(dir_flag2),
-      is_space_empty_flag(is_space_empty_flag),
+      surroundings(surroundings),
       base_priorities(priorities) {}
 
-void ScentReader::operator()(ulong abs_scents[4]) {
+void ScentReader::operator()(ulong abs_scents[4], CounterRandom& random) {
     if(base_priorities == 0) return;
 
     // abs_scents - chunk directions: right, up, left, down
@@ -57,10 +57,11 @@ void ScentReader::operator()(ulong abs_scents[4]) {
         update_scent_and_sum(down_scent, down_scents, priority);
     }
 
-    bool can_move_right = is_space_empty_flag & 1;
-    bool can_move_up = (is_space_empty_flag >> 1) & 1;
-    bool can_move_left = (is_space_empty_flag >> 2) & 1;
-    bool can_move_down = (is_space_empty_flag >> 3) & 1;
+    uchar const empty_bits = surroundings.empty_bits();
+    bool can_move_right = empty_bits & 1;
+    bool can_move_up = (empty_bits >> 1) & 1;
+    bool can_move_left = (empty_bits >> 2) & 1;
+    bool can_move_down = (empty_bits >> 3) & 1;
 
     long min_scent =
         std::min({left_scent, right_scent, up_scent, down_scent}) - 1;
@@ -75,7 +76,7 @@ void ScentReader::operator()(ulong abs_scents[4]) {
 
     long total_scent = left_scent + right_scent + up_scent + down_scent + 1;
 
-    long rand_dir = rand() % total_scent;
+    long rand_dir = random.below(total_scent);
     long accumulated_value = 0;
 
     accumulated_value += right_scent;
@@ -104,6 +105,5 @@ void ScentReader::operator()(ulong abs_scents[4]) {
     scent_dir1 = true, scent_dir2 = true;
 }
 
-ScentBehaviors::ScentBehaviors(uchar const& is_space_empty_flag)
-    : read_scent_behavior(scent_dir1, scent_dir2, is_space_empty_flag,
-                          priorities) {}
+ScentBehaviors::ScentBehaviors(Surroundings const& surroundings)
+    : read_scent_behavior(scent_dir1, scent_dir2, surroundings, priorities) {}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "map/map.hpp"
+#include "utils/random.hpp"
 
 using schar = signed char;
 
@@ -54,13 +55,17 @@ using IncrementScentBehavior = ScentWriter<IncrementScent>;
 
 class ScentReader {
     bool &scent_dir1, &scent_dir2;
-    uchar const& is_space_empty_flag;
+    Surroundings const& surroundings;
     ulong const& base_priorities;
 
    public:
     ScentReader(bool& scent_dir1, bool& dir_flag2,
-                uchar const& is_space_empty_flag, ulong const& priorities);
-    void operator()(ulong abs_scents[4]);
+                Surroundings const& surroundings, ulong const& priorities);
+    // a copy would still read the flags and the surroundings of the original
+    ScentReader(ScentReader const&) = delete;
+    ScentReader& operator=(ScentReader const&) = delete;
+    // the turn is drawn from the random stream of the ant
+    void operator()(ulong abs_scents[4], CounterRandom& random);
 };
 
 struct ScentBehaviors {
@@ -69,5 +74,5 @@ struct ScentBehaviors {
     bool scent_dir1 = false, scent_dir2 = false;
     ulong priorities = 0;
 
-    ScentBehaviors(uchar const& is_space_empty_flag);
+    ScentBehaviors(Surroundings const& surroundings);
 };
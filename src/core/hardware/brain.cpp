@@ -2,11 +2,10 @@
 
 #include "spdlog/spdlog.h"
 
-DualRegisters::DualRegisters() : scent_behaviors(is_space_empty_flags) {}
+DualRegisters::DualRegisters() : scent_behaviors(surroundings) {}
 
 DualRegisters::DualRegisters(const ant_proto::DualRegisters& msg)
-    : scent_behaviors(is_space_empty_flags),
-      instr_ptr_register(msg.instr_ptr_register()),
+    : instr_ptr_register(msg.instr_ptr_register()),
       base_ptr_register(msg.base_ptr_register()),
       stack_ptr_register(msg.stack_ptr_register()),
       zero_flag(msg.zero_flag()),
@@ -14,7 +13,8 @@ DualRegisters::DualRegisters(const ant_proto::DualRegisters& msg)
       dir_flag1(msg.dir_flag1()),
       dir_flag2(msg.dir_flag2()),
       is_move_flag(msg.is_move_flag()),
-      is_dig_flag(msg.is_dig_flag()) {
+      is_dig_flag(msg.is_dig_flag()),
+      scent_behaviors(surroundings) {
     registers[0] = msg.register0();
     registers[1] = msg.register1();
     SPDLOG_TRACE(
@@ -22,12 +22,6 @@ DualRegisters::DualRegisters(const ant_proto::DualRegisters& msg)
         registers[0], registers[1], zero_flag ? "ON" : "OFF");
 }
 
-cpu_word_size& DualRegisters::operator[](size_t idx) { return registers[idx]; }
-
-cpu_word_size const& DualRegisters::operator[](size_t idx) const {
-    return registers[idx];
-}
-
 ant_proto::DualRegisters DualRegisters::get_proto() const {
     ant_proto::DualRegisters msg;
     msg.set_register0(registers[0]);
@@ -44,3 +38,9 @@ ant_proto::DualRegisters DualRegisters::get_proto() const {
 
     return msg;
 }
+
+size_t DualRegisters::hot_size() {
+    DualRegisters const cpu;
+    return reinterpret_cast<char const*>(&cpu.is_dig_flag + 1) -
+           reinterpret_cast<char const*>(&cpu);
+}
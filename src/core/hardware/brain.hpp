@@ -10,16 +10,19 @@
 using uchar = unsigned char;
 using ushort = unsigned short;
 
-struct DualRegisters {
+// The execution state of one ant. The fields every tick reads or writes come
+// first and share the first cache line - the ram and the scent state are only
+// touched by the stack ops, the scent ops and the sync steps so they start on
+// the next line.
+struct alignas(64) DualRegisters {
+    // Hot - the registers, the pointers, the wait and the flags
     cpu_word_size registers[2] = {0, 0};
-    cpu_word_size ram[64] = {};
-    ulong chunk_scents_list[4] = {};  // scents of chunks: right, up, left, down
-    ulong delta_scents = 0;           // delta scents of current chunk
-    ScentBehaviors scent_behaviors;
 
     ushort instr_ptr_register = 0;
     ushort base_ptr_register = 0;
     ushort stack_ptr_register = 0;
+    // ticks the last sync instruction waits - set by the executor
+    ushort instr_trigger = 0;
 
     bool zero_flag = 0;
     bool instr_failed_flag = 0;
@@ -35,20 +38,32 @@ struct DualRegisters {
     // sync flags
     bool is_move_flag = 0, is_dig_flag = 0;
 
-    // 4 bits - down(most-sig), left, up, right(lst-sig) (absolute - not
-    // relative to heading) all directions are stored so turns can be updated
-    // without checking the map which would generate a sync event and halt the
-    // async steps
-    uchar is_space_empty_flags = 0b1111;
+    // Cold
+    static constexpr ushort ram_size = 64;  // the stack lives in the ram
+    alignas(64) cpu_word_size ram[ram_size] = {};
+    ulong chunk_scents_list[4] = {};  // scents of chunks: right, up, left, down
+    ulong delta_scents = 0;           // delta scents of current chunk
+    // CHECK reads the map in the async steps - nothing writes it until the
+    // sync steps are done
+    Surroundings surroundings;
+    ScentBehaviors scent_behaviors;
 
-    ushort wait_move_tick_count = 12;  // 60 FPS / 5 moves per sec = 12
-    ushort wait_dig_tick_count = 4;    // 60 FPS / 15 digs per sec = 4
+    // Baked into the compiled program so they are shared by all ants
+    static constexpr ushort wait_move_tick_count = 12;  // 60 FPS / 5 moves/s
+    static constexpr ushort wait_dig_tick_count = 4;    // 60 FPS / 15 digs/s
 
     DualRegisters();
     DualRegisters(const ant_proto::DualRegisters& msg);
+    // the scent reader refers to the surroundings and the flags of this cpu
+    DualRegisters(DualRegisters const&) = delete;
+    DualRegisters& operator=(DualRegisters const&) = delete;
 
-    cpu_word_size& operator[](size_t idx);
-    cpu_word_size const& operator[](size_t idx) const;
+    cpu_word_size& operator[](size_t idx) { return registers[idx]; }
+    cpu_word_size const& operator[](size_t idx) const {
+        return registers[idx];
+    }
 
     ant_proto::DualRegisters get_proto() const;
+    // bytes from the start of the registers to the end of the hot fields
+    static size_t hot_size();
 };
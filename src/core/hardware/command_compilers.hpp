@@ -3,29 +3,35 @@
 #include "hardware/brain.hpp"
 #include "hardware/command_config.hpp"
 #include "hardware/compile_args.hpp"
-#include "hardware/op_def.hpp"
-#include "hardware/program_executor.hpp"
+#include "hardware/instruction.hpp"
 #include "spdlog/spdlog.h"
 
 using uchar = unsigned char;
 using schar = signed char;
 using ushort = unsigned short;
 
-template <typename Operation, unsigned short TickCount = 0>
+// The compilers only decode the operands of each command into an Instruction.
+// What the instruction does is defined by the matching op in op_def.hpp. The
+// ones with operand bytes check they are in the code before reading them.
+
+template <unsigned short TickCount = 0>
 struct NoArgCommandCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
-        args.ops.push_back({TickCount, Operation(args.cpu)});
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = TickCount;
+        args.instructions.push_back(instr);
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
-        (void)config;
     }
 };
 
-template <typename Operation, unsigned short TickCount = 0>
+template <unsigned short TickCount = 0>
 struct LoadConstantCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
+        if(!args.has_operands(4)) return;
         char const register_idx = ((*args.code_it) & 1);
 
         cpu_word_size const v0 = *(++args.code_it);
@@ -35,115 +41,129 @@ struct LoadConstantCompiler {
 
         cpu_word_size const value = v0 | (v1 << 8) | (v2 << 16) << (v3 << 24);
 
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, args.cpu[register_idx], value)});
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = TickCount;
+        instr.reg_dst = register_idx;
+        instr.value = value;
+        args.instructions.push_back(instr);
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
-        (void)config;
     }
 };
 
-template <typename Operation, unsigned short TickCount = 0>
+template <unsigned short TickCount = 0>
 struct TwoRegisterCommandCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
         uchar const register_names = *args.code_it;
-        uchar const reg_src_idx = ((register_names >> 1) & 1);
-        uchar const reg_dst_idx = (register_names & 1);
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, args.cpu[reg_src_idx],
-                                  args.cpu[reg_dst_idx])});
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = TickCount;
+        instr.reg_src = ((register_names >> 1) & 1);
+        instr.reg_dst = (register_names & 1);
+        args.instructions.push_back(instr);
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
-        (void)config;
     }
 };
 
-template <typename Operation, unsigned short TickCount = 0>
+template <unsigned short TickCount = 0>
 struct OneRegisterCommandCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
-        uchar const register_idx = (*args.code_it) & 1;
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, args.cpu[register_idx])});
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = TickCount;
+        instr.reg_dst = (*args.code_it) & 1;
+        args.instructions.push_back(instr);
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
-        (void)config;
     }
 };
 
-template <typename Operation>
 struct MoveAntCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
-        SPDLOG_TRACE("Compiling {} command - speed: {} tks / dig",
-                     config.command_string, args.cpu.wait_move_tick_count);
-        args.ops.push_back({args.cpu.wait_move_tick_count, MoveOp(args.cpu)});
+        SPDLOG_TRACE("Compiling {} command", config.command_string);
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = DualRegisters::wait_move_tick_count;
+        args.instructions.push_back(instr);
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled - speed: {} tks / move",
-                     config.command_string, args.cpu.wait_move_tick_count);
-        (void)config;
+                     config.command_string, DualRegisters::wait_move_tick_count);
     }
 };
 
-template <typename Operation>
 struct DigAntCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
-
-        args.ops.push_back({args.cpu.wait_dig_tick_count, DigOp(args.cpu)});
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = DualRegisters::wait_dig_tick_count;
+        args.instructions.push_back(instr);
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled - speed: {} tks / dig",
-                     config.command_string, args.cpu.wait_dig_tick_count);
-        (void)config;
+                     config.command_string, DualRegisters::wait_dig_tick_count);
     }
 };
 
-template <typename Operation, unsigned short TickCount = 0>
+template <unsigned short TickCount = 0>
 struct JumpCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
+        if(!args.has_operands(2)) return;
         ushort lower_half = *(++args.code_it);
         ushort upper_half = *(++args.code_it);
         ushort const address = lower_half | (upper_half << 8);
-        args.ops.push_back({TickCount, Operation(args.cpu, address)});
+
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = TickCount;
+        instr.set_target(address);
+        args.instructions.push_back(instr);
 
         ++args.code_it;
-        SPDLOG_TRACE("{} command compiled", config.command_string);
-        (void)config;
+        SPDLOG_TRACE("{} command compiled - jumping to: {}",
+                     config.command_string, address);
     }
 };
 
-template <typename Operation, unsigned short TickCount = 0>
+template <unsigned short TickCount = 0>
 struct OneScentCommandCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
-        uchar const scent_idx = (*args.code_it) & 0b111;
-        args.ops.push_back({TickCount, Operation(args.cpu, scent_idx)});
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = TickCount;
+        instr.scent_idx = (*args.code_it) & 0b111;
+        args.instructions.push_back(instr);
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
-        (void)config;
     }
 };
 
-template <typename Operation, unsigned short TickCount = 0>
+template <unsigned short TickCount = 0>
 struct SetScentPriorityCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
-        uchar const scent_idx = (*args.code_it) & 0b111;
+        if(!args.has_operands(1)) return;
+        Instruction instr;
+        instr.command = config.command_enum;
+        instr.num_ticks = TickCount;
+        instr.scent_idx = (*args.code_it) & 0b111;
         ++args.code_it;
 
-        uchar const priority = (*args.code_it);
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, scent_idx, priority)});
+        instr.value = (*args.code_it);
+        args.instructions.push_back(instr);
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
-        (void)config;
     }
 };
@@ -2,7 +2,6 @@
 
 #include "hardware/command_compilers.hpp"
 #include "hardware/command_parsers.hpp"
-#include "hardware/op_def.hpp"
 #include "hardware/parse_args.hpp"
 #include "spdlog/spdlog.h"
 
@@ -25,113 +24,115 @@ CommandMap::CommandMap() {
     // Empty command
     insert(new CommandConfig("NOP", CommandEnum::NOP, NoArgCommandParser(),
                              NoArgCommandDeparser(),
-                             NoArgCommandCompiler<NoOP, 1>()));
+                             NoArgCommandCompiler<1>()));
 
     // Load constant command to register
     insert(new CommandConfig("LOAD", CommandEnum::LOAD, LoadConstantParser(),
                              LoadConstantDeparser(),
-                             LoadConstantCompiler<LoadConstantOp>()));
+                             LoadConstantCompiler<>()));
 
     // Copy register to register
     insert(new CommandConfig(
         "COPY", CommandEnum::COPY, TwoRegisterCommandParser(),
-        TwoLetterCommandDeparser(), TwoRegisterCommandCompiler<CopyOp>()));
+        TwoLetterCommandDeparser(), TwoRegisterCommandCompiler<>()));
 
     // Add second register to the first
     insert(new CommandConfig(
         "ADD", CommandEnum::ADD, TwoRegisterCommandParser(),
-        TwoLetterCommandDeparser(), TwoRegisterCommandCompiler<AddOp>()));
+        TwoLetterCommandDeparser(), TwoRegisterCommandCompiler<>()));
 
     // Subtract second register from the first
     insert(new CommandConfig(
         "SUB", CommandEnum::SUB, TwoRegisterCommandParser(),
-        TwoLetterCommandDeparser(), TwoRegisterCommandCompiler<SubOp>()));
+        TwoLetterCommandDeparser(), TwoRegisterCommandCompiler<>()));
 
     // Increment register
     insert(new CommandConfig(
         "INC", CommandEnum::INC, OneRegisterCommandParser(),
-        OneLetterCommandDeparser(), OneRegisterCommandCompiler<IncOp>()));
+        OneLetterCommandDeparser(), OneRegisterCommandCompiler<>()));
 
     // Decrement register
     insert(new CommandConfig(
         "DEC", CommandEnum::DEC, OneRegisterCommandParser(),
-        OneLetterCommandDeparser(), OneRegisterCommandCompiler<DecOp>()));
+        OneLetterCommandDeparser(), OneRegisterCommandCompiler<>()));
 
     // MOVE command
     insert(new CommandConfig("MOVE", CommandEnum::MOVE, NoArgCommandParser(),
                              NoArgCommandDeparser(),
-                             MoveAntCompiler<MoveOp>()));
+                             MoveAntCompiler()));
 
     // DIG command
     insert(new CommandConfig("DIG", CommandEnum::DIG, NoArgCommandParser(),
-                             NoArgCommandDeparser(), DigAntCompiler<DigOp>()));
+                             NoArgCommandDeparser(), DigAntCompiler()));
 
     // JMP command
     insert(new CommandConfig("JMP", CommandEnum::JMP, JumpParser(),
-                             JumpDeparser(), JumpCompiler<JmpOp>()));
+                             JumpDeparser(), JumpCompiler<>()));
 
     // JNZ command
     insert(new CommandConfig("JNZ", CommandEnum::JNZ, JumpParser(),
-                             JumpDeparser(), JumpCompiler<JnzOp>()));
+                             JumpDeparser(), JumpCompiler<>()));
 
     // JNF command
     insert(new CommandConfig("JNF", CommandEnum::JNF, JumpParser(),
-                             JumpDeparser(), JumpCompiler<JnfOp>()));
+                             JumpDeparser(), JumpCompiler<>()));
 
     // CALL command
     insert(new CommandConfig("CALL", CommandEnum::CALL, JumpParser(),
-                             JumpDeparser(), JumpCompiler<CallOp>()));
+                             JumpDeparser(), JumpCompiler<>()));
 
     // LEFT command
     insert(new CommandConfig("LT", CommandEnum::LT, NoArgCommandParser(),
                              NoArgCommandDeparser(),
-                             NoArgCommandCompiler<TurnLeftOp>()));
+                             NoArgCommandCompiler<>()));
 
     // POP command
     insert(new CommandConfig(
         "POP", CommandEnum::POP, OneRegisterCommandParser(),
-        OneLetterCommandDeparser(), OneRegisterCommandCompiler<PopOp>()));
+        OneLetterCommandDeparser(), OneRegisterCommandCompiler<>()));
 
     // PUSH command
     insert(new CommandConfig(
         "PUSH", CommandEnum::PUSH, OneRegisterCommandParser(),
-        OneLetterCommandDeparser(), OneRegisterCommandCompiler<PushOp>()));
+        OneLetterCommandDeparser(), OneRegisterCommandCompiler<>()));
 
     // RIGHT command
     insert(new CommandConfig("RT", CommandEnum::RT, NoArgCommandParser(),
                              NoArgCommandDeparser(),
-                             NoArgCommandCompiler<TurnRightOp>()));
+                             NoArgCommandCompiler<>()));
 
     // RETURN command
     insert(new CommandConfig("RET", CommandEnum::RET, NoArgCommandParser(),
                              NoArgCommandDeparser(),
-                             NoArgCommandCompiler<ReturnOp>()));
+                             NoArgCommandCompiler<>()));
 
     // CHECK command
     insert(new CommandConfig("CHK", CommandEnum::CHECK, NoArgCommandParser(),
                              NoArgCommandDeparser(),
-                             NoArgCommandCompiler<CheckOp>()));
+                             NoArgCommandCompiler<>()));
 
     // SCENT WRITE ON command
     insert(new CommandConfig(
         "SWN", CommandEnum::SCENT_ON, OneScentCommandParser(),
-        OneLetterCommandDeparser(), OneScentCommandCompiler<ScentOnOp>()));
+        OneLetterCommandDeparser(), OneScentCommandCompiler<>()));
 
     // SCENT WRITE OFF command
     insert(new CommandConfig("SWF", CommandEnum::SCENT_OFF,
                              NoArgCommandParser(), NoArgCommandDeparser(),
-                             NoArgCommandCompiler<ScentOffOp>()));
+                             NoArgCommandCompiler<>()));
 
     // SET SCENT READ PRIORITY command
     insert(new CommandConfig("SWP", CommandEnum::SET_SCENT_PRIORITY,
                              SetScentPriorityParser(),
                              SetScentPriorityDeparser(),
-                             SetScentPriorityCompiler<SetScentPriorityOp>()));
+                             SetScentPriorityCompiler<>()));
 
     // TURN BY SCENT command
     insert(new CommandConfig("SRT", CommandEnum::TURN_SCENT,
                              NoArgCommandParser(), NoArgCommandDeparser(),
-                             NoArgCommandCompiler<TurnByScentOp>()));
+                             NoArgCommandCompiler<>()));
+
+    build_opcode_table();
 }
 
 CommandMap::~CommandMap() {
@@ -183,3 +184,47 @@ CommandMap::StrMap::const_iterator CommandMap::find(
 CommandMap::StrMap::const_iterator CommandMap::str_end() const {
     return str_map.end();
 }
+
+// Seeded FNV-1a of the string reduced to a table slot
+ulong CommandMap::opcode_slot(std::string_view command_string, ulong seed) {
+    ulong hash = 0xcbf29ce484222325 ^ seed;
+    for(char c : command_string) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+    return (hash ^ (hash >> 32)) & (opcode_table_size - 1);
+}
+
+// Tries seeds until every command string lands on its own slot, so a lookup
+// is one hash and one string compare
+void CommandMap::build_opcode_table() {
+    for(ulong seed = 0; seed < 1 << 16; ++seed) {
+        opcode_table.fill(nullptr);
+        bool is_perfect = true;
+        for(auto const& [command_string, config] : str_map) {
+            CommandConfig const*& slot =
+                opcode_table[opcode_slot(command_string, seed)];
+            if(slot != nullptr) {
+                is_perfect = false;
+                break;
+            }
+            slot = config;
+        }
+        if(!is_perfect) continue;
+        opcode_seed = seed;
+        has_opcode_table = true;
+        SPDLOG_TRACE("Built the opcode table - seed: {}", seed);
+        return;
+    }
+    SPDLOG_WARN("No perfect hash of the commands - using the string map");
+}
+
+CommandConfig const* CommandMap::find_command(std::string_view word) const {
+    if(!has_opcode_table) {
+        auto it = str_map.find(std::string(word));
+        return it == str_map.end() ? nullptr : it->second;
+    }
+    CommandConfig const* config = opcode_table[opcode_slot(word, opcode_seed)];
+    if(config == nullptr || config->command_string != word) return nullptr;
+    return config;
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <array>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+
+using ulong = unsigned long;
 
 struct ParseArgs;
 struct DeparseArgs;
@@ -33,6 +38,10 @@ enum CommandEnum {
     TURN_SCENT = 0b10110
 };
 
+// A set of commands - one bit per CommandEnum
+using CommandMask = unsigned int;
+constexpr CommandMask command_bit(CommandEnum command) { return 1u << command; }
+
 struct CommandConfig {
     std::string command_string;
     CommandEnum command_enum;
@@ -52,6 +61,15 @@ class CommandMap {
     using StrMap = std::unordered_map<std::string, CommandConfig*>;
     EnumMap enum_map;
     StrMap str_map;
+    // Collision free table of the command strings for the parser - the seed
+    // is searched for once the commands are inserted
+    static constexpr ulong opcode_table_size = 64;
+    std::array<CommandConfig const*, opcode_table_size> opcode_table = {};
+    ulong opcode_seed = 0;
+    bool has_opcode_table = false;
+
+    static ulong opcode_slot(std::string_view command_string, ulong seed);
+    void build_opcode_table();
 
    public:
     CommandMap();
@@ -66,4 +84,6 @@ class CommandMap {
     EnumMap::const_iterator enum_end() const;
     StrMap::const_iterator find(std::string const&) const;
     StrMap::const_iterator str_end() const;
+    // nullptr if the word is not a command
+    CommandConfig const* find_command(std::string_view word) const;
 };
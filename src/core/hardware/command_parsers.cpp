@@ -1,8 +1,9 @@
 #include "hardware/command_parsers.hpp"
 
+#include <string>
+
 #include "hardware/brain.hpp"
 #include "hardware/command_config.hpp"
-#include "hardware/op_def.hpp"
 #include "hardware/parse_args.hpp"
 #include "hardware/program_executor.hpp"
 #include "hardware/token_parser.hpp"
@@ -15,7 +16,7 @@ void NoArgCommandParser::operator()(CommandConfig const& config,
                                     ParseArgs& args) {
     SPDLOG_TRACE("Parsing {} command - no args", config.command_string);
     args.code.push_back(config.command_enum << 3);
-    TokenParser::terminate(args.code_stream, args.status, config.command_string,
+    TokenParser::terminate(args.tokens, args.status, config.command_string,
                            "expecting no args");
     SPDLOG_TRACE("{} command parsed", config.command_string);
 }
@@ -32,8 +33,8 @@ void LoadConstantParser::operator()(CommandConfig const& config,
                                     ParseArgs& args) {
     SPDLOG_TRACE("Parsing {} command", config.command_string);
     uchar instruction = CommandEnum::LOAD;
-    uchar const register_idx = TokenParser::letter_idx(args.code_stream);
-    cpu_word_size const value = TokenParser::integer(args.code_stream);
+    uchar const register_idx = TokenParser::letter_idx(args.tokens);
+    cpu_word_size const value = TokenParser::integer(args.tokens, args.status);
 
     // Instruction + register
     args.code.push_back((instruction << 3) | (register_idx & 1));
@@ -44,7 +45,7 @@ void LoadConstantParser::operator()(CommandConfig const& config,
     args.code.push_back((value >> 16) & 0xFF);
     args.code.push_back((value >> 24) & 0xFF);
 
-    TokenParser::terminate(args.code_stream, args.status, config.command_string,
+    TokenParser::terminate(args.tokens, args.status, config.command_string,
                            "expecting 2 args");
     SPDLOG_TRACE("{} command parsed", config.command_string);
 }
@@ -61,9 +62,11 @@ void LoadConstantDeparser::operator()(CommandConfig const& config,
     uchar const v3 = *(++args.code_it);
     cpu_word_size const value = v0 | (v1 << 8) | (v2 << 16) << (v3 << 24);
 
-    std::stringstream ss;
-    ss << config.command_string << " " << register_name << " " << value;
-    args.lines.push_back(ss.str());
+    std::string& line = args.lines.emplace_back(config.command_string);
+    line += ' ';
+    line += register_name;
+    line += ' ';
+    line += std::to_string(value);
     ++args.code_it;
     SPDLOG_TRACE("{} command deparsed", config.command_string);
 }
@@ -72,13 +75,13 @@ void TwoRegisterCommandParser::operator()(CommandConfig const& config,
                                           ParseArgs& args) {
     SPDLOG_TRACE("Parsing {} command", config.command_string);
     uchar const instruction = config.command_enum;
-    uchar const reg_src_idx = TokenParser::letter_idx(args.code_stream);
-    uchar const reg_dst_idx = TokenParser::letter_idx(args.code_stream);
+    uchar const reg_src_idx = TokenParser::letter_idx(args.tokens);
+    uchar const reg_dst_idx = TokenParser::letter_idx(args.tokens);
 
     args.code.push_back((instruction << 3) | ((reg_src_idx << 1) & 1) |
                         (reg_dst_idx & 1));
 
-    TokenParser::terminate(args.code_stream, args.status, config.command_string,
+    TokenParser::terminate(args.tokens, args.status, config.command_string,
                            "expecting 2 arguments");
     SPDLOG_TRACE("{} command parsed", config.command_string);
 }
@@ -90,9 +93,11 @@ void TwoLetterCommandDeparser::operator()(CommandConfig const& config,
     uchar const reg_src = 'A' + ((register_names >> 1) & 1);
     uchar const reg_dst = 'A' + (register_names & 1);
 
-    std::stringstream ss;
-    ss << config.command_string << " " << reg_src << " " << reg_dst;
-    args.lines.push_back(ss.str());
+    std::string& line = args.lines.emplace_back(config.command_string);
+    line += ' ';
+    line += reg_src;
+    line += ' ';
+    line += reg_dst;
 
     ++args.code_it;
     SPDLOG_TRACE("{} command deparsed", config.command_string);
@@ -102,11 +107,11 @@ void OneRegisterCommandParser::operator()(CommandConfig const& config,
                                           ParseArgs& args) {
     SPDLOG_TRACE("Parsing {} command", config.command_string);
     uchar const instruction = config.command_enum;
-    uchar const register_idx = TokenParser::letter_idx(args.code_stream);
+    uchar const register_idx = TokenParser::letter_idx(args.tokens);
 
     args.code.push_back((instruction << 3) | (register_idx & 1));
 
-    TokenParser::terminate(args.code_stream, args.status, config.command_string,
+    TokenParser::terminate(args.tokens, args.status, config.command_string,
                            "expecting 2 arguments");
     SPDLOG_TRACE("{} command parsed", config.command_string);
 }
@@ -116,9 +121,9 @@ void OneLetterCommandDeparser::operator()(CommandConfig const& config,
     SPDLOG_TRACE("Deparsing {} command", config.command_string);
     uchar const reg_name = 'A' + ((*args.code_it) & 1);
 
-    std::stringstream ss;
-    ss << config.command_string << " " << reg_name;
-    args.lines.push_back(ss.str());
+    std::string& line = args.lines.emplace_back(config.command_string);
+    line += ' ';
+    line += reg_name;
 
     ++args.code_it;
     SPDLOG_TRACE("{} command deparsed", config.command_string);
@@ -127,14 +132,20 @@ void OneLetterCommandDeparser::operator()(CommandConfig const& config,
 void JumpParser::operator()(CommandConfig const& config, ParseArgs& args) {
     SPDLOG_TRACE("Parsing {} command", config.command_string);
     uchar const instruction = config.command_enum;
-    std::string label = TokenParser::get_label(args.code_stream, args.status);
-    ushort const label_idx = args.labels.at(label);
+    std::string_view const label =
+        TokenParser::get_label(args.tokens, args.status);
+    if(args.status.p_err) return;
+    ushort const* const label_idx = args.labels.find(label);
+    if(label_idx == nullptr) {
+        args.status.error("UNDEFINED LABEL: " + std::string(label));
+        return;
+    }
 
     args.code.push_back(instruction << 3);
-    args.code.push_back(label_idx & 0xFF);
-    args.code.push_back((label_idx >> 8) & 0xFF);
+    args.code.push_back(*label_idx & 0xFF);
+    args.code.push_back((*label_idx >> 8) & 0xFF);
 
-    TokenParser::terminate(args.code_stream, args.status, config.command_string,
+    TokenParser::terminate(args.tokens, args.status, config.command_string,
                            "expecting 1 argument");
     SPDLOG_TRACE("{} command parsed", config.command_string);
 }
@@ -145,9 +156,9 @@ void JumpDeparser::operator()(CommandConfig const& config, DeparseArgs& args) {
     ushort const label_idx = (*(++args.code_it)) | ((*(++args.code_it)) << 8);
     std::string const& label = args.labels.at(label_idx);
 
-    std::stringstream ss;
-    ss << config.command_string << " " << label;
-    args.lines.push_back(ss.str());
+    std::string& line = args.lines.emplace_back(config.command_string);
+    line += ' ';
+    line += label;
 
     ++args.code_it;
     SPDLOG_TRACE("{} command deparsed", config.command_string);
@@ -157,11 +168,11 @@ void OneScentCommandParser::operator()(CommandConfig const& config,
                                        ParseArgs& args) {
     SPDLOG_TRACE("Parsing {} command", config.command_string);
     uchar const instruction = config.command_enum;
-    uchar const scent_idx = TokenParser::letter_idx(args.code_stream);
+    uchar const scent_idx = TokenParser::letter_idx(args.tokens);
 
     args.code.push_back((instruction << 3) | (scent_idx & 0b111));
 
-    TokenParser::terminate(args.code_stream, args.status, config.command_string,
+    TokenParser::terminate(args.tokens, args.status, config.command_string,
                            "expecting 2 arguments");
     SPDLOG_TRACE("{} command parsed", config.command_string);
 }
@@ -170,15 +181,15 @@ void SetScentPriorityParser::operator()(CommandConfig const& config,
                                         ParseArgs& args) {
     SPDLOG_TRACE("Parsing {} command", config.command_string);
     uchar const instruction = config.command_enum;
-    uchar const scent_idx = TokenParser::letter_idx(args.code_stream);
+    uchar const scent_idx = TokenParser::letter_idx(args.tokens);
 
     args.code.push_back((instruction << 3) | (scent_idx & 0b111));
 
     schar priority =
-        TokenParser::get_signed_byte(args.code_stream, args.status);
+        TokenParser::get_signed_byte(args.tokens, args.status);
     args.code.push_back(static_cast<uchar>(priority));
 
-    TokenParser::terminate(args.code_stream, args.status, config.command_string,
+    TokenParser::terminate(args.tokens, args.status, config.command_string,
                            "expecting 3 arguments");
     SPDLOG_TRACE("{} command parsed", config.command_string);
 }
@@ -188,12 +199,11 @@ void SetScentPriorityDeparser::operator()(CommandConfig const& config,
     SPDLOG_TRACE("Deparsing {} command", config.command_string);
     uchar const reg_name = 'A' + ((*args.code_it) & 1);
     schar const priority = static_cast<schar>(*(++args.code_it));
-    std::string sign = priority < 0 ? "-" : "";
-
-    std::stringstream ss;
-    ss << config.command_string << " " << reg_name << " " << sign
-       << std::abs(priority);
-    args.lines.push_back(ss.str());
+    std::string& line = args.lines.emplace_back(config.command_string);
+    line += ' ';
+    line += reg_name;
+    line += ' ';
+    line += std::to_string(priority);
 
     ++args.code_it;
     SPDLOG_TRACE("{} command deparsed", config.command_string);
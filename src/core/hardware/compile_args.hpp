@@ -1,22 +1,35 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
-#include "hardware/program_executor.hpp"
+#include "hardware/control_flow.hpp"
+#include "hardware/instruction.hpp"
 #include "utils/status.hpp"
 
 using uchar = unsigned char;
 
-struct DualRegisters;
-
 struct CompileArgs {
     std::vector<uchar> const& code;
     std::vector<uchar>::const_iterator code_it;
-    DualRegisters& cpu;
-    std::vector<Op>& ops;
+    std::vector<Instruction>& instructions;
     Status status;
+    bool is_optimized = true;  // run the peephole pass after decoding
+    bool is_busy = false;      // never reaches a sync instruction or the end
+    std::vector<CountedLoop> loops;
+    std::vector<short> entry_depths;  // see Verifier::verify
+
+    CompileArgs(std::vector<uchar> const& code,
+                std::vector<Instruction>& instructions)
+        : code(code), code_it(code.begin()), instructions(instructions) {}
 
-    CompileArgs(std::vector<uchar> const& code, DualRegisters& cpu,
-                std::vector<Op>& ops)
-        : code(code), code_it(code.begin()), cpu(cpu), ops(ops) {}
+    // True if the count operand bytes after the opcode at code_it are in the
+    // code. Sets an error on the status otherwise.
+    bool has_operands(long count) {
+        if(code.end() - code_it > count) return true;
+        status.error("INSTRUCTION " + std::to_string(instructions.size()) +
+                     " BREAKS THE RULE: EVERY INSTRUCTION HAS ITS OPERANDS - "
+                     "THE CODE ENDS INSIDE IT");
+        return false;
+    }
 };
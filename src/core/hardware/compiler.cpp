@@ -1,11 +1,31 @@
 #include "hardware/compiler.hpp"
 
+#include <string>
+
+#include "hardware/control_flow.hpp"
+#include "hardware/optimizer.hpp"
+#include "hardware/verifier.hpp"
+
 Compiler::Compiler(CommandMap const& command_map) : command_map(command_map) {}
 
-void Compiler::compile(CompileArgs& args) {
+void Compiler::compile(CompileArgs& args) const {
     while(args.code_it != args.code.end()) {
         CommandEnum instruction = static_cast<CommandEnum>(*args.code_it >> 3);
-        CommandConfig const& command = command_map.at(instruction);
-        command.compile(command, args);
+        auto const command = command_map.find(instruction);
+        if(command == command_map.enum_end()) {
+            args.status.error("INSTRUCTION " +
+                              std::to_string(args.instructions.size()) +
+                              " BREAKS THE RULE: EVERY OPCODE IS A COMMAND - "
+                              "OPCODE " +
+                              std::to_string(instruction) + " IS NOT");
+            return;
+        }
+        command->second->compile(*command->second, args);
+        if(args.status.p_err) return;
     }
+    Verifier::verify(args.instructions, args.status, args.entry_depths);
+    if(args.status.p_err) return;
+
+    args.is_busy = ControlFlowGraph(args.instructions).is_busy();
+    if(args.is_optimized) Optimizer::optimize(args);
 }
@@ -12,7 +12,7 @@ class Compiler {
    public:
     Compiler(CommandMap const& command_map);
 
-    void compile(CompileArgs& args);
+    void compile(CompileArgs& args) const;
 
     CommandMap const& command_map;
 };
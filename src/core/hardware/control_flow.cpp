@@ -0,0 +1,155 @@
+#include "hardware/control_flow.hpp"
+
+#include <deque>
+
+#include "hardware/command_config.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+    using Program = std::vector<Instruction>;
+}  // namespace
+
+bool is_jump_command(uchar command) {
+    return command == CommandEnum::JMP || command == CommandEnum::JNZ ||
+           command == CommandEnum::JNF || command == CommandEnum::CALL;
+}
+
+ControlFlowGraph::ControlFlowGraph(Program const& program) {
+    size_t const size = program.size();
+    std::vector<bool> is_leader(size + 1, false);
+    std::vector<ushort> return_addresses;
+    is_leader[0] = true;
+    for(size_t i = 0; i < size; ++i) {
+        uchar const command = program[i].command;
+        if(is_jump_command(command)) {
+            ushort const target = program[i].get_target();
+            if(target < size) is_leader[target] = true;
+            is_leader[i + 1] = true;
+        } else if(command == CommandEnum::RET) {
+            is_leader[i + 1] = true;
+        }
+        if(command == CommandEnum::CALL) return_addresses.push_back(i + 1);
+    }
+
+    std::vector<ushort> block_of(size);
+    for(size_t i = 0; i < size; ++i) {
+        if(is_leader[i]) {
+            blocks.emplace_back();
+            blocks.back().begin = i;
+        }
+        BasicBlock& block = blocks.back();
+        block.end = i + 1;
+        block.has_sync |= program[i].num_ticks != 0;
+        block_of[i] = blocks.size() - 1;
+    }
+
+    for(BasicBlock& block : blocks) {
+        Instruction const& last = program[block.end - 1];
+        switch(last.command) {
+            case CommandEnum::JMP:
+            case CommandEnum::CALL:
+                add_successor(block, last.get_target(), block_of);
+                break;
+            case CommandEnum::JNZ:
+            case CommandEnum::JNF:
+                add_successor(block, last.get_target(), block_of);
+                add_successor(block, block.end, block_of);
+                break;
+            case CommandEnum::RET:
+                if(return_addresses.empty()) {
+                    for(BasicBlock const& other : blocks)
+                        add_successor(block, other.begin, block_of);
+                }
+                for(ushort address : return_addresses)
+                    add_successor(block, address, block_of);
+                break;
+            default:
+                add_successor(block, block.end, block_of);
+        }
+    }
+    SPDLOG_TRACE("Built control flow graph - instructions: {} blocks: {}",
+                 size, blocks.size());
+}
+
+void ControlFlowGraph::add_successor(BasicBlock& block, ulong address,
+                                     std::vector<ushort> const& block_of) {
+    if(address >= block_of.size()) {
+        block.is_exit = true;
+    } else {
+        block.successors.push_back(block_of[address]);
+    }
+}
+
+bool ControlFlowGraph::is_busy() const {
+    if(blocks.empty()) return false;
+
+    std::vector<bool> is_visited(blocks.size(), false);
+    std::deque<ushort> queue = {0};
+    is_visited[0] = true;
+    while(!queue.empty()) {
+        BasicBlock const& block = blocks[queue.front()];
+        queue.pop_front();
+        if(block.has_sync || block.is_exit) return false;
+        for(ushort successor : block.successors) {
+            if(is_visited[successor]) continue;
+            is_visited[successor] = true;
+            queue.push_back(successor);
+        }
+    }
+    return true;
+}
+
+void ControlFlowGraph::find_counted_loops(
+    Program const& program, std::vector<CountedLoop>& loops) const {
+    for(BasicBlock const& block : blocks) {
+        ushort const jump = block.end - 1;
+        uchar const command = program[jump].command;
+        if(command != CommandEnum::JNZ && command != CommandEnum::JMP) continue;
+        // a threaded jump costs more than the one dispatch
+        if(program[jump].length != 1) continue;
+        if(program[jump].get_target() != block.begin || jump == block.begin)
+            continue;
+
+        CountedLoop loop;
+        bool is_closed_form = true;
+        bool is_written[2] = {false, false};
+        bool is_scaled[2] = {false, false};
+        for(ushort i = block.begin; i < jump && is_closed_form; ++i) {
+            Instruction const& instr = program[i];
+            is_written[instr.reg_dst] = true;
+            switch(instr.command) {
+                case CommandEnum::INC:
+                    ++loop.step[instr.reg_dst];
+                    break;
+                case CommandEnum::DEC:
+                    --loop.step[instr.reg_dst];
+                    break;
+                case CommandEnum::ADD:
+                    is_closed_form = instr.reg_src != instr.reg_dst;
+                    is_scaled[instr.reg_dst] = true;
+                    ++loop.scale[instr.reg_dst];
+                    break;
+                case CommandEnum::SUB:
+                    is_closed_form = instr.reg_src != instr.reg_dst;
+                    is_scaled[instr.reg_dst] = true;
+                    --loop.scale[instr.reg_dst];
+                    break;
+                default:
+                    is_closed_form = false;
+            }
+        }
+        // adding a register that changes inside the loop is not linear
+        for(uchar reg = 0; reg < 2; ++reg) {
+            if(is_scaled[reg] && is_written[1 - reg]) is_closed_form = false;
+        }
+        if(!is_closed_form) continue;
+
+        loop.begin = block.begin;
+        loop.end = jump;
+        loop.flag_register = program[jump - 1].reg_dst;
+        loop.dispatches = jump - block.begin + 1;
+        loops.push_back(loop);
+        SPDLOG_TRACE("Found counted loop at addresses {} - {}", loop.begin,
+                     loop.end);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "hardware/instruction.hpp"
+
+using ulong = unsigned long;
+
+// JMP, JNZ, JNF or CALL - the commands with a target address
+bool is_jump_command(uchar command);
+
+// Straight line run of instructions. Control only enters at begin and only
+// leaves after the last instruction.
+struct BasicBlock {
+    ushort begin = 0;
+    ushort end = 0;                  // one past the last instruction
+    bool has_sync = false;           // holds an instruction that waits ticks
+    bool is_exit = false;            // can run past the end of the program
+    std::vector<ushort> successors;  // block indices
+};
+
+// Loop made of a single block of INC / DEC / ADD / SUB that jumps back to its
+// first instruction with a JNZ or JMP. Every iteration adds
+// step[r] + scale[r] * other register to register r. The scale is only set when
+// the other register does not change in the loop, so the deltas are constant
+// for as long as the loop runs and any number of iterations has a closed form.
+struct CountedLoop {
+    ushort begin = 0;          // first instruction of the body
+    ushort end = 0;            // the jump back to begin
+    uchar flag_register = 0;   // set by the last op - tested by the JNZ
+    ulong dispatches = 0;      // per iteration including the jump back
+    cpu_word_size step[2] = {0, 0};
+    cpu_word_size scale[2] = {0, 0};
+};
+
+// Blocks and edges of a decoded program. A RET may return after any CALL so
+// it gets every return address as a successor, or every block if the program
+// has no CALL.
+class ControlFlowGraph {
+    std::vector<BasicBlock> blocks;
+
+    void add_successor(BasicBlock& block, ulong address,
+                       std::vector<ushort> const& block_of);
+
+   public:
+    explicit ControlFlowGraph(std::vector<Instruction> const& program);
+
+    std::vector<BasicBlock> const& get_blocks() const { return blocks; }
+
+    // True if the entry can neither reach a sync instruction nor the end of
+    // the program - the program then uses its whole budget every tick
+    bool is_busy() const;
+
+    // Appends the single block loops whose effect has a closed form
+    void find_counted_loops(std::vector<Instruction> const& program,
+                            std::vector<CountedLoop>& loops) const;
+};
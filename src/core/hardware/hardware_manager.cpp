@@ -1,23 +1,295 @@
 #include "hardware/hardware_manager.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <unordered_set>
+
 #include "hardware.pb.h"
+#include "hardware/brain.hpp"
+#include "hardware/image_swap.hpp"
+#include "hardware/machine_code.hpp"
 #include "hardware/program_executor.hpp"
+#include "hardware/program_image.hpp"
+#include "spdlog/spdlog.h"
 #include "utils/serializer.hpp"
 
-HardwareManager::HardwareManager(CommandMap const& command_map)
-    : compiler(command_map) {}
+HardwareManager::HardwareManager(CommandMap const& command_map,
+                                 ulong const& instr_clock)
+    : instr_clock(instr_clock), compiler(command_map) {}
 HardwareManager::HardwareManager(const ant_proto::HardwareManager&,
-                                 CommandMap const& command_map)
-    : compiler(command_map) {
+                                 CommandMap const& command_map,
+                                 ulong const& instr_clock)
+    : instr_clock(instr_clock), compiler(command_map) {
     // Does not take ownership of program executor objects.
     SPDLOG_TRACE("Not unpacking empty hardware manager");
 }
-// Does not take ownership
+// Does not take ownership - the executor is visited on the next tick. An
+// executor that is already registered is only pointed at its new image.
 void HardwareManager::push_back(ProgramExecutor* exec) {
+    if(exec->is_registered) return;
+    exec->is_registered = true;
     exec_list.push_back(exec);
+    ready_list.push_back(exec);
+}
+
+HardwareManager::~HardwareManager() = default;
+
+// Returns the shared image for the machine code - only compiled the first time
+// the code is seen. Returns nullptr if the code fails to compile.
+ProgramImage const* HardwareManager::compile(MachineCode const& machine_code) {
+    if(ProgramImage const* image = find(machine_code)) {
+        SPDLOG_TRACE("Reusing compiled program image - hash: {}",
+                     image->hash);
+        return image;
+    }
+    return add_image(build_image(machine_code));
+}
+
+// Same as compile on each of the machine codes, with the codes that have no
+// image yet compiled once each as jobs of the pool. Sets compiled to the image
+// of each code, nullptr where it fails to compile.
+void HardwareManager::compile_all(
+    std::vector<MachineCode const*> const& machine_codes,
+    std::vector<ProgramImage const*>& compiled,
+    ThreadPool<PoolJob>& job_pool) {
+    compiled.assign(machine_codes.size(), nullptr);
+    // index of the first code equal to each code - only those are compiled
+    std::vector<ulong> sources(machine_codes.size());
+    std::unordered_map<MachineCode const*, ulong> seen;
+    std::unordered_multimap<ulong, ulong> firsts;
+    std::vector<ulong> new_codes;
+    for(ulong i = 0; i < machine_codes.size(); ++i) {
+        MachineCode const& machine_code = *machine_codes[i];
+        // the same object is not hashed again
+        auto [seen_it, is_new] = seen.emplace(&machine_code, i);
+        sources[i] = seen_it->second;
+        if(!is_new) continue;
+        ulong const hash = machine_code.hash();
+        auto [it, end] = firsts.equal_range(hash);
+        for(; it != end; ++it) {
+            if(machine_codes[it->second]->code != machine_code.code) continue;
+            sources[i] = it->second;
+            break;
+        }
+        if(sources[i] != i) continue;
+        firsts.emplace(hash, i);
+        compiled[i] = find(machine_code);
+        if(!compiled[i]) new_codes.push_back(i);
+    }
+
+    std::vector<std::unique_ptr<ProgramImage>> built(new_codes.size());
+    if(!new_codes.empty()) {
+        for(ulong i = 0; i < new_codes.size(); ++i) {
+            CompileJob job{this, machine_codes[new_codes[i]], &built[i]};
+            job_pool.submit_job(job);
+        }
+        job_pool.await_jobs();
+    }
+    // added in the order of the codes so the versions do not depend on the
+    // order the jobs finished in
+    for(ulong i = 0; i < new_codes.size(); ++i)
+        compiled[new_codes[i]] = add_image(std::move(built[i]));
+    for(ulong i = 0; i < machine_codes.size(); ++i)
+        compiled[i] = compiled[sources[i]];
+    SPDLOG_DEBUG("Compiled {} new program images for {} machine codes",
+                 new_codes.size(), machine_codes.size());
+}
+
+// Compiles the machine code into a new image that is not added to the
+// manager. Safe to call from several threads at once. Returns nullptr if the
+// code fails to compile.
+std::unique_ptr<ProgramImage> HardwareManager::build_image(
+    MachineCode const& machine_code) const {
+    auto image = std::make_unique<ProgramImage>();
+    image->hash = machine_code.hash();
+    image->code = machine_code.code;
+    CompileArgs args(image->code, image->instructions);
+    compiler.compile(args);
+    if(args.status.p_err) {
+        SPDLOG_ERROR("Rejected program - hash: {} - {}", image->hash,
+                     args.status.err_msg);
+        return nullptr;
+    }
+    image->seal();
+    if(is_jit) image->jit = JitProgram::compile(*image);
+    if constexpr(ExecutorProfiler::is_enabled)
+        image->profile = std::make_unique<ProgramProfile>(image->size());
+    image->loops = std::move(args.loops);
+    image->entry_depths = std::move(args.entry_depths);
+    image->is_busy = args.is_busy;
+    if(image->is_busy) {
+        SPDLOG_WARN(
+            "Program never reaches a sync instruction - it uses its whole "
+            "budget every tick - hash: {}",
+            image->hash);
+    }
+    return image;
+}
+
+// Takes ownership of a built image and gives it the next version
+ProgramImage const* HardwareManager::add_image(
+    std::unique_ptr<ProgramImage> image) {
+    if(image == nullptr) return nullptr;
+    image->version = ++last_version;
+    SPDLOG_DEBUG(
+        "Compiled new program image - hash: {} version: {} instructions: {}",
+        image->hash, image->version, image->size());
+    ProgramImage const* added = image.get();
+    images.emplace(added->hash, std::move(image));
+    return added;
+}
+
+// Moves the executors to the image of the machine code at the start of the
+// next tick, all of them at once - see ImageSwap. Returns false and leaves the
+// executors on their image if the code fails to compile.
+bool HardwareManager::swap(std::vector<ProgramExecutor*> const& execs,
+                           MachineCode const& machine_code) {
+    ProgramImage const* image = compile(machine_code);
+    if(image == nullptr) return false;
+    pending_swaps.push_back({execs, image});
+    SPDLOG_DEBUG("Queued program swap - executors: {} version: {}",
+                 execs.size(), image->version);
+    return true;
+}
+
+// Runs between the sync step of the last tick and the async run of this one,
+// so no executor is part way through an instruction. The waiting executors
+// keep their place in the scheduler and the halted ones are visited again.
+void HardwareManager::apply_swaps() {
+    // one mapping per pair of images
+    std::map<std::pair<ProgramImage const*, ProgramImage const*>,
+             std::vector<int>>
+        mappings;
+    std::unordered_set<ProgramExecutor*> ready(ready_list.begin(),
+                                               ready_list.end());
+    ulong kept = 0, moved = 0;
+    for(PendingSwap const& pending : pending_swaps) {
+        for(ProgramExecutor* exec : pending.execs) {
+            if(exec->image == pending.image) continue;
+            bool const was_halted = exec->is_halted();
+            if(exec->image) {
+                std::vector<int>& mapping = mappings[{exec->image,
+                                                      pending.image}];
+                if(mapping.empty())
+                    ImageSwap::map_addresses(*exec->image, *pending.image,
+                                             mapping);
+                kept += ImageSwap::move(*exec, *pending.image, mapping);
+            } else {
+                exec->image = pending.image;
+            }
+            ++moved;
+            if(was_halted && exec->is_registered && ready.insert(exec).second) {
+                exec->cpu.instr_trigger = 0;
+                ready_list.push_back(exec);
+            }
+        }
+    }
+    SPDLOG_DEBUG("Swapped program images - executors: {} kept position: {}",
+                 moved, kept);
+    pending_swaps.clear();
+}
+
+// The image already compiled from the machine code or nullptr
+ProgramImage const* HardwareManager::find(
+    MachineCode const& machine_code) const {
+    auto [it, end] = images.equal_range(machine_code.hash());
+    for(; it != end; ++it) {
+        if(it->second->code == machine_code.code) return it->second.get();
+    }
+    return nullptr;
+}
+
+// The counts of the machine code's image - nullptr if the build does not
+// profile the programs or no ant ran the code yet
+ProgramProfile const* HardwareManager::find_profile(
+    MachineCode const& machine_code) const {
+    ProgramImage const* image = find(machine_code);
+    return image ? image->profile.get() : nullptr;
+}
+
+// Compiles the images built so far to native code and every new one after.
+// The images that can not be compiled are still interpreted.
+void HardwareManager::enable_jit() {
+    is_jit = true;
+    for(auto& [hash, image] : images) {
+        if(!image->jit) image->jit = JitProgram::compile(*image);
+    }
+    SPDLOG_INFO("Enabled the jit - images: {}", images.size());
+}
+
+// Runs the executors that start a tick on the same image and instruction
+// together - see Lockstep
+void HardwareManager::enable_lockstep() {
+    is_lockstep = true;
+    SPDLOG_INFO("Enabled lockstep execution");
+}
+
+// Resets the executors that are due this tick and runs the async part of their
+// programs in contiguous batches - returns once every batch has finished
+void HardwareManager::execute_async(ThreadPool<PoolJob>& job_pool) {
+    if(!pending_swaps.empty()) apply_swaps();
+    scheduler.advance(instr_clock, ready_list);
+    ulong const num_execs = ready_list.size();
+    if(num_execs == 0) {
+        last_tick_instructions = 0;
+        return;
+    }
+
+    ExecutorList* execs = &ready_list;
+    if(is_lockstep) {
+        lockstep_list = ready_list;
+        std::sort(lockstep_list.begin(), lockstep_list.end(),
+                  [](ProgramExecutor const* a, ProgramExecutor const* b) {
+                      if(a->image != b->image)
+                          return std::less<>()(a->image, b->image);
+                      return a->cpu.instr_ptr_register <
+                             b->cpu.instr_ptr_register;
+                  });
+        execs = &lockstep_list;
+    }
+
+    ulong const batch_size = get_batch_size(job_pool.num_threads());
+    std::atomic_ulong instructions_executed = 0;
+    for(ulong i = 0; i < num_execs; i += batch_size) {
+        AsyncProgramJob job{execs->data() + i,
+                            std::min(batch_size, num_execs - i),
+                            instructions_executed, is_lockstep};
+        job_pool.submit_job(job);
+    }
+    job_pool.await_jobs();
+
+    last_tick_instructions = instructions_executed;
+    SPDLOG_TRACE("Executed {} async instructions - batch size: {}",
+                 last_tick_instructions, batch_size);
+}
+
+// Runs the sync instruction of the executors visited this tick and schedules
+// them for the tick their trigger fires
+void HardwareManager::execute_sync() {
+    for(ProgramExecutor* exec : ready_list) {
+        exec->execute_sync();
+        if(exec->is_halted()) continue;
+        scheduler.schedule(exec->next_trigger_tick(), exec);
+    }
+    SPDLOG_TRACE("Visited {} of {} executors - {} waiting", ready_list.size(),
+                 exec_list.size(), scheduler.size());
+    ready_list.clear();
+}
+
+ulong HardwareManager::get_batch_size(ulong num_threads) const {
+    ulong const num_execs = ready_list.size();
+    ulong const exec_cost =
+        last_tick_instructions / num_execs + executor_overhead_instructions;
+    ulong const work_size = target_batch_instructions / exec_cost;
+
+    ulong const num_batches = num_threads * min_batches_per_thread;
+    ulong const balanced_size = (num_execs + num_batches - 1) / num_batches;
+
+    return std::max(std::min(work_size, balanced_size), 1UL);
 }
 
-void HardwareManager::compile(CompileArgs& args) { compiler.compile(args); }
+void CompileJob::run() { *image = manager->build_image(*machine_code); }
 
 Packer& operator<<(Packer& p, HardwareManager const&) {
     // Does not take ownership of executor objects.
@@ -1,27 +1,99 @@
 #pragma once
 
 #include <hardware/compiler.hpp>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "hardware.pb.h"
+#include "utils/thread_pool.hpp"
+#include "utils/timing_wheel.hpp"
 
+class Packer;
+struct AsyncProgramJob;
 struct ProgramExecutor;
-struct CompileArgs;
+struct ProgramImage;
+struct ProgramProfile;
+struct MachineCode;
+struct HardwareManager;
+
+// Builds the image of one machine code as a thread pool job - the images are
+// added to the manager once every job has finished
+struct CompileJob {
+    HardwareManager const* manager;
+    MachineCode const* machine_code;
+    std::unique_ptr<ProgramImage>* image;
+    void run();
+};
 
 struct HardwareManager {
    private:
     using ExecutorList = std::vector<ProgramExecutor*>;
     ExecutorList exec_list;
+    // executors visited this tick - the new ones and the ones that came due
+    ExecutorList ready_list;
+    // waiting executors keyed on the tick their trigger fires, halted ones are
+    // not scheduled again
+    TimingWheel<ProgramExecutor*> scheduler;
+    ulong const& instr_clock;
     Compiler compiler;
+    // compiled images keyed by the machine code content hash
+    std::unordered_multimap<ulong, std::unique_ptr<ProgramImage>> images;
+    ulong last_version = 0;
+    // executors moved to a new image at the start of the next tick
+    struct PendingSwap {
+        ExecutorList execs;
+        ProgramImage const* image;
+    };
+    std::vector<PendingSwap> pending_swaps;
+    // async instructions executed last tick - used to size the batches
+    ulong last_tick_instructions = 0;
+    bool is_jit = false;  // compile the images to native code
+    bool is_lockstep = false;
+    // the ready executors sorted by image and instruction pointer so the
+    // lockstep groups are contiguous - the ready list keeps the order the
+    // sync instructions resolve in
+    ExecutorList lockstep_list;
+
+    // Each batch aims to interpret about this many instructions so the cost
+    // of a job stays small next to its work
+    static constexpr ulong target_batch_instructions = 4096;
+    // fixed cost of visiting an executor counted in instructions
+    static constexpr ulong executor_overhead_instructions = 4;
+    // lower bound on batches per thread so stealing can balance the load
+    static constexpr ulong min_batches_per_thread = 4;
 
    public:
-    HardwareManager(CommandMap const&);
-    HardwareManager(const ant_proto::HardwareManager& msg, CommandMap const&);
+    HardwareManager(CommandMap const&, ulong const& instr_clock);
+    HardwareManager(const ant_proto::HardwareManager& msg, CommandMap const&,
+                    ulong const& instr_clock);
+    HardwareManager(HardwareManager const&) = delete;
+    HardwareManager& operator=(HardwareManager const&) = delete;
+    virtual ~HardwareManager();
     void push_back(ProgramExecutor*);
-    void compile(CompileArgs&);
+    ProgramImage const* compile(MachineCode const&);
+    void compile_all(std::vector<MachineCode const*> const& machine_codes,
+                     std::vector<ProgramImage const*>& compiled,
+                     ThreadPool<PoolJob>& job_pool);
+    std::unique_ptr<ProgramImage> build_image(MachineCode const&) const;
+    bool swap(std::vector<ProgramExecutor*> const& execs, MachineCode const&);
+    ProgramImage const* find(MachineCode const&) const;
+    ProgramProfile const* find_profile(MachineCode const&) const;
+    void enable_jit();
+    void enable_lockstep();
+    void execute_async(ThreadPool<PoolJob>& job_pool);
+    void execute_sync();
+    ulong get_batch_size(ulong num_threads) const;
+    size_t num_images() const { return images.size(); }
+    size_t num_ready() const { return ready_list.size(); }
+    ulong instructions_last_tick() const { return last_tick_instructions; }
 
     ExecutorList::iterator begin() { return exec_list.begin(); }
     ExecutorList::iterator end() { return exec_list.end(); }
 
     friend Packer& operator<<(Packer&, HardwareManager const&);
+
+   private:
+    ProgramImage const* add_image(std::unique_ptr<ProgramImage>);
+    void apply_swaps();
 };
@@ -0,0 +1,139 @@
+#include "hardware/image_swap.hpp"
+
+#include <algorithm>
+
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/control_flow.hpp"
+#include "hardware/op_def.hpp"
+#include "hardware/program_executor.hpp"
+#include "hardware/program_image.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+    // Cells of the table used to diff the changed middle of the programs.
+    // Past it only the shared prefix and suffix are matched.
+    constexpr size_t max_diff_cells = 1 << 22;
+
+    // The decoded command before the optimizer fused or marked it
+    uchar source_command(uchar command) {
+#define MATCH_FUSED_HEAD(fused, head_command, tail_command) \
+    if(command == FusedCommand::fused) return CommandEnum::head_command;
+        FOR_EACH_FUSED_OP(MATCH_FUSED_HEAD)
+#undef MATCH_FUSED_HEAD
+        if(command == LoopCommand::LOOP_JNZ) return CommandEnum::JNZ;
+        if(command == LoopCommand::LOOP_JMP) return CommandEnum::JMP;
+        return command;
+    }
+
+    // Two instructions are the same if they decode from the same source
+    // instruction. The jump targets are left out as they move with every
+    // insert, and so are the tick counts the fused heads take from their tail.
+    bool is_same(Instruction const& a, Instruction const& b) {
+        uchar const command = source_command(a.command);
+        if(command != source_command(b.command)) return false;
+        if(a.reg_src != b.reg_src || a.reg_dst != b.reg_dst) return false;
+        if(a.scent_idx != b.scent_idx) return false;
+        // the loop jumps keep their loop index in the value
+        return is_jump_command(command) || a.value == b.value;
+    }
+
+    // Longest common subsequence of the two runs - sets the matched
+    // addresses of a to their partner in b
+    void diff(Instruction const* a, size_t a_size, Instruction const* b,
+              size_t b_size, int* matches, int b_offset) {
+        std::vector<ushort> lengths((a_size + 1) * (b_size + 1), 0);
+        auto at = [&](size_t i, size_t j) -> ushort& {
+            return lengths[i * (b_size + 1) + j];
+        };
+        for(size_t i = a_size; i-- > 0;) {
+            for(size_t j = b_size; j-- > 0;) {
+                at(i, j) = is_same(a[i], b[j])
+                               ? at(i + 1, j + 1) + 1
+                               : std::max(at(i + 1, j), at(i, j + 1));
+            }
+        }
+
+        size_t i = 0, j = 0;
+        while(i < a_size && j < b_size) {
+            if(is_same(a[i], b[j])) {
+                matches[i++] = b_offset + j++;
+            } else if(at(i + 1, j) >= at(i, j + 1)) {
+                ++i;
+            } else {
+                ++j;
+            }
+        }
+    }
+}  // namespace
+
+void ImageSwap::map_addresses(ProgramImage const& from, ProgramImage const& to,
+                              std::vector<int>& mapping) {
+    size_t const from_size = from.size();
+    size_t const to_size = to.size();
+    Instruction const* const a = from.instructions.data();
+    Instruction const* const b = to.instructions.data();
+    std::vector<int> matches(from_size, -1);
+
+    size_t prefix = 0;
+    while(prefix < from_size && prefix < to_size &&
+          is_same(a[prefix], b[prefix])) {
+        matches[prefix] = prefix;
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while(suffix < from_size - prefix && suffix < to_size - prefix &&
+          is_same(a[from_size - suffix - 1], b[to_size - suffix - 1])) {
+        matches[from_size - suffix - 1] = to_size - suffix - 1;
+        ++suffix;
+    }
+    size_t const a_middle = from_size - prefix - suffix;
+    size_t const b_middle = to_size - prefix - suffix;
+    if(a_middle * b_middle <= max_diff_cells) {
+        diff(a + prefix, a_middle, b + prefix, b_middle,
+             matches.data() + prefix, prefix);
+    } else {
+        SPDLOG_DEBUG("Program change too large to diff - {} x {} instructions",
+                     a_middle, b_middle);
+    }
+
+    // a removed instruction continues at the first new instruction after the
+    // last kept one
+    mapping.assign(from_size + 1, -1);
+    int next = 0;
+    for(size_t address = 0; address < from_size; ++address) {
+        int target = matches[address];
+        if(target == -1) {
+            target = next;
+        } else {
+            next = target + 1;
+        }
+        if(static_cast<size_t>(target) >= to_size) continue;
+        short const depth = from.entry_depths[address];
+        if(depth == -1 || depth != to.entry_depths[target]) continue;
+        mapping[address] = target;
+    }
+}
+
+bool ImageSwap::move(ProgramExecutor& exec, ProgramImage const& image,
+                     std::vector<int> const& mapping) {
+    DualRegisters& cpu = exec.cpu;
+    ushort const address = cpu.instr_ptr_register;
+    int target = address < mapping.size() ? mapping[address] : -1;
+    // the mapping only holds for the entry frame - a called function has
+    // pushed its frame and the depth tells the pushes apart from the frames
+    if(target != -1 && (cpu.base_ptr_register != 0 ||
+                        exec.image->entry_depths[address] !=
+                            static_cast<short>(cpu.stack_ptr_register))) {
+        target = -1;
+    }
+
+    exec.image = &image;
+    exec.is_sync_pending = false;  // the address was in the old image
+    if(target == -1) {
+        exec.restart();
+        return false;
+    }
+    cpu.instr_ptr_register = target;
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+struct ProgramExecutor;
+struct ProgramImage;
+
+// Moves running executors from one program image to another at a tick
+// boundary. The instructions of the two images are diffed so an ant that is
+// part way through the old program continues at the same instruction of the
+// new one - or at the first instruction after the last one both programs
+// share. The move only keeps the instruction pointer when the ant is in the
+// entry frame of the program and the new address is reached with the same
+// stack depth, otherwise the ant starts the new program from the beginning
+// with an empty stack. The data registers are always kept.
+namespace ImageSwap {
+    // The address of the new image each address of the old image continues
+    // at, -1 where the executor has to restart. Has an entry for the halt
+    // slot, which always restarts.
+    void map_addresses(ProgramImage const& from, ProgramImage const& to,
+                       std::vector<int>& mapping);
+
+    // Points the executor at the image. The mapping is the one from the
+    // executor's current image. Returns false if the executor restarted.
+    bool move(ProgramExecutor& exec, ProgramImage const& image,
+              std::vector<int> const& mapping);
+}  // namespace ImageSwap
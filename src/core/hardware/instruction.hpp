@@ -0,0 +1,27 @@
+#pragma once
+
+#include "app/globals.hpp"
+
+using uchar = unsigned char;
+using ushort = unsigned short;
+
+// A single decoded machine code instruction. The compiler decodes the variable
+// length machine code into a flat array of these so the interpreter can
+// dispatch on the command without re-reading the operand bytes.
+struct Instruction {
+    uchar command = 0;         // CommandEnum or FusedCommand
+    uchar reg_src = 0;         // source register index
+    uchar reg_dst = 0;         // destination (or only) register index
+    uchar scent_idx = 0;       // scent index for the scent commands
+    uchar length = 1;          // source instructions run - 2 when fused,
+                               // 1 + skipped JMPs when threaded
+    ushort num_ticks = 0;      // 0 for async instructions
+    ushort address = 0;        // jump target - stored as address - 1
+    cpu_word_size value = 0;   // constant for LOAD / priority for SWP /
+                               // first hop of a threaded JMP
+
+    // the instruction pointer is incremented after every instruction so the
+    // address is stored one before the jump target
+    ushort get_target() const { return address + 1; }
+    void set_target(ushort target) { address = target - 1; }
+};
@@ -0,0 +1,202 @@
+#include "hardware/interpreter.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/op_def.hpp"
+#include "hardware/program_image.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+    inline void dispatch(DualRegisters& cpu, Instruction const& instr) {
+        switch(instr.command) {
+#define DISPATCH_OP(command, T)     \
+    case CommandEnum::command:      \
+        T::exec(cpu, instr);        \
+        break;
+            FOR_EACH_OP(DISPATCH_OP)
+#undef DISPATCH_OP
+#define DISPATCH_FUSED_OP(fused, head, tail)                             \
+    case FusedCommand::fused:                                            \
+        FusedOp<CommandEnum::head, CommandEnum::tail>::exec(cpu, instr); \
+        break;
+            FOR_EACH_FUSED_OP(DISPATCH_FUSED_OP)
+#undef DISPATCH_FUSED_OP
+            case LoopCommand::LOOP_JNZ:
+                JnzOp::exec(cpu, instr);
+                break;
+            case LoopCommand::LOOP_JMP:
+                JmpOp::exec(cpu, instr);
+                break;
+        }
+    }
+
+    // Runs the head of a superinstruction on its own, as the unfused program
+    // does when the budget ends between the two instructions. A threaded JMP
+    // only takes its first hop.
+    inline void dispatch_head(DualRegisters& cpu, Instruction const& instr) {
+        uchar head = instr.command, tail;
+        get_fused_pair(instr.command, head, tail);
+        Instruction split = instr;
+        split.command = head;
+        if(head == CommandEnum::JMP) split.address = instr.value;
+        dispatch(cpu, split);
+    }
+
+    constexpr ulong NEVER = std::numeric_limits<ulong>::max();
+
+    // Smallest n > 0 with value + n * delta == 0 in the wrapping word
+    // arithmetic, or NEVER. With delta = 2^shift * odd this needs the low
+    // shift bits of value clear and n is then unique below 2^(32 - shift).
+    ulong iterations_to_zero(cpu_word_size value, cpu_word_size delta) {
+        if(delta == 0) return NEVER;
+        int const shift = std::countr_zero(delta);
+        cpu_word_size const mask = ~cpu_word_size(0) >> shift;
+        if((value & ((cpu_word_size(1) << shift) - 1)) != 0) return NEVER;
+
+        // inverse of the odd part by Newton's iteration - each step doubles
+        // the number of correct low bits
+        cpu_word_size const odd = delta >> shift;
+        cpu_word_size inverse = odd;
+        for(int i = 0; i < 5; ++i) inverse *= 2 - odd * inverse;
+
+        cpu_word_size const n = (((cpu_word_size(0) - value) >> shift) *
+                                 inverse) &
+                                mask;
+        return n == 0 ? ulong(mask) + 1 : n;
+    }
+
+    // Called after the loop jump went back to the start of the body. Runs as
+    // many whole iterations as the budget holds, stopping early on the one
+    // that clears the flag of a conditional loop. Returns the instructions
+    // those iterations would have executed.
+    ulong run_loop(CountedLoop const& loop, Instruction const& jump,
+                   DualRegisters& cpu, ulong budget) {
+        ulong iterations = budget / loop.dispatches;
+        if(iterations == 0) return 0;
+
+        cpu_word_size delta[2];
+        for(uchar reg = 0; reg < 2; ++reg)
+            delta[reg] = loop.step[reg] + loop.scale[reg] * cpu[1 - reg];
+
+        bool is_exiting = false;
+        if(jump.command == LoopCommand::LOOP_JNZ) {
+            ulong const to_zero =
+                iterations_to_zero(cpu[loop.flag_register],
+                                   delta[loop.flag_register]);
+            is_exiting = to_zero <= iterations;
+            iterations = std::min(iterations, to_zero);
+        }
+
+        cpu_word_size const count = static_cast<cpu_word_size>(iterations);
+        for(uchar reg = 0; reg < 2; ++reg) cpu[reg] += count * delta[reg];
+        cpu.zero_flag = cpu[loop.flag_register] == 0;
+        // the exiting iteration falls through its jump
+        if(is_exiting) cpu.instr_ptr_register = loop.end;
+        SPDLOG_TRACE("Fast forwarded {} loop iterations", iterations);
+        return iterations * loop.dispatches;
+    }
+
+    // Counts the instruction that was dispatched from the address. A
+    // superinstruction ran its tail too, and only CHECK sets the failed flag
+    // among the async ops.
+    template <typename Profiler>
+    void profile_dispatch(ProgramProfile* profile, Instruction const& instr,
+                          ushort address, DualRegisters const& cpu) {
+        if constexpr(Profiler::is_enabled) {
+            Profiler::executed(profile, address);
+            if(is_fused_command(instr.command))
+                Profiler::executed(profile, address + 1);
+            if(instr.command == CommandEnum::CHECK && cpu.instr_failed_flag)
+                Profiler::failed(profile, address);
+        }
+    }
+}  // namespace
+
+void Interpreter::step(Instruction const* program, DualRegisters& cpu) {
+    dispatch(cpu, program[cpu.instr_ptr_register]);
+    ++cpu.instr_ptr_register;
+}
+
+void Interpreter::step_head(Instruction const* program, DualRegisters& cpu) {
+    dispatch_head(cpu, program[cpu.instr_ptr_register]);
+    ++cpu.instr_ptr_register;
+}
+
+ulong Interpreter::run_async(Instruction const* program, size_t program_size,
+                             DualRegisters& cpu, ulong budget) {
+    ushort& instr_ptr_register = cpu.instr_ptr_register;
+    ulong executed = 0;
+    while(executed < budget && instr_ptr_register < program_size) {
+        Instruction const& instr = program[instr_ptr_register];
+        if(instr.num_ticks != 0) break;  // break if a syncronous instruction
+
+        SPDLOG_TRACE("Executing async operation at instruction address: {}",
+                     instr_ptr_register);
+        // the hop of a threaded JMP lands on the rest of its chain
+        if(instr.length > budget - executed) {
+            dispatch_head(cpu, instr);
+            ++instr_ptr_register;
+            ++executed;
+            continue;
+        }
+        dispatch(cpu, instr);
+        ++instr_ptr_register;
+        executed += instr.length;
+    }
+    return executed;
+}
+
+template <typename Profiler>
+ulong Interpreter::run_async(ProgramImage const& image, DualRegisters& cpu,
+                             ulong budget) {
+    Instruction const* program = image.instructions.data();
+    ProgramProfile* const profile = image.profile.get();
+    ushort& instr_ptr_register = cpu.instr_ptr_register;
+    ulong executed = 0;
+    while(executed < budget) {
+        Instruction const& instr = program[instr_ptr_register];
+        if(instr.num_ticks != 0) break;  // break if a syncronous instruction
+
+        SPDLOG_TRACE("Executing async operation at instruction address: {}",
+                     instr_ptr_register);
+        ushort const address = instr_ptr_register;
+        // the hop of a threaded JMP lands on the rest of its chain
+        if(instr.length > budget - executed) {
+            dispatch_head(cpu, instr);
+            if constexpr(Profiler::is_enabled)
+                Profiler::executed(profile, address);
+            ++instr_ptr_register;
+            ++executed;
+            continue;
+        }
+        dispatch(cpu, instr);
+        profile_dispatch<Profiler>(profile, instr, address, cpu);
+        executed += instr.length;
+        if(instr.command == LoopCommand::LOOP_JNZ ||
+           instr.command == LoopCommand::LOOP_JMP) {
+            // only taken jumps land on the address
+            if(instr_ptr_register == instr.address) {
+                CountedLoop const& loop = image.loops[instr.value];
+                ulong const skipped =
+                    run_loop(loop, instr, cpu, budget - executed);
+                executed += skipped;
+                if constexpr(Profiler::is_enabled) {
+                    ulong const iterations = skipped / loop.dispatches;
+                    for(ushort i = loop.begin; i <= loop.end; ++i)
+                        Profiler::executed(profile, i, iterations);
+                }
+            }
+        }
+        ++instr_ptr_register;
+    }
+    return executed;
+}
+
+template ulong Interpreter::run_async<NoProfiler>(ProgramImage const&,
+                                                  DualRegisters&, ulong);
+template ulong Interpreter::run_async<AddressProfiler>(ProgramImage const&,
+                                                       DualRegisters&, ulong);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "hardware/instruction.hpp"
+#include "hardware/profiler.hpp"
+
+using ulong = unsigned long;
+
+struct DualRegisters;
+struct ProgramImage;
+
+// Bytecode interpreter for the decoded ant programs.
+// The dispatch is a single switch over the instruction's command so each
+// executed instruction costs one predictable jump instead of an indirect call
+// through a type-erased wrapper.
+namespace Interpreter {
+    // Execute the instruction at the instruction pointer and advance it.
+    void step(Instruction const* program, DualRegisters& cpu);
+
+    // Execute only the head of the superinstruction at the instruction
+    // pointer and advance to its tail - or the first hop of a threaded JMP.
+    void step_head(Instruction const* program, DualRegisters& cpu);
+
+    // Execute async (zero tick) instructions until a sync instruction or the
+    // end of the program is reached, or until the instruction budget is used
+    // up. Returns the number of executed source instructions - a
+    // superinstruction is charged its length, and only its head runs when
+    // the budget ends between the two. A threaded JMP is charged the JMPs it
+    // skips and hops through them one at a time when they do not all fit.
+    ulong run_async(Instruction const* program, size_t program_size,
+                    DualRegisters& cpu, ulong budget);
+
+    // Same as above but the counted loops of the image skip all the whole
+    // iterations that fit in the budget at once. The registers, flags and the
+    // returned count match running every iteration. The image must be
+    // verified and sealed - the end of the program is found by its halt slot
+    // and the instruction pointer must start inside the program. The profiler
+    // policy counts each executed instruction in the image's profile.
+    template <typename Profiler = NoProfiler>
+    ulong run_async(ProgramImage const& image, DualRegisters& cpu,
+                    ulong budget);
+}  // namespace Interpreter
@@ -0,0 +1,506 @@
+#include "hardware/jit.hpp"
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/op_def.hpp"
+#include "hardware/program_image.hpp"
+#include "spdlog/spdlog.h"
+
+#ifdef JIT_SUPPORTED
+namespace {
+    using Program = std::vector<Instruction>;
+    using OpFunction = void (*)(DualRegisters*, Instruction const*);
+
+    // the ops without native code are called through these
+    template <class Op>
+    void call_op(DualRegisters* cpu, Instruction const* instr) {
+        Op::exec(*cpu, *instr);
+    }
+
+    OpFunction get_op_function(uchar command) {
+        switch(command) {
+#define OP_FUNCTION(command, T) \
+    case CommandEnum::command:  \
+        return &call_op<T>;
+            FOR_EACH_OP(OP_FUNCTION)
+#undef OP_FUNCTION
+        }
+        return nullptr;
+    }
+
+    bool is_jump_or_loop(uchar command) {
+        return command == CommandEnum::JMP || command == CommandEnum::JNZ ||
+               command == CommandEnum::JNF || command == CommandEnum::CALL ||
+               command == LoopCommand::LOOP_JNZ ||
+               command == LoopCommand::LOOP_JMP;
+    }
+
+    // Control does not continue to the next slot after these
+    bool is_block_end(uchar command) {
+        return command == CommandEnum::JMP || command == CommandEnum::CALL ||
+               command == CommandEnum::RET || command == LoopCommand::LOOP_JMP;
+    }
+
+    // Byte offsets of the registers inside DualRegisters
+    struct Layout {
+        int32_t registers[2];
+        int32_t ram;
+        int32_t instr_ptr;
+        int32_t base_ptr;
+        int32_t stack_ptr;
+        int32_t zero_flag;
+        int32_t instr_failed_flag;
+
+        Layout() {
+            DualRegisters cpu;
+            auto offset = [&cpu](void const* field) {
+                return static_cast<int32_t>(static_cast<char const*>(field) -
+                                            reinterpret_cast<char*>(&cpu));
+            };
+            registers[0] = offset(&cpu.registers[0]);
+            registers[1] = offset(&cpu.registers[1]);
+            ram = offset(&cpu.ram[0]);
+            instr_ptr = offset(&cpu.instr_ptr_register);
+            base_ptr = offset(&cpu.base_ptr_register);
+            stack_ptr = offset(&cpu.stack_ptr_register);
+            zero_flag = offset(&cpu.zero_flag);
+            instr_failed_flag = offset(&cpu.instr_failed_flag);
+        }
+    };
+
+    // Register use of the generated code. r12 holds the DualRegisters, rbx the
+    // budget left and r13 the budget the run started with. eax, ecx and the
+    // call registers are scratch.
+    constexpr uchar EAX = 0;
+    constexpr uchar ECX = 1;
+
+    class Assembler {
+        std::vector<uchar> code;
+
+        void append(void const* data, size_t size) {
+            uchar const* bytes = static_cast<uchar const*>(data);
+            code.insert(code.end(), bytes, bytes + size);
+        }
+
+        // [r12 + disp32]
+        void cpu_operand(uchar reg, int32_t disp) {
+            code.push_back(0x84 | (reg << 3));
+            code.push_back(0x24);
+            u32(disp);
+        }
+
+       public:
+        std::vector<uchar>& get_code() { return code; }
+        size_t pos() const { return code.size(); }
+
+        void bytes(std::initializer_list<uchar> values) {
+            code.insert(code.end(), values);
+        }
+        void u16(uint16_t value) { append(&value, sizeof(value)); }
+        void u32(uint32_t value) { append(&value, sizeof(value)); }
+        void u64(uint64_t value) { append(&value, sizeof(value)); }
+
+        // Emits a rel32 placeholder and returns where it is
+        size_t rel32() {
+            u32(0);
+            return pos() - 4;
+        }
+        void patch_rel32(size_t at, size_t target) {
+            int32_t const rel = static_cast<int32_t>(target - (at + 4));
+            std::memcpy(&code[at], &rel, sizeof(rel));
+        }
+        void align(size_t alignment) {
+            while(pos() % alignment != 0) code.push_back(0xCC);
+        }
+
+        // 32 bit op with a register and [r12 + disp]
+        void op_mem(uchar opcode, uchar reg, int32_t disp) {
+            bytes({0x41, opcode});
+            cpu_operand(reg, disp);
+        }
+        void op_mem(uchar opcode0, uchar opcode1, uchar reg, int32_t disp) {
+            bytes({0x41, opcode0, opcode1});
+            cpu_operand(reg, disp);
+        }
+        // 16 bit store of ax / cx to [r12 + disp]
+        void store16(uchar reg, int32_t disp) {
+            bytes({0x66, 0x41, 0x89});
+            cpu_operand(reg, disp);
+        }
+        void store16_imm(int32_t disp, uint16_t value) {
+            bytes({0x66, 0x41, 0xC7});
+            cpu_operand(0, disp);
+            u16(value);
+        }
+        void store32_imm(int32_t disp, uint32_t value) {
+            op_mem(0xC7, 0, disp);
+            u32(value);
+        }
+        void store8_imm(int32_t disp, uchar value) {
+            op_mem(0xC6, 0, disp);
+            code.push_back(value);
+        }
+        void cmp8_zero(int32_t disp) {
+            op_mem(0x80, 7, disp);
+            code.push_back(0);
+        }
+        // [r12 + rax * 4 + disp32]
+        void op_ram(uchar opcode, uchar reg, int32_t disp) {
+            bytes({0x41, opcode, static_cast<uchar>(0x84 | (reg << 3)), 0x84});
+            u32(disp);
+        }
+        void store_ram_imm(int32_t disp, uint32_t value) {
+            op_ram(0xC7, 0, disp);
+            u32(value);
+        }
+    };
+
+    class JitCompiler {
+        Program const& program;
+        size_t const size;
+        Layout const layout;
+        Assembler as;
+
+        std::vector<bool> is_leader;
+        std::vector<size_t> slot_entry;  // code offset run for each slot
+        std::vector<size_t> body_pos;    // code of a slot inside a block
+        std::vector<ulong> rest;         // budget from a slot to its end
+        std::vector<std::pair<size_t, ushort>> slot_fixups;
+        std::vector<std::pair<size_t, ushort>> cold_exits;
+        std::vector<size_t> table_fixups;
+        size_t exit_pos = 0;
+        size_t entry_pos = 0;
+
+        size_t next_slot(size_t slot) const {
+            return slot + (is_fused_command(program[slot].command) ? 2 : 1);
+        }
+
+        void find_leaders() {
+            is_leader.assign(size + 1, false);
+            is_leader[0] = true;
+            for(size_t slot = 0; slot < size; ++slot) {
+                Instruction const& instr = program[slot];
+                uchar head, tail = instr.command;
+                bool const is_fused = get_fused_pair(instr.command, head, tail);
+                Instruction const& last = is_fused ? program[slot + 1] : instr;
+                if(is_jump_or_loop(tail)) is_leader[last.get_target()] = true;
+                // where execution resumes after a jump, a call or a tick
+                if(is_jump_or_loop(tail) || tail == CommandEnum::RET ||
+                   instr.num_ticks != 0)
+                    is_leader[next_slot(slot)] = true;
+            }
+        }
+
+        void jump_to_slot(ushort slot) {
+            as.bytes({0xE9});
+            slot_fixups.emplace_back(as.rel32(), slot);
+        }
+        void branch_to_slot(uchar condition, ushort slot) {
+            as.bytes({0x0F, condition});
+            slot_fixups.emplace_back(as.rel32(), slot);
+        }
+        void jump_to_exit() {
+            as.bytes({0xE9});
+            as.patch_rel32(as.rel32(), exit_pos);
+        }
+        void exit_at(ushort slot) {
+            as.store16_imm(layout.instr_ptr, slot);
+            jump_to_exit();
+        }
+
+        // Budget check for the count source instructions that follow. Falls
+        // back to the interpreter at slot when they do not fit.
+        void check_budget(ulong count, ushort slot) {
+            as.bytes({0x48, 0x81, 0xFB});  // cmp rbx, count
+            as.u32(count);
+            as.bytes({0x0F, 0x82});  // jb
+            cold_exits.emplace_back(as.rel32(), slot);
+            as.bytes({0x48, 0x81, 0xEB});  // sub rbx, count
+            as.u32(count);
+        }
+
+        // jumps through the slot table to the slot in eax
+        void dispatch_eax() {
+            as.bytes({0x3D});  // cmp eax, size
+            as.u32(size);
+            as.bytes({0x0F, 0x87});  // ja exit
+            as.patch_rel32(as.rel32(), exit_pos);
+            as.bytes({0x48, 0xB9});  // mov rcx, table
+            table_fixups.push_back(as.pos());
+            as.u64(0);
+            as.bytes({0xFF, 0x24, 0xC1});  // jmp [rcx + rax * 8]
+        }
+
+        void set_zero_flag() {
+            as.op_mem(0x0F, 0x94, 0, layout.zero_flag);  // sete
+        }
+
+        void emit_op(uchar command, Instruction const& instr, ushort slot) {
+            int32_t const dst = layout.registers[instr.reg_dst];
+            int32_t const src = layout.registers[instr.reg_src];
+            switch(command) {
+                case CommandEnum::LOAD:
+                    as.store32_imm(dst, instr.value);
+                    as.store8_imm(layout.zero_flag, instr.value == 0);
+                    break;
+                case CommandEnum::COPY:
+                    as.op_mem(0x8B, EAX, src);
+                    as.op_mem(0x89, EAX, dst);
+                    as.bytes({0x85, 0xC0});  // test eax, eax
+                    set_zero_flag();
+                    break;
+                case CommandEnum::ADD:
+                    as.op_mem(0x8B, EAX, src);
+                    as.op_mem(0x01, EAX, dst);
+                    set_zero_flag();
+                    break;
+                case CommandEnum::SUB:
+                    as.op_mem(0x8B, EAX, src);
+                    as.op_mem(0x29, EAX, dst);
+                    set_zero_flag();
+                    break;
+                case CommandEnum::INC:
+                    as.op_mem(0xFF, 0, dst);
+                    set_zero_flag();
+                    break;
+                case CommandEnum::DEC:
+                    as.op_mem(0xFF, 1, dst);
+                    set_zero_flag();
+                    break;
+                case CommandEnum::PUSH:
+                    as.op_mem(0x0F, 0xB7, EAX, layout.stack_ptr);
+                    as.op_mem(0x8B, ECX, dst);
+                    as.op_ram(0x89, ECX, layout.ram);
+                    as.bytes({0xFF, 0xC0});  // inc eax
+                    as.store16(EAX, layout.stack_ptr);
+                    break;
+                case CommandEnum::POP:
+                    as.op_mem(0x0F, 0xB7, EAX, layout.stack_ptr);
+                    as.bytes({0xFF, 0xC8});  // dec eax
+                    as.store16(EAX, layout.stack_ptr);
+                    as.op_ram(0x8B, ECX, layout.ram);
+                    as.op_mem(0x89, ECX, dst);
+                    break;
+                case CommandEnum::JMP:
+                case LoopCommand::LOOP_JMP:
+                    jump_to_slot(instr.get_target());
+                    break;
+                case CommandEnum::JNZ:
+                case LoopCommand::LOOP_JNZ:
+                    as.cmp8_zero(layout.zero_flag);
+                    branch_to_slot(0x84, instr.get_target());  // je
+                    break;
+                case CommandEnum::JNF:
+                    as.cmp8_zero(layout.instr_failed_flag);
+                    branch_to_slot(0x84, instr.get_target());  // je
+                    break;
+                case CommandEnum::CALL:
+                    // push the instruction pointer and the base pointer
+                    as.op_mem(0x0F, 0xB7, EAX, layout.stack_ptr);
+                    as.store_ram_imm(layout.ram, slot);
+                    as.bytes({0xFF, 0xC0});  // inc eax
+                    as.op_mem(0x0F, 0xB7, ECX, layout.base_ptr);
+                    as.op_ram(0x89, ECX, layout.ram);
+                    as.bytes({0xFF, 0xC0});  // inc eax
+                    as.store16(EAX, layout.stack_ptr);
+                    as.store16(EAX, layout.base_ptr);
+                    jump_to_slot(instr.get_target());
+                    break;
+                case CommandEnum::RET:
+                    // the stack pointer drops to the base pointer and the
+                    // frame below holds the base and instruction pointers
+                    as.op_mem(0x0F, 0xB7, EAX, layout.base_ptr);
+                    as.bytes({0xFF, 0xC8});  // dec eax
+                    as.op_ram(0x8B, ECX, layout.ram);
+                    as.store16(ECX, layout.base_ptr);
+                    as.bytes({0xFF, 0xC8});  // dec eax
+                    as.op_ram(0x8B, ECX, layout.ram);
+                    as.store16(EAX, layout.stack_ptr);
+                    as.bytes({0xFF, 0xC1});        // inc ecx
+                    as.bytes({0x0F, 0xB7, 0xC1});  // movzx eax, cx
+                    as.store16(EAX, layout.instr_ptr);
+                    dispatch_eax();
+                    break;
+                default:
+                    as.bytes({0x4C, 0x89, 0xE7});  // mov rdi, r12
+                    as.bytes({0x48, 0xBE});        // mov rsi, instr
+                    as.u64(reinterpret_cast<uint64_t>(&instr));
+                    as.bytes({0x48, 0xB8});  // mov rax, op
+                    as.u64(reinterpret_cast<uint64_t>(get_op_function(command)));
+                    as.bytes({0xFF, 0xD0});  // call rax
+            }
+        }
+
+        // Emits the block starting at a leader. It runs up to the first
+        // jump, sync instruction or the next leader.
+        void emit_block(ushort leader) {
+            std::vector<ushort> slots;
+            size_t slot = leader;
+            while(slot < size && (slot == leader || !is_leader[slot]) &&
+                  program[slot].num_ticks == 0) {
+                slots.push_back(slot);
+                if(is_block_end(program[slot].command)) break;
+                slot = next_slot(slot);
+            }
+
+            // a superinstruction is charged both of its instructions and a
+            // threaded JMP the JMPs it skips
+            ulong cost = 0;
+            for(ushort at : slots) cost += program[at].length;
+
+            slot_entry[leader] = as.pos();
+            if(!slots.empty()) check_budget(cost, leader);
+            for(size_t i = 0; i < slots.size(); ++i) {
+                Instruction const& instr = program[slots[i]];
+                body_pos[slots[i]] = as.pos();
+                rest[slots[i]] = cost;
+                cost -= instr.length;
+
+                uchar head, tail;
+                if(get_fused_pair(instr.command, head, tail)) {
+                    emit_op(head, instr, slots[i]);
+                    emit_op(tail, program[slots[i] + 1], slots[i] + 1);
+                } else {
+                    emit_op(instr.command, instr, slots[i]);
+                }
+            }
+            if(!slots.empty() && is_block_end(program[slots.back()].command))
+                return;
+            if(slot < size && program[slot].num_ticks != 0) {
+                exit_at(slot);
+            } else {
+                jump_to_slot(slot);
+            }
+        }
+
+        void emit_exit() {
+            exit_pos = as.pos();
+            as.bytes({0x4C, 0x89, 0xE8});        // mov rax, r13
+            as.bytes({0x48, 0x29, 0xD8});        // sub rax, rbx
+            as.bytes({0x48, 0x83, 0xC4, 0x08});  // add rsp, 8
+            as.bytes({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0x5D, 0xC3});
+        }
+
+        void emit_entry() {
+            entry_pos = as.pos();
+            as.bytes({0x55, 0x53, 0x41, 0x54, 0x41, 0x55});  // push
+            as.bytes({0x48, 0x83, 0xEC, 0x08});              // sub rsp, 8
+            as.bytes({0x49, 0x89, 0xFC});                    // mov r12, rdi
+            as.bytes({0x48, 0x89, 0xF3});                    // mov rbx, rsi
+            as.bytes({0x49, 0x89, 0xF5});                    // mov r13, rsi
+            as.op_mem(0x0F, 0xB7, EAX, layout.instr_ptr);
+            dispatch_eax();
+        }
+
+        // Slots that are not leaders are entered when a run resumes inside a
+        // block, the ones outside of any block go back to the interpreter
+        void emit_slot_entries() {
+            for(size_t slot = 0; slot <= size; ++slot) {
+                if(slot_entry[slot] != 0) continue;
+                slot_entry[slot] = as.pos();
+                if(slot < size && rest[slot] != 0) {
+                    check_budget(rest[slot], slot);
+                    as.bytes({0xE9});
+                    as.patch_rel32(as.rel32(), body_pos[slot]);
+                } else {
+                    exit_at(slot);
+                }
+            }
+            for(auto [at, slot] : cold_exits) {
+                as.patch_rel32(at, as.pos());
+                exit_at(slot);
+            }
+            for(auto [at, slot] : slot_fixups)
+                as.patch_rel32(at, slot_entry[slot]);
+        }
+
+       public:
+        explicit JitCompiler(Program const& program, size_t size)
+            : program(program),
+              size(size),
+              slot_entry(size + 1, 0),
+              body_pos(size + 1, 0),
+              rest(size + 1, 0) {}
+
+        // Assembles the code followed by the slot table. Returns the offset
+        // of the entry point and the offset of the table.
+        std::pair<size_t, size_t> assemble() {
+            find_leaders();
+            emit_exit();
+            emit_entry();
+            for(size_t slot = 0; slot < size; ++slot) {
+                if(is_leader[slot]) emit_block(slot);
+            }
+            emit_slot_entries();
+            as.align(8);
+            size_t const table_pos = as.pos();
+            for(size_t slot = 0; slot <= size; ++slot) as.u64(slot_entry[slot]);
+            return {entry_pos, table_pos};
+        }
+
+        // Turns the offsets of the table and its loads into addresses
+        void relocate(uchar* base, size_t table_pos) {
+            std::vector<uchar>& code = as.get_code();
+            for(size_t slot = 0; slot <= size; ++slot) {
+                uint64_t const address = reinterpret_cast<uint64_t>(base) +
+                                         slot_entry[slot];
+                std::memcpy(&code[table_pos + slot * 8], &address, 8);
+            }
+            uint64_t const table = reinterpret_cast<uint64_t>(base) + table_pos;
+            for(size_t at : table_fixups) std::memcpy(&code[at], &table, 8);
+        }
+
+        std::vector<uchar> const& get_code() { return as.get_code(); }
+    };
+}  // namespace
+#endif
+
+JitProgram::~JitProgram() {
+#ifdef JIT_SUPPORTED
+    if(memory != nullptr) munmap(memory, memory_size);
+#endif
+}
+
+std::unique_ptr<JitProgram> JitProgram::compile(ProgramImage const& image) {
+#ifdef JIT_SUPPORTED
+    JitCompiler compiler(image.instructions, image.size());
+    auto [entry_pos, table_pos] = compiler.assemble();
+    size_t const size = compiler.get_code().size();
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED) {
+        SPDLOG_WARN("Failed to map memory for the jit - hash: {}", image.hash);
+        return nullptr;
+    }
+    compiler.relocate(static_cast<uchar*>(memory), table_pos);
+    std::memcpy(memory, compiler.get_code().data(), size);
+    if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        SPDLOG_WARN("Failed to make the jit code executable - hash: {}",
+                    image.hash);
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    std::unique_ptr<JitProgram> program(new JitProgram());
+    program->memory = memory;
+    program->memory_size = size;
+    program->entry = reinterpret_cast<Entry>(static_cast<uchar*>(memory) +
+                                             entry_pos);
+    SPDLOG_DEBUG("Compiled program to native code - hash: {} bytes: {}",
+                 image.hash, size);
+    return program;
+#else
+    SPDLOG_DEBUG("No jit for this host - hash: {}", image.hash);
+    return nullptr;
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+
+using ulong = unsigned long;
+
+struct DualRegisters;
+struct ProgramImage;
+
+// Native x86-64 code for a verified and sealed program image. Every block of
+// async instructions becomes straight line code that works on the registers
+// in place and checks the budget once on entry. The sync instructions and the
+// end of the program exit back to the executor with the instruction pointer
+// set, the ops without a native form are called like the interpreter does.
+class JitProgram {
+    using Entry = ulong (*)(DualRegisters*, ulong);
+
+    void* memory = nullptr;
+    ulong memory_size = 0;
+    Entry entry = nullptr;
+
+    JitProgram() = default;
+
+   public:
+    JitProgram(JitProgram const&) = delete;
+    JitProgram& operator=(JitProgram const&) = delete;
+    ~JitProgram();
+
+    // Returns nullptr when the host is not x86-64 or the executable memory can
+    // not be mapped - the image is then interpreted
+    static std::unique_ptr<JitProgram> compile(ProgramImage const& image);
+
+    // Runs the async instructions like Interpreter::run_async but may stop
+    // early, at a block the remaining budget does not cover. The registers
+    // are then exactly as the interpreter would have left them at that point
+    // so the caller finishes the run with the interpreter.
+    ulong run(DualRegisters& cpu, ulong budget) const {
+        return entry(&cpu, budget);
+    }
+};
@@ -19,6 +19,16 @@ ushort LabelMap::at(std::string const& label) const {
     return label_map.at(label);
 }
 
+std::string const* LabelMap::find(ushort address) const {
+    auto it = address_map.find(address);
+    return it == address_map.end() ? nullptr : &it->second;
+}
+
+ushort const* LabelMap::find(std::string_view label) const {
+    auto it = label_map.find(label);
+    return it == label_map.end() ? nullptr : &it->second;
+}
+
 void LabelMap::clear() {
     label_map.clear();
     address_map.clear();
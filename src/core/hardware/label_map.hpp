@@ -1,11 +1,20 @@
 #pragma once
 
+#include <string_view>
 #include <unordered_map>
 
 #include "proto/hardware.pb.h"
 
 class LabelMap {
-    std::unordered_map<std::string, ushort> label_map;
+    // looks labels up by view without building a string
+    struct LabelHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view label) const {
+            return std::hash<std::string_view>()(label);
+        }
+    };
+    std::unordered_map<std::string, ushort, LabelHash, std::equal_to<>>
+        label_map;
     std::unordered_map<ushort, std::string> address_map;
 
    public:
@@ -17,6 +26,9 @@ class LabelMap {
     void insert(ushort address, std::string const& label);
     std::string const& at(ushort address) const;
     ushort at(std::string const& label) const;
+    // nullptr if there is no label at the address or with the name
+    std::string const* find(ushort address) const;
+    ushort const* find(std::string_view label) const;
     inline size_t size() const { return label_map.size(); }
     void clear();
     void get_addresses(std::vector<ushort>& out) const;
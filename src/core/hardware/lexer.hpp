@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string_view>
+
+// Splits one line of assembly into whitespace separated words without copying
+// it. The views point into the line so it has to outlive the lexer.
+class Lexer {
+    std::string_view line;
+    size_t pos = 0;
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+               c == '\f';
+    }
+
+    void skip_spaces() {
+        while(pos < line.size() && is_space(line[pos])) ++pos;
+    }
+
+   public:
+    explicit Lexer(std::string_view line) : line(line) {}
+
+    // The next word - empty once the line is used up
+    std::string_view word() {
+        skip_spaces();
+        size_t const begin = pos;
+        while(pos < line.size() && !is_space(line[pos])) ++pos;
+        return line.substr(begin, pos - begin);
+    }
+
+    // The next character that is not a space - 0 once the line is used up.
+    // Like reading a char from a stream it may split a word.
+    char letter() {
+        skip_spaces();
+        return pos < line.size() ? line[pos++] : 0;
+    }
+
+    static std::string_view trim(std::string_view text) {
+        size_t begin = 0, end = text.size();
+        while(begin < end && is_space(text[begin])) ++begin;
+        while(end > begin && is_space(text[end - 1])) --end;
+        return text.substr(begin, end - begin);
+    }
+};
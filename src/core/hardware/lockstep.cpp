@@ -0,0 +1,415 @@
+#include "hardware/lockstep.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/op_def.hpp"
+#include "hardware/profiler.hpp"
+#include "hardware/program_executor.hpp"
+#include "hardware/program_image.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+    // smaller groups run on their own - the gather and scatter would cost
+    // more than the shared dispatch saves
+    constexpr ulong min_group_size = 4;
+
+    using Lanes = std::vector<cpu_word_size>;
+
+    // Register file of a group in structure of arrays form. Lane i belongs to
+    // execs[i] and has executed steps + offsets[i] source instructions this
+    // tick, the offsets differ once groups that took different paths are
+    // merged.
+    struct LaneGroup {
+        ushort ip = 0;
+        ulong steps = 0;
+        long max_offset = 0;
+        std::vector<ProgramExecutor*> execs;
+        std::vector<long> offsets;
+        Lanes registers[2];
+        Lanes zero_flag;  // 0 or 1 so a compare mask shifts straight into it
+        Lanes instr_failed_flag;  // only read - never scattered back
+
+        size_t size() const { return execs.size(); }
+        ulong executed(size_t lane) const { return steps + offsets[lane]; }
+
+        void gather(ProgramExecutor* exec) {
+            DualRegisters const& cpu = exec->cpu;
+            execs.push_back(exec);
+            offsets.push_back(0);
+            registers[0].push_back(cpu.registers[0]);
+            registers[1].push_back(cpu.registers[1]);
+            zero_flag.push_back(cpu.zero_flag);
+            instr_failed_flag.push_back(cpu.instr_failed_flag);
+        }
+
+        void scatter(size_t lane) const {
+            DualRegisters& cpu = execs[lane]->cpu;
+            cpu.registers[0] = registers[0][lane];
+            cpu.registers[1] = registers[1][lane];
+            cpu.zero_flag = zero_flag[lane];
+            cpu.instr_ptr_register = ip;
+        }
+
+        // Appends a lane of another group that is at the same instruction
+        void push_lane(LaneGroup const& other, size_t lane) {
+            long const offset = other.executed(lane) - steps;
+            max_offset = std::max(max_offset, offset);
+            execs.push_back(other.execs[lane]);
+            offsets.push_back(offset);
+            registers[0].push_back(other.registers[0][lane]);
+            registers[1].push_back(other.registers[1][lane]);
+            zero_flag.push_back(other.zero_flag[lane]);
+            instr_failed_flag.push_back(other.instr_failed_flag[lane]);
+        }
+
+        void move_lane(size_t from, size_t to) {
+            execs[to] = execs[from];
+            offsets[to] = offsets[from];
+            registers[0][to] = registers[0][from];
+            registers[1][to] = registers[1][from];
+            zero_flag[to] = zero_flag[from];
+            instr_failed_flag[to] = instr_failed_flag[from];
+        }
+
+        void resize(size_t size) {
+            execs.resize(size);
+            offsets.resize(size);
+            registers[0].resize(size);
+            registers[1].resize(size);
+            zero_flag.resize(size);
+            instr_failed_flag.resize(size);
+            max_offset = size == 0
+                             ? 0
+                             : *std::max_element(offsets.begin(), offsets.end());
+        }
+    };
+
+    // The register ops applied to a whole lane. Each has a scalar form and,
+    // when the build enables AVX2, the same op on eight lanes.
+    struct LaneLoad {
+        static cpu_word_size scalar(cpu_word_size, cpu_word_size,
+                                    cpu_word_size value) {
+            return value;
+        }
+#ifdef __AVX2__
+        static __m256i vector(__m256i, __m256i, __m256i value) {
+            return value;
+        }
+#endif
+    };
+
+    struct LaneCopy {
+        static cpu_word_size scalar(cpu_word_size, cpu_word_size src,
+                                    cpu_word_size) {
+            return src;
+        }
+#ifdef __AVX2__
+        static __m256i vector(__m256i, __m256i src, __m256i) { return src; }
+#endif
+    };
+
+    struct LaneAdd {
+        static cpu_word_size scalar(cpu_word_size dst, cpu_word_size src,
+                                    cpu_word_size) {
+            return dst + src;
+        }
+#ifdef __AVX2__
+        static __m256i vector(__m256i dst, __m256i src, __m256i) {
+            return _mm256_add_epi32(dst, src);
+        }
+#endif
+    };
+
+    struct LaneSub {
+        static cpu_word_size scalar(cpu_word_size dst, cpu_word_size src,
+                                    cpu_word_size) {
+            return dst - src;
+        }
+#ifdef __AVX2__
+        static __m256i vector(__m256i dst, __m256i src, __m256i) {
+            return _mm256_sub_epi32(dst, src);
+        }
+#endif
+    };
+
+    struct LaneInc {
+        static cpu_word_size scalar(cpu_word_size dst, cpu_word_size,
+                                    cpu_word_size) {
+            return dst + 1;
+        }
+#ifdef __AVX2__
+        static __m256i vector(__m256i dst, __m256i, __m256i) {
+            return _mm256_add_epi32(dst, _mm256_set1_epi32(1));
+        }
+#endif
+    };
+
+    struct LaneDec {
+        static cpu_word_size scalar(cpu_word_size dst, cpu_word_size,
+                                    cpu_word_size) {
+            return dst - 1;
+        }
+#ifdef __AVX2__
+        static __m256i vector(__m256i dst, __m256i, __m256i) {
+            return _mm256_sub_epi32(dst, _mm256_set1_epi32(1));
+        }
+#endif
+    };
+
+    // Runs the op on every lane and sets the zero flags from the result
+    template <typename Op>
+    void apply(LaneGroup& group, Instruction const& instr) {
+        cpu_word_size* dst = group.registers[instr.reg_dst].data();
+        cpu_word_size const* src = group.registers[instr.reg_src].data();
+        cpu_word_size* zero = group.zero_flag.data();
+        size_t const size = group.size();
+        size_t i = 0;
+#ifdef __AVX2__
+        __m256i const value = _mm256_set1_epi32(instr.value);
+        __m256i const zeros = _mm256_setzero_si256();
+        for(; i + 8 <= size; i += 8) {
+            __m256i* const dst_lanes = reinterpret_cast<__m256i*>(dst + i);
+            __m256i const result = Op::vector(
+                _mm256_loadu_si256(dst_lanes),
+                _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i)),
+                value);
+            _mm256_storeu_si256(dst_lanes, result);
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(zero + i),
+                _mm256_srli_epi32(_mm256_cmpeq_epi32(result, zeros), 31));
+        }
+#endif
+        for(; i < size; ++i) {
+            dst[i] = Op::scalar(dst[i], src[i], instr.value);
+            zero[i] = dst[i] == 0;
+        }
+    }
+
+    bool is_lockstep_command(uchar command) {
+        switch(command) {
+            case CommandEnum::LOAD:
+            case CommandEnum::COPY:
+            case CommandEnum::ADD:
+            case CommandEnum::SUB:
+            case CommandEnum::INC:
+            case CommandEnum::DEC:
+            case CommandEnum::JMP:
+            case CommandEnum::JNZ:
+            case CommandEnum::JNF:
+            case FusedCommand::DEC_JNZ:
+            case FusedCommand::INC_JNZ:
+            case FusedCommand::SUB_JNZ:
+            case FusedCommand::LOAD_COPY:
+                return true;
+            default:
+                // the counted loops are left to the interpreter which skips
+                // their iterations in closed form
+                return false;
+        }
+    }
+
+    class GroupRunner {
+        Instruction const* program;
+        ulong const budget;
+        std::vector<LaneGroup> groups;
+        ulong executed = 0;
+
+        // Hands the lanes back to their executors to finish on their own
+        void retire(LaneGroup const& group, size_t lane) {
+            group.scatter(lane);
+            executed += group.execs[lane]->finish_async(group.executed(lane));
+        }
+
+        // Retires the lanes that can not pay for the next instruction. A
+        // lane that can only pay for the head of a superinstruction finishes
+        // on its own too, the interpreter then runs just the head.
+        void retire_spent_lanes(LaneGroup& group, ulong cost) {
+            if(group.steps + group.max_offset + cost <= budget) return;
+            size_t kept = 0;
+            for(size_t i = 0; i < group.size(); ++i) {
+                if(group.executed(i) + cost > budget) {
+                    retire(group, i);
+                } else {
+                    group.move_lane(i, kept++);
+                }
+            }
+            group.resize(kept);
+        }
+
+        // The lanes whose flag is clear jump - they move to taken when only
+        // some of them do. Returns false if the group did not split.
+        bool branch(LaneGroup& group, Lanes const& flag, ushort target,
+                    ushort next, LaneGroup& taken) {
+            size_t const size = group.size();
+            size_t num_taken = 0;
+            for(size_t i = 0; i < size; ++i) num_taken += flag[i] == 0;
+            if(num_taken == 0 || num_taken == size) {
+                group.ip = num_taken == 0 ? next : target;
+                return false;
+            }
+
+            taken.ip = target;
+            taken.steps = group.steps;
+            size_t kept = 0;
+            for(size_t i = 0; i < size; ++i) {
+                if(flag[i] == 0) {
+                    taken.push_lane(group, i);
+                } else {
+                    group.move_lane(i, kept++);
+                }
+            }
+            group.resize(kept);
+            group.ip = next;
+            return true;
+        }
+
+        // Runs the instruction at the group's ip on all lanes. Returns false
+        // if the group did not split.
+        bool step(LaneGroup& group, LaneGroup& taken) {
+            Instruction const& instr = program[group.ip];
+            Instruction const& tail = program[group.ip + 1];
+            ushort const next = group.ip + 1;
+            group.steps += instr.length;
+            switch(instr.command) {
+                case CommandEnum::LOAD:
+                    apply<LaneLoad>(group, instr);
+                    break;
+                case CommandEnum::COPY:
+                    apply<LaneCopy>(group, instr);
+                    break;
+                case CommandEnum::ADD:
+                    apply<LaneAdd>(group, instr);
+                    break;
+                case CommandEnum::SUB:
+                    apply<LaneSub>(group, instr);
+                    break;
+                case CommandEnum::INC:
+                    apply<LaneInc>(group, instr);
+                    break;
+                case CommandEnum::DEC:
+                    apply<LaneDec>(group, instr);
+                    break;
+                case CommandEnum::JMP:
+                    group.ip = instr.get_target();
+                    return false;
+                case CommandEnum::JNZ:
+                    return branch(group, group.zero_flag, instr.get_target(),
+                                  next, taken);
+                case CommandEnum::JNF:
+                    return branch(group, group.instr_failed_flag,
+                                  instr.get_target(), next, taken);
+                case FusedCommand::DEC_JNZ:
+                    apply<LaneDec>(group, instr);
+                    return branch(group, group.zero_flag, tail.get_target(),
+                                  next + 1, taken);
+                case FusedCommand::INC_JNZ:
+                    apply<LaneInc>(group, instr);
+                    return branch(group, group.zero_flag, tail.get_target(),
+                                  next + 1, taken);
+                case FusedCommand::SUB_JNZ:
+                    apply<LaneSub>(group, instr);
+                    return branch(group, group.zero_flag, tail.get_target(),
+                                  next + 1, taken);
+                case FusedCommand::LOAD_COPY:
+                    apply<LaneLoad>(group, instr);
+                    apply<LaneCopy>(group, tail);
+                    group.ip = next + 1;
+                    return false;
+            }
+            group.ip = next;
+            return false;
+        }
+
+       public:
+        GroupRunner(ProgramImage const& image, ulong budget)
+            : program(image.instructions.data()), budget(budget) {}
+
+        // Steps the group with the lowest instruction pointer first so the
+        // two sides of a branch that meet again are merged
+        ulong run(LaneGroup&& group) {
+            groups.push_back(std::move(group));
+            while(!groups.empty()) {
+                size_t current = 0;
+                for(size_t i = 1; i < groups.size(); ++i) {
+                    if(groups[i].ip < groups[current].ip) current = i;
+                }
+                for(size_t i = groups.size(); i-- > 0;) {
+                    if(i == current || groups[i].ip != groups[current].ip)
+                        continue;
+                    LaneGroup& other = groups[i];
+                    for(size_t lane = 0; lane < other.size(); ++lane)
+                        groups[current].push_lane(other, lane);
+                    std::swap(other, groups.back());
+                    if(current == groups.size() - 1) current = i;
+                    groups.pop_back();
+                }
+
+                LaneGroup& group = groups[current];
+                Instruction const& instr = program[group.ip];
+                retire_spent_lanes(group, instr.length);
+                bool const is_stopped =
+                    instr.num_ticks != 0 || !is_lockstep_command(instr.command);
+                if(is_stopped) {
+                    for(size_t lane = 0; lane < group.size(); ++lane)
+                        retire(group, lane);
+                    group.resize(0);
+                }
+                if(group.size() == 0) {
+                    std::swap(group, groups.back());
+                    groups.pop_back();
+                    continue;
+                }
+
+                LaneGroup taken;
+                if(step(group, taken)) groups.push_back(std::move(taken));
+            }
+            return executed;
+        }
+    };
+
+    bool is_same_start(ProgramExecutor const* a, ProgramExecutor const* b) {
+        return a->image == b->image &&
+               a->cpu.instr_ptr_register == b->cpu.instr_ptr_register &&
+               a->max_instruction_per_tick == b->max_instruction_per_tick;
+    }
+}  // namespace
+
+ulong Lockstep::run(ProgramExecutor* const* execs, ulong count) {
+    ulong executed = 0;
+    ulong begin = 0;
+    while(begin < count) {
+        ulong end = begin + 1;
+        while(end < count && is_same_start(execs[begin], execs[end])) ++end;
+
+        // the lanes have no profiling hooks
+        if(end - begin < min_group_size || ExecutorProfiler::is_enabled) {
+            for(ulong i = begin; i < end; ++i) {
+                execs[i]->reset();
+                executed += execs[i]->execute_async();
+            }
+        } else {
+            LaneGroup group;
+            for(ulong i = begin; i < end; ++i) {
+                execs[i]->reset();
+                if(execs[i]->begin_async()) group.gather(execs[i]);
+            }
+            SPDLOG_TRACE("Running {} executors in lockstep at address {}",
+                         group.size(), execs[begin]->cpu.instr_ptr_register);
+            if(group.size() != 0) {
+                group.ip = execs[begin]->cpu.instr_ptr_register;
+                GroupRunner runner(*execs[begin]->image,
+                                   execs[begin]->async_budget());
+                executed += runner.run(std::move(group));
+            }
+        }
+        begin = end;
+    }
+    return executed;
+}
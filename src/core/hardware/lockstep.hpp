@@ -0,0 +1,23 @@
+#pragma once
+
+using ulong = unsigned long;
+
+struct ProgramExecutor;
+
+// Lockstep execution of the async runs of ants that share a program. The
+// executors that start a tick on the same image and instruction pointer form a
+// group whose registers and flags are gathered into a structure of arrays, one
+// lane per ant. The register only ops (LOAD, COPY, ADD, SUB, INC, DEC, the
+// jumps and their superinstructions) then run once per instruction for the
+// whole group, eight lanes per AVX2 operation when the build enables it. A
+// conditional jump that splits the lanes splits the group, and groups that
+// reach the same instruction again are merged back. Lanes leave at their
+// budget and the group stops at any other instruction - the lanes are then
+// scattered back and each executor finishes its run on its own.
+namespace Lockstep {
+    // Same as resetting and running execute_async on each of the count
+    // executors. The executors should be sorted by image and instruction
+    // pointer so the groups are contiguous. Returns the number of executed
+    // instructions.
+    ulong run(ProgramExecutor* const* execs, ulong count);
+}  // namespace Lockstep
@@ -18,6 +18,17 @@ bool MachineCode::is_empty() const {
 
 size_t MachineCode::size() const { return code.size(); }
 
+// 64 bit FNV-1a - labels are not hashed since they do not change what the
+// program does
+ulong MachineCode::hash() const {
+    ulong h = 14695981039346656037UL;
+    for(uchar byte : code) {
+        h ^= byte;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
 ant_proto::MachineCode MachineCode::get_proto() {
     ant_proto::MachineCode msg;
     *msg.mutable_labels() = labels.get_proto();
@@ -6,6 +6,7 @@
 #include "hardware/label_map.hpp"
 
 using uchar = unsigned char;
+using ulong = unsigned long;
 
 struct MachineCode {
     LabelMap labels;
@@ -17,5 +18,6 @@ struct MachineCode {
     void clear();
     bool is_empty() const;
     size_t size() const;
+    ulong hash() const;  // content hash of the code bytes
     ant_proto::MachineCode get_proto();
 };
@@ -4,188 +4,341 @@
 
 #include "app/globals.hpp"
 #include "entity/scents.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/instruction.hpp"
+#include "spdlog/spdlog.h"
 
 using uchar = unsigned char;
 using schar = signed char;
 using ushort = unsigned short;
 using ulong = unsigned long;
 
-struct DualRegisters;
-
-struct NoOP {
-    NoOP(DualRegisters&);
-    void operator()();
-};
-
-// load a constant to the register
-struct LoadConstantOp {
-    LoadConstantOp(DualRegisters&, cpu_word_size& reg,
-                   cpu_word_size const value);
-    void operator()();
-
-   private:
-    cpu_word_size& reg;
-    bool& zero_flag;
-    cpu_word_size const value = 0;
-};
-
-struct MoveOp {
-    MoveOp(DualRegisters&);
-    void operator()();
-    bool& is_move_flag;
-};
-
-struct DigOp {
-    DigOp(DualRegisters&);
-    void operator()();
-    bool& is_dig_flag;
-};
-struct CopyOp {
-    CopyOp(DualRegisters&, cpu_word_size& reg_src, cpu_word_size& reg_dst);
-    void operator()();
-    cpu_word_size &reg_src, &reg_dst;
-    bool& zero_flag;
-};
-
-struct AddOp {
-    AddOp(DualRegisters&, cpu_word_size& reg_src, cpu_word_size& reg_dst);
-    void operator()();
-    cpu_word_size &reg_src, &reg_dst;
-    bool& zero_flag;
-};
-
-struct SubOp {
-    SubOp(DualRegisters&, cpu_word_size& reg_src, cpu_word_size& reg_dst);
-    void operator()();
-    cpu_word_size &reg_src, &reg_dst;
-    bool& zero_flag;
-};
-
-struct IncOp {
-    IncOp(DualRegisters&, cpu_word_size& reg);
-    void operator()();
-    cpu_word_size& reg;
-    bool& zero_flag;
-};
-
-struct DecOp {
-    DecOp(DualRegisters&, cpu_word_size& reg);
-    void operator()();
-    cpu_word_size& reg;
-    bool& zero_flag;
-};
-
-struct JmpOp {
-    JmpOp(DualRegisters&, ushort address);
-    void operator()();
-    ushort& instr_ptr_register;
-    ushort address = 0;
-};
-
-struct JnzOp {
-    JnzOp(DualRegisters&, ushort address);
-    void operator()();
-    ushort& instr_ptr_register;
-    ushort address = 0;
-    bool const& zero_flag;
-};
-
-struct JnfOp {
-    JnfOp(DualRegisters&, ushort address);
-    void operator()();
-    ushort& instr_ptr_register;
-    ushort address = 0;
-    bool& instr_failed_flag;
-};
-
-struct CallOp {
-    CallOp(DualRegisters&, ushort address);
-    void operator()();
-
-    cpu_word_size* ram;
-    ushort& instr_ptr_register;
-    ushort& base_ptr_register;
-    ushort& stack_ptr_register;
-
-    ushort address = 0;
-};
-
-struct TurnLeftOp {
-    TurnLeftOp(DualRegisters&);
-    void operator()();
-    bool& dir_flag1;
-    bool& dir_flag2;
-};
-
-struct TurnRightOp {
-    TurnRightOp(DualRegisters&);
-    void operator()();
-    bool& dir_flag1;
-    bool& dir_flag2;
-};
-
-struct PopOp {
-    PopOp(DualRegisters&, cpu_word_size& reg);
-    void operator()();
-
-    cpu_word_size* ram;
-    cpu_word_size& reg;
-    ushort& stack_ptr_register;
-};
-
-struct PushOp {
-    PushOp(DualRegisters&, cpu_word_size& reg);
-    void operator()();
-
-    cpu_word_size* ram;
-    cpu_word_size& reg;
-    ushort& stack_ptr_register;
-};
-
-struct ReturnOp {
-    ReturnOp(DualRegisters&);
-    void operator()();
-
-    cpu_word_size* ram;
-    ushort& instr_ptr_register;
-    ushort& base_ptr_register;
-    ushort& stack_ptr_register;
-};
-
-struct CheckOp {
-    CheckOp(DualRegisters&);
-    void operator()();
-
-    bool& dir_flag1;
-    bool& dir_flag2;
-    uchar& is_space_empty_flags;
-    bool& instr_failed_flag;
-};
-
-struct ScentOnOp {
-    ScentBehaviors& scent_behaviors;
-    ulong& delta_scents;
-    ulong scent_idx;
-    ScentOnOp(DualRegisters&, uchar);
-    void operator()();
+// The ops do not hold any state of their own. Each one reads its operands from
+// the decoded instruction and applies it to the register file it is given, so
+// one compiled program can be run against any ant's registers. The definitions
+// live in the header so the interpreter's dispatch loop can inline them.
+
+// X-macro over every command and the op that implements it.
+#define FOR_EACH_OP(X)                      \
+    X(NOP, NoOP)                            \
+    X(MOVE, MoveOp)                         \
+    X(LOAD, LoadConstantOp)                 \
+    X(COPY, CopyOp)                         \
+    X(ADD, AddOp)                           \
+    X(SUB, SubOp)                           \
+    X(INC, IncOp)                           \
+    X(DEC, DecOp)                           \
+    X(PUSH, PushOp)                         \
+    X(POP, PopOp)                           \
+    X(JMP, JmpOp)                           \
+    X(JNZ, JnzOp)                           \
+    X(CALL, CallOp)                         \
+    X(RET, ReturnOp)                        \
+    X(JNF, JnfOp)                           \
+    X(LT, TurnLeftOp)                       \
+    X(RT, TurnRightOp)                      \
+    X(DIG, DigOp)                           \
+    X(CHECK, CheckOp)                       \
+    X(SCENT_ON, ScentOnOp)                  \
+    X(SCENT_OFF, ScentOffOp)                \
+    X(SET_SCENT_PRIORITY, SetScentPriorityOp) \
+    X(TURN_SCENT, TurnByScentOp)
+
+#define DECLARE_OP(command, T)                                    \
+    struct T {                                                    \
+        static void exec(DualRegisters& cpu, Instruction const&); \
+    };
+FOR_EACH_OP(DECLARE_OP)
+#undef DECLARE_OP
+
+// Maps a command to the op that implements it
+template <CommandEnum>
+struct CommandOp;
+
+#define DECLARE_COMMAND_OP(command, T)       \
+    template <>                              \
+    struct CommandOp<CommandEnum::command> { \
+        using type = T;                      \
+    };
+FOR_EACH_OP(DECLARE_COMMAND_OP)
+#undef DECLARE_COMMAND_OP
+
+// X-macro over the superinstructions emitted by the optimizer as
+// X(fused command, head command, tail command). The head must be an async op
+// that does not jump.
+#define FOR_EACH_FUSED_OP(X)       \
+    X(DEC_JNZ, DEC, JNZ)           \
+    X(INC_JNZ, INC, JNZ)           \
+    X(SUB_JNZ, SUB, JNZ)           \
+    X(LOAD_COPY, LOAD, COPY)       \
+    X(LT_MOVE, LT, MOVE)           \
+    X(RT_MOVE, RT, MOVE)           \
+    X(LT_DIG, LT, DIG)             \
+    X(RT_DIG, RT, DIG)             \
+    X(SCENT_MOVE, TURN_SCENT, MOVE)
+
+// Fused commands are numbered past the 5 bit machine code commands so they
+// only ever appear in compiled programs
+enum FusedCommand {
+    FUSED_COMMAND_BASE = 0b11111,
+#define DECLARE_FUSED_COMMAND(fused, head, tail) fused,
+    FOR_EACH_FUSED_OP(DECLARE_FUSED_COMMAND)
+#undef DECLARE_FUSED_COMMAND
+    FUSED_COMMAND_END
 };
 
-struct ScentOffOp {
-    ScentBehaviors& scent_behaviors;
-    ScentOffOp(DualRegisters&);
-    void operator()();
+inline bool is_fused_command(uchar command) {
+    return command > FUSED_COMMAND_BASE && command < FUSED_COMMAND_END;
+}
+
+// Splits a superinstruction into the commands it was fused from. Returns
+// false for any other command.
+inline bool get_fused_pair(uchar command, uchar& head, uchar& tail) {
+    switch(command) {
+#define FUSED_PAIR(fused, head_command, tail_command) \
+    case FusedCommand::fused:                         \
+        head = CommandEnum::head_command;             \
+        tail = CommandEnum::tail_command;             \
+        return true;
+        FOR_EACH_FUSED_OP(FUSED_PAIR)
+#undef FUSED_PAIR
+    }
+    return false;
+}
+
+// Jumps that close a counted loop - the value indexes the image's loops. The
+// ops run them as a plain JNZ / JMP, the interpreter's async run skips as many
+// whole iterations at once as its budget allows.
+enum LoopCommand { LOOP_JNZ = FUSED_COMMAND_END, LOOP_JMP };
+
+// A superinstruction runs the head op on its own slot and the tail op on the
+// following slot. The tail slot is left as it was so jumps into it still work.
+// It is charged both instructions against the tick budget - see
+// Instruction::length.
+template <CommandEnum Head, CommandEnum Tail>
+struct FusedOp {
+    static void exec(DualRegisters& cpu, Instruction const& instr) {
+        CommandOp<Head>::type::exec(cpu, instr);
+        ++cpu.instr_ptr_register;
+        CommandOp<Tail>::type::exec(cpu, (&instr)[1]);
+    }
 };
 
-struct SetScentPriorityOp {
-    ulong& priorities;
-    ulong clear_mask, priority;
-    SetScentPriorityOp(DualRegisters&, uchar scent_idx, uchar priority);
-    void operator()();
-};
-
-struct TurnByScentOp {
-    bool &dir_flag1, &dir_flag2;
-    bool &scent_dir1, &scent_dir2;
-    TurnByScentOp(DualRegisters&);
-    void operator()();
-};
+// NOP //////////////////////////////////////////
+inline void NoOP::exec(DualRegisters&, Instruction const&) {
+    SPDLOG_TRACE("NOP operation executed");
+}
+
+// LOAD CONSTANT TO REGISTER ////////////////////
+inline void LoadConstantOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    SPDLOG_TRACE("Writing value {} to register", instr.value);
+    cpu[instr.reg_dst] = instr.value;
+    cpu.zero_flag = instr.value == 0;
+}
+
+// MOVE /////////////////////////////////////////
+inline void MoveOp::exec(DualRegisters& cpu, Instruction const&) {
+    SPDLOG_DEBUG("Executing MoveOp");
+    cpu.is_move_flag = true;
+}
+
+// DIG /////////////////////////////////////////
+inline void DigOp::exec(DualRegisters& cpu, Instruction const&) {
+    SPDLOG_DEBUG("Executing DigOp");
+    cpu.is_dig_flag = true;
+}
+
+// COPY REGISTER TO REGISTER ////////////////////
+inline void CopyOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu_word_size const src = cpu[instr.reg_src];
+    cpu[instr.reg_dst] = src;
+    cpu.zero_flag = src == 0;
+    SPDLOG_TRACE("Copying register with result {}", src);
+}
+
+// ADD REGISTER TO REGISTER ////////////////////
+inline void AddOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu_word_size& dst = cpu[instr.reg_dst];
+    dst += cpu[instr.reg_src];
+    cpu.zero_flag = dst == 0;
+    SPDLOG_TRACE("Adding registers - result: {}", dst);
+}
+
+// SUB REGISTER TO REGISTER ////////////////////
+inline void SubOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu_word_size& dst = cpu[instr.reg_dst];
+    dst -= cpu[instr.reg_src];
+    cpu.zero_flag = dst == 0;
+    SPDLOG_TRACE("Subtracting registers - result: {}", dst);
+}
+
+// INC REGISTER ////////////////////////////////
+inline void IncOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu_word_size& reg = cpu[instr.reg_dst];
+    ++reg;
+    cpu.zero_flag = reg == 0;
+    SPDLOG_TRACE("Incremented register - result: {}", reg);
+}
+
+// DEC REGISTER ////////////////////////////////
+inline void DecOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu_word_size& reg = cpu[instr.reg_dst];
+    --reg;
+    cpu.zero_flag = reg == 0;
+    SPDLOG_TRACE("Decremented register - result: {}", reg);
+}
+
+// JMP /////////////////////////////////////////
+inline void JmpOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu.instr_ptr_register = instr.address;
+    SPDLOG_TRACE("Jumped to address {}", instr.address);
+}
+
+// JNZ /////////////////////////////////////////
+inline void JnzOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    if(cpu.zero_flag) {
+        SPDLOG_TRACE("Zero flag is set, not jumping");
+        return;
+    }
+    SPDLOG_TRACE("Zero flag off - jumping to address {}", instr.address);
+    cpu.instr_ptr_register = instr.address;
+}
+
+// JNF /////////////////////////////////////////
+inline void JnfOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    if(cpu.instr_failed_flag) {
+        SPDLOG_TRACE("Instruction failed flag is set, not jumping");
+        return;
+    }
+    SPDLOG_TRACE("Instruction failed flag off - jumping to address {}",
+                 instr.address);
+    cpu.instr_ptr_register = instr.address;
+}
+
+// CALL /////////////////////////////////////////
+inline void CallOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    SPDLOG_TRACE("Executing call operation - jumping to address {}",
+                 instr.address);
+
+    // Calling a function
+    // Reversed by 'returning' in the function call
+
+    // Push the instruction pointer register to the stack
+    cpu.ram[cpu.stack_ptr_register] = cpu.instr_ptr_register;
+    ++cpu.stack_ptr_register;
+
+    // Pushing base pointer register to the stack
+    cpu.ram[cpu.stack_ptr_register] = cpu.base_ptr_register;
+    ++cpu.stack_ptr_register;
+
+    // Move the instruction pointer
+    cpu.instr_ptr_register = instr.address;
+
+    // Set the base pointer register
+    cpu.base_ptr_register = cpu.stack_ptr_register;
+}
+
+// TURN LEFT /////////////////////////////////////////
+inline void TurnLeftOp::exec(DualRegisters& cpu, Instruction const&) {
+    // Truth Table - Counterclockwise rotation
+
+    // X Y   A B
+    // 0 0 | 0 1
+    // 0 1 | 1 0
+    // 1 0 | 1 1
+    // 1 1 | 0 0
+
+    // A = X ^ Y
+    // B = !Y
+
+    // Update heading
+    cpu.dir_flag1 = cpu.dir_flag1 != cpu.dir_flag2;
+    cpu.dir_flag2 = !cpu.dir_flag2;
+}
+
+// TURN RIGHT /////////////////////////////////////////
+inline void TurnRightOp::exec(DualRegisters& cpu, Instruction const&) {
+    // Truth Table
+
+    // X Y   A B
+    // 0 0 | 1 1
+    // 0 1 | 0 0
+    // 1 0 | 0 1
+    // 1 1 | 1 0
+
+    // A = !(X ^ Y)
+    // B = ! Y
+
+    // Update heading
+    cpu.dir_flag1 = cpu.dir_flag1 == cpu.dir_flag2;
+    cpu.dir_flag2 = !cpu.dir_flag2;
+}
+
+// POP REGISTER FROM RAM ////////////////////////////////
+inline void PopOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu[instr.reg_dst] = cpu.ram[--cpu.stack_ptr_register];
+}
+
+// PUSH REGISTER TO RAM ////////////////////////////////
+inline void PushOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu.ram[cpu.stack_ptr_register] = cpu[instr.reg_dst];
+    ++cpu.stack_ptr_register;
+}
+
+// RETURN FROM FUNCTION /////////////////////////////////////////
+inline void ReturnOp::exec(DualRegisters& cpu, Instruction const&) {
+    SPDLOG_TRACE("Executing return operation");
+
+    // Restore the stack pointer
+    cpu.stack_ptr_register = cpu.base_ptr_register;
+
+    // Restore the base pointer
+    cpu.base_ptr_register = cpu.ram[--cpu.stack_ptr_register];
+
+    // Get the previous instruction address
+    cpu.instr_ptr_register = cpu.ram[--cpu.stack_ptr_register];
+}
+
+// CHECK MAP /////////////////////////////////////////
+inline void CheckOp::exec(DualRegisters& cpu, Instruction const&) {
+    // Truth Table
+    // X Y   Index
+    // 0 0 | 0
+    // 0 1 | 1
+    // 1 0 | 2
+    // 1 1 | 3
+
+    uchar idx = (cpu.dir_flag1 << 1) | cpu.dir_flag2;
+    bool is_empty = (cpu.surroundings.empty_bits() >> idx) & 1;
+    cpu.instr_failed_flag = !is_empty;
+    SPDLOG_TRACE("Checking direction: {} -> {}", "RULD"[idx],
+                 (is_empty ? "EMPTY" : "FULL"));
+}
+
+// SCENT ON /////////////////////////////////////////
+inline void ScentOnOp::exec(DualRegisters& cpu, Instruction const& instr) {
+    cpu.scent_behaviors.write_scent_behavior =
+        IncrementScentBehavior(cpu.delta_scents, instr.scent_idx);
+}
+
+// SCENT OFF /////////////////////////////////////////
+inline void ScentOffOp::exec(DualRegisters& cpu, Instruction const&) {
+    cpu.scent_behaviors.write_scent_behavior = ImmutableScentBehavior();
+}
+
+// SET SCENT PRIORITY /////////////////////////////////////////
+inline void SetScentPriorityOp::exec(DualRegisters& cpu,
+                                     Instruction const& instr) {
+    ulong const shift = instr.scent_idx * 8;
+    ulong const clear_mask = ~(0xFFUL << shift);
+    ulong const priority = static_cast<ulong>(instr.value & 0xFF) << shift;
+    ulong& priorities = cpu.scent_behaviors.priorities;
+    priorities = (priorities & clear_mask) | priority;
+}
+
+// TURN DIRECTION BY READING SCENT /////////////////////////////////////////
+inline void TurnByScentOp::exec(DualRegisters& cpu, Instruction const&) {
+    cpu.dir_flag1 = cpu.scent_behaviors.scent_dir1;
+    cpu.dir_flag2 = cpu.scent_behaviors.scent_dir2;
+}
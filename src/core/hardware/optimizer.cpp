@@ -0,0 +1,99 @@
+#include "hardware/optimizer.hpp"
+
+#include <climits>
+
+#include "hardware/command_config.hpp"
+#include "hardware/control_flow.hpp"
+#include "hardware/op_def.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+    using Program = std::vector<Instruction>;
+
+    // A threaded jump is charged every JMP it skips, so a chain is cut short
+    // where the length would no longer fit
+    constexpr size_t max_skipped_jumps = UCHAR_MAX - 1;
+
+    // Follows unconditional jumps from the target to the first instruction
+    // that does something. Counts the JMPs it skipped in hops - a JMP that was
+    // already threaded counts the ones it skips too - and a cycle of jumps
+    // gives up once the length is full.
+    ushort resolve_target(Program const& program, ushort target, uchar& hops) {
+        hops = 0;
+        while(target < program.size()) {
+            Instruction const& instr = program[target];
+            if(instr.command != CommandEnum::JMP) break;
+            if(hops + instr.length > max_skipped_jumps) break;
+            target = instr.get_target();
+            hops += instr.length;
+        }
+        return target;
+    }
+
+    // A JMP to a JMP goes straight to where the chain ends. The skipped JMPs
+    // still cost the budget a tick each so they are added to its length, and
+    // the first hop is kept in the value for a tick that ends inside the
+    // chain. The conditional jumps are left alone as only a taken branch
+    // would be charged the chain.
+    void thread_jumps(Program& program) {
+        for(Instruction& instr : program) {
+            if(instr.command != CommandEnum::JMP) continue;
+            uchar hops;
+            ushort const target =
+                resolve_target(program, instr.get_target(), hops);
+            if(hops == 0) continue;
+            SPDLOG_TRACE("Threading jump to address {} through {} jumps",
+                         target, hops);
+            instr.value = instr.address;
+            instr.length = 1 + hops;
+            instr.set_target(target);
+        }
+    }
+
+    uchar get_fused_command(uchar head, uchar tail) {
+#define MATCH_FUSED_OP(fused, head_command, tail_command) \
+    if(head == CommandEnum::head_command &&               \
+       tail == CommandEnum::tail_command)                 \
+        return FusedCommand::fused;
+        FOR_EACH_FUSED_OP(MATCH_FUSED_OP)
+#undef MATCH_FUSED_OP
+        return head;
+    }
+
+    // The slots are visited from the front so the tail is always still the
+    // decoded instruction. The head keeps its operands and takes the tick
+    // count of the tail so a fused sync instruction still ends the async run,
+    // and its length so the pair costs the budget what the two did.
+    void fuse_pairs(Program& program) {
+        for(size_t i = 0; i + 1 < program.size(); ++i) {
+            Instruction& head = program[i];
+            Instruction const& tail = program[i + 1];
+            if(head.num_ticks != 0) continue;
+            uchar const fused = get_fused_command(head.command, tail.command);
+            if(fused == head.command) continue;
+            SPDLOG_TRACE("Fusing instructions at addresses {} - {}", i, i + 1);
+            head.command = fused;
+            head.num_ticks = tail.num_ticks;
+            head.length = 2;
+        }
+    }
+
+    // The loops are found before fusing so the loop body keeps one dispatch
+    // per instruction
+    void mark_counted_loops(Program& program, std::vector<CountedLoop>& loops) {
+        ControlFlowGraph(program).find_counted_loops(program, loops);
+        for(size_t i = 0; i < loops.size(); ++i) {
+            Instruction& jump = program[loops[i].end];
+            jump.command = jump.command == CommandEnum::JNZ
+                               ? LoopCommand::LOOP_JNZ
+                               : LoopCommand::LOOP_JMP;
+            jump.value = i;
+        }
+    }
+}  // namespace
+
+void Optimizer::optimize(CompileArgs& args) {
+    thread_jumps(args.instructions);
+    mark_counted_loops(args.instructions, args.loops);
+    fuse_pairs(args.instructions);
+}
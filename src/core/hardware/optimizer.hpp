@@ -0,0 +1,15 @@
+#pragma once
+
+#include "hardware/compile_args.hpp"
+
+// Peephole pass over a decoded program run by the compiler before the program
+// is handed to the interpreter.
+// The pass never moves an instruction, every slot keeps the address of the
+// machine code instruction it was decoded from. Jump targets, saved
+// instruction pointers and the return addresses on the stack stay valid and
+// the sync instructions keep their tick counts.
+namespace Optimizer {
+    // Thread JMPs through jump chains, mark the jumps closing counted loops
+    // and fuse the common instruction pairs into superinstructions.
+    void optimize(CompileArgs& args);
+}  // namespace Optimizer
@@ -1,20 +1,21 @@
 #pragma once
 
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "hardware/label_map.hpp"
+#include "hardware/lexer.hpp"
 #include "utils/status.hpp"
 
 using uchar = unsigned char;
 
 struct ParseArgs {
-    ParseArgs(std::string const& line, std::vector<uchar>& code,
+    ParseArgs(std::string_view line, std::vector<uchar>& code,
               LabelMap& labels, Status& status)
-        : code_stream(line), code(code), labels(labels), status(status) {}
+        : tokens(line), code(code), labels(labels), status(status) {}
 
-    std::istringstream code_stream;
+    Lexer tokens;  // the words after the command
     std::vector<uchar>& code;
     LabelMap const& labels;
     Status& status;
@@ -1,11 +1,9 @@
 #include "hardware/parser.hpp"
 
-#include <sstream>
-
+#include "hardware/lexer.hpp"
 #include "hardware/machine_code.hpp"
 #include "hardware/parse_args.hpp"
 #include "spdlog/spdlog.h"
-#include "utils/string.hpp"
 
 Parser::Parser(CommandMap const& command_map) : command_map(command_map) {
     SPDLOG_TRACE("Command parser created");
@@ -13,10 +11,9 @@ Parser::Parser(CommandMap const& command_map) : command_map(command_map) {
 
 void Parser::parse(std::vector<std::string> const& program_code,
                    MachineCode& machine_code, Status& status) {
-    SPDLOG_INFO("Parsing program code");
+    SPDLOG_DEBUG("Parsing program code");
 
-    std::vector<std::string> active_code;
-    preprocess(program_code, machine_code.labels, active_code, status);
+    preprocess(program_code, machine_code.labels, status);
     if(status.p_err) {
         SPDLOG_TRACE("Terminate parsing due to error");
         return;
@@ -25,42 +22,53 @@ void Parser::parse(std::vector<std::string> const& program_code,
         return;
     }
 
-    SPDLOG_INFO("Parsing {} lines of code text", active_code.size());
-    for(std::string const& line : active_code) {
+    SPDLOG_DEBUG("Parsing {} lines of code text", active_code.size());
+    // no command is longer than a LOAD
+    machine_code.code.reserve(machine_code.code.size() +
+                              active_code.size() * max_command_bytes);
+    for(std::string_view line : active_code) {
         SPDLOG_DEBUG("Parsing line: {}", line);
         ParseArgs args(line, machine_code.code, machine_code.labels, status);
 
-        std::string cmd_str;
-        args.code_stream >> cmd_str;
+        std::string_view const cmd_str = args.tokens.word();
         SPDLOG_TRACE("Extracted word: {}", cmd_str);
 
-        auto it = command_map.find(cmd_str);
-        if(it == command_map.str_end()) {
-            std::stringstream err;
-            err << "THE FOLLOWING IS NOT A VALID COMMAND: " << cmd_str;
-            status.error(err.str());
+        CommandConfig const* command = command_map.find_command(cmd_str);
+        if(command == nullptr) {
+            status.error("THE FOLLOWING IS NOT A VALID COMMAND: " +
+                         std::string(cmd_str));
             return;
         }
 
-        CommandConfig const& command = *it->second;
-        command.parse(command, args);  // parse command
-        if(status.p_err) return;       // return if error parsing command
+        command->parse(*command, args);  // parse command
+        if(status.p_err) return;         // return if error parsing command
 
         SPDLOG_TRACE("Current parsed code size: {} bytes",
                      machine_code.code.size());
     }
-    SPDLOG_INFO("Successfully parsed: {} / {} lines -> {} bytes",
-                active_code.size(), program_code.size(),
-                machine_code.code.size());
+    SPDLOG_DEBUG("Successfully parsed: {} / {} lines -> {} bytes",
+                 active_code.size(), program_code.size(),
+                 machine_code.code.size());
 }
 
+// Writes the lines in order - the label of an address goes on its own line in
+// front of the instruction
 void Parser::deparse(MachineCode const& machine_code,
                      std::vector<std::string>& program_code, Status& status) {
-    SPDLOG_INFO("Starting deparsing instructions <- {} bytes",
-                machine_code.code.size());
-    DeparseArgs args(machine_code.code.begin(), machine_code.labels,
-                     program_code, status);
+    SPDLOG_DEBUG("Starting deparsing instructions <- {} bytes",
+                 machine_code.code.size());
+    LabelMap const& labels = machine_code.labels;
+    program_code.reserve(program_code.size() + labels.size() +
+                         machine_code.code.size());
+    DeparseArgs args(machine_code.code.begin(), labels, program_code, status);
+    ushort address = 0;
+    auto deparse_label = [&]() {
+        std::string const* label = labels.find(address);
+        if(label) program_code.emplace_back(*label) += ':';
+    };
+
     while(args.code_it != machine_code.code.end()) {
+        deparse_label();
         uchar instruction_code = *args.code_it >> 3;
         SPDLOG_TRACE("Instruction code: {}", instruction_code);
         CommandEnum instruction = static_cast<CommandEnum>(instruction_code);
@@ -73,27 +81,16 @@ void Parser::deparse(MachineCode const& machine_code,
                          command.command_string);
             return;
         }
+        ++address;
         SPDLOG_TRACE("Successfully deparsed instruction");
     }
+    deparse_label();  // a label after the last instruction
 
-    SPDLOG_DEBUG("Getting addresses to insert instruction labels");
-    std::vector<ushort> addresses;
-    machine_code.labels.get_addresses(addresses);
-
-    SPDLOG_TRACE("Sorting the label addresses");
-    std::sort(addresses.rbegin(), addresses.rend());
-
-    SPDLOG_TRACE("Inserting the labels into the instruction vector");
-    for(ushort address : addresses) {
-        std::string label = machine_code.labels.at(address) + ":";
-        program_code.insert(program_code.begin() + address, label);
-    }
-
-    SPDLOG_INFO("Successfully deparsed: {} bytes -> {} lines",
-                machine_code.code.size(), program_code.size());
+    SPDLOG_DEBUG("Successfully deparsed: {} bytes -> {} lines",
+                 machine_code.code.size(), program_code.size());
 }
 
-bool Parser::handle_label(LabelMap& labels, std::string const& word,
+bool Parser::handle_label(LabelMap& labels, std::string_view word,
                           ushort address, Status& status) {
     SPDLOG_TRACE("Checking if label: {}", word);
     if(word[word.length() - 1] != ':') {
@@ -111,12 +108,13 @@ bool Parser::handle_label(LabelMap& labels, std::string const& word,
     return true;
 }
 
+// Collects the trimmed lines that hold an instruction into active_code
 void Parser::preprocess(std::vector<std::string> const& program_code,
-                        LabelMap& labels, std::vector<std::string>& active_code,
-                        Status& status) {
+                        LabelMap& labels, Status& status) {
     SPDLOG_DEBUG("Preprocessing string program");
+    active_code.clear();
     for(std::string const& raw_line : program_code) {
-        std::string line = trim_copy(raw_line);
+        std::string_view const line = Lexer::trim(raw_line);
         if(line.length() == 0 || line[0] == '#') continue;
         if(handle_label(labels, line, active_code.size(), status)) continue;
 
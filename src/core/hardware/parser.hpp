@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "hardware/command_config.hpp"
 #include "utils/status.hpp"
@@ -17,9 +19,12 @@ class Parser {
     void deparse(MachineCode const&, std::vector<std::string>&, Status&);
 
    private:
-    bool handle_label(LabelMap&, std::string const&, ushort, Status&);
-    void preprocess(std::vector<std::string> const&, LabelMap&,
-                    std::vector<std::string>&, Status&);
+    bool handle_label(LabelMap&, std::string_view, ushort, Status&);
+    void preprocess(std::vector<std::string> const&, LabelMap&, Status&);
 
     CommandMap const& command_map;
+    // views of the instruction lines of the program being parsed - kept so
+    // the buffer is reused by the next parse
+    std::vector<std::string_view> active_code;
+    static constexpr size_t max_command_bytes = 5;
 };
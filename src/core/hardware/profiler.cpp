@@ -0,0 +1,56 @@
+#include "hardware/profiler.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+#include "hardware/machine_code.hpp"
+#include "hardware/parser.hpp"
+#include "spdlog/spdlog.h"
+
+void get_profile_lines(Parser& parser, MachineCode const& machine_code,
+                       ProgramProfile const* profile,
+                       std::vector<ProfileLine>& lines, Status& status) {
+    std::vector<std::string> source;
+    parser.deparse(machine_code, source, status);
+    lines.clear();
+    if(status.p_err) return;
+
+    // deparse writes one line per instruction and puts the labels on their
+    // own lines in front of the instruction they name
+    ushort address = 0;
+    for(std::string& text : source) {
+        ProfileLine& line = lines.emplace_back();
+        line.text = std::move(text);
+        line.is_instruction = line.text.empty() || line.text.back() != ':';
+        if(!line.is_instruction) continue;
+
+        if(profile && address < profile->counts.size()) {
+            AddressCounts const& counts = profile->counts[address];
+            line.executed = counts.executed.load(std::memory_order_relaxed);
+            line.stalls = counts.stalls.load(std::memory_order_relaxed);
+            line.failed = counts.failed.load(std::memory_order_relaxed);
+        }
+        ++address;
+    }
+    SPDLOG_DEBUG("Collected the profile of {} instructions", address);
+}
+
+void format_profile(std::vector<ProfileLine> const& lines,
+                    std::vector<std::string>& out) {
+    std::ostringstream header;
+    header << std::setw(12) << "EXECUTED" << std::setw(12) << "STALLS"
+           << std::setw(10) << "FAILED" << "  SOURCE";
+    out.push_back(header.str());
+
+    for(ProfileLine const& line : lines) {
+        std::ostringstream row;
+        if(line.is_instruction) {
+            row << std::setw(12) << line.executed << std::setw(12)
+                << line.stalls << std::setw(10) << line.failed << "    ";
+        } else {
+            row << std::string(36, ' ');
+        }
+        row << line.text;
+        out.push_back(row.str());
+    }
+}
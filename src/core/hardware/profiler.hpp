@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "utils/status.hpp"
+
+using ulong = unsigned long;
+using ushort = unsigned short;
+
+class Parser;
+struct MachineCode;
+
+// Counts of one instruction address summed over every ant running the image.
+// The async runs happen on the thread pool so the counters are relaxed
+// atomics - only the totals matter, not the order they are added in.
+struct AddressCounts {
+    std::atomic_ulong executed = 0;
+    std::atomic_ulong stalls = 0;  // ticks from a sync step to the next run
+    std::atomic_ulong failed = 0;  // CHECK found a wall, MOVE or DIG failed
+};
+
+// Per address counts of a program image - indexed like the decoded
+// instructions, which is the order of the source instructions
+struct ProgramProfile {
+    std::vector<AddressCounts> counts;
+
+    explicit ProgramProfile(size_t size) : counts(size) {}
+};
+
+// The profiling policy of the interpreter and the executors. The hooks of
+// NoProfiler are empty so its instantiations compile to the unprofiled code,
+// AddressProfiler adds to the profile of the image. The policy is picked at
+// build time with PROFILE_PROGRAMS - see ExecutorProfiler.
+struct NoProfiler {
+    static constexpr bool is_enabled = false;
+    static void executed(ProgramProfile*, ushort, ulong = 1) {}
+    static void stalled(ProgramProfile*, ushort, ulong) {}
+    static void failed(ProgramProfile*, ushort) {}
+};
+
+struct AddressProfiler {
+    static constexpr bool is_enabled = true;
+    static void executed(ProgramProfile* profile, ushort address,
+                         ulong times = 1) {
+        profile->counts[address].executed.fetch_add(times,
+                                                    std::memory_order_relaxed);
+    }
+    static void stalled(ProgramProfile* profile, ushort address, ulong ticks) {
+        profile->counts[address].stalls.fetch_add(ticks,
+                                                  std::memory_order_relaxed);
+    }
+    static void failed(ProgramProfile* profile, ushort address) {
+        profile->counts[address].failed.fetch_add(1,
+                                                  std::memory_order_relaxed);
+    }
+};
+
+#ifdef PROFILE_PROGRAMS
+using ExecutorProfiler = AddressProfiler;
+#else
+using ExecutorProfiler = NoProfiler;
+#endif
+
+// One line of the deparsed source with the counts of its instruction. Labels
+// have no instruction and keep zero counts.
+struct ProfileLine {
+    std::string text;
+    bool is_instruction = false;
+    ulong executed = 0;
+    ulong stalls = 0;
+    ulong failed = 0;
+};
+
+// Deparses the machine code and attaches the profile counts to the source
+// lines. A null profile gives the lines without counts.
+void get_profile_lines(Parser& parser, MachineCode const& machine_code,
+                       ProgramProfile const* profile,
+                       std::vector<ProfileLine>& lines, Status& status);
+
+// Text table of the lines - one row per source line
+void format_profile(std::vector<ProfileLine> const& lines,
+                    std::vector<std::string>& out);
@@ -1,91 +1,168 @@
 #include "hardware/program_executor.hpp"
 
 #include "entity/entity_data.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/interpreter.hpp"
+#include "hardware/lockstep.hpp"
+#include "hardware/op_def.hpp"
+#include "hardware/program_image.hpp"
 #include "proto/hardware.pb.h"
 #include "spdlog/spdlog.h"
 #include "utils/serializer.hpp"
 
 ProgramExecutor::ProgramExecutor(ulong const& instr_clock,
                                  ulong max_instruction_per_tick,
-                                 ushort& instr_ptr_register,
-                                 ThreadPool<AsyncProgramJob>& job_pool)
-    : instr_ptr_register(instr_ptr_register),
-      instr_trigger(0),
+                                 DualRegisters& cpu)
+    : cpu(cpu),
       has_executed_async(false),
       has_executed_sync(false),
       instr_clock(instr_clock),
-      max_instruction_per_tick(max_instruction_per_tick),
-      job_pool(job_pool) {}
+      max_instruction_per_tick(max_instruction_per_tick) {}
 
-ProgramExecutor::ProgramExecutor(const ant_proto::ProgramExecutor& msg,
-                                 ulong const& instr_clock,
-                                 ulong max_instruction_per_tick,
-                                 ushort& instr_ptr_register,
-                                 ThreadPool<AsyncProgramJob>& job_pool)
-    : instr_ptr_register(instr_ptr_register),
-      instr_trigger(msg.instr_trigger()),
-      has_executed_sync(msg.has_executed()),
-      instr_clock(instr_clock),
-      max_instruction_per_tick(max_instruction_per_tick),
-      job_pool(job_pool)
-
-{}
+void ProgramExecutor::unpack(const ant_proto::ProgramExecutor& msg) {
+    has_executed_sync = msg.has_executed();
+    cpu.instr_trigger = msg.instr_trigger();
+}
 
 void ProgramExecutor::reset() { has_executed_sync = false; }
 
-void ProgramExecutor::execute_async() {
+// True if the registers restored from a save are a state the verified image
+// can be in - halted, or in the entry frame at the stack depth the verifier
+// found for the address. The ram is not saved so an ant saved inside a call
+// could not return from it.
+bool ProgramExecutor::fits_image() const {
+    if(cpu.instr_ptr_register >= program_size()) return true;
+    if(cpu.base_ptr_register != 0) return false;
+    return image->entry_depths[cpu.instr_ptr_register] ==
+           static_cast<short>(cpu.stack_ptr_register);
+}
+
+// Starts the program over with an empty stack
+void ProgramExecutor::restart() {
+    cpu.instr_ptr_register = 0;
+    cpu.base_ptr_register = 0;
+    cpu.stack_ptr_register = 0;
+}
+
+// Runs on a thread pool thread as part of an AsyncProgramJob batch
+ulong ProgramExecutor::execute_async() {
+    if(!begin_async()) return 0;
+    return finish_async(0);
+}
+
+// True when the trigger fires this tick and the async run should happen
+bool ProgramExecutor::begin_async() {
     // SPDLOG_INFO("Handling clock pulse for program_executor - clock: {}
-    // trigger: {}", instr_clock, instr_trigger);
+    // trigger: {}", instr_clock, cpu.instr_trigger);
     has_executed_async = false;
-    if(instr_ptr_register >= _ops.size()) return;
-    if((instr_clock % (instr_trigger + 1)) != 0) return;
-    instr_trigger = 0;  // if not 0, then a syncronous move is occurring
+    if constexpr(ExecutorProfiler::is_enabled) {
+        if(is_sync_pending && cpu.instr_failed_flag)
+            ExecutorProfiler::failed(image->profile.get(), sync_address);
+        is_sync_pending = false;
+    }
+    if(cpu.instr_ptr_register >= program_size()) return false;
+    if((instr_clock % (cpu.instr_trigger + 1)) != 0) return false;
+    cpu.instr_trigger = 0;  // if not 0, then a syncronous move is occurring
     has_executed_async = true;
-    AsyncProgramJob job(*this);
-    job_pool.submit_job(job);
+    return true;
+}
 
-    SPDLOG_TRACE("Submitted async job - instruction address: {}",
-                 instr_ptr_register);
+// Continues an async run that already executed some instructions and returns
+// the total
+ulong ProgramExecutor::finish_async(ulong executed) {
+    SPDLOG_TRACE("Executing async instructions - instruction address: {}",
+                 cpu.instr_ptr_register);
+    ulong const budget = async_budget();
+    // the native code has no profiling hooks
+    if(image->jit && !ExecutorProfiler::is_enabled)
+        executed += image->jit->run(cpu, budget - executed);
+    // finishes a run the native code left off at a block it could not fit
+    executed += Interpreter::run_async<ExecutorProfiler>(*image, cpu,
+                                                         budget - executed);
+    is_budget_spent = executed >= budget;
+    return executed;
 }
 
 void ProgramExecutor::execute() {
-    instr_trigger = _ops[instr_ptr_register].num_ticks;
-    _ops[instr_ptr_register]();
-    ++instr_ptr_register;
+    Instruction const& instr = image->instructions[cpu.instr_ptr_register];
+    if(is_budget_spent && instr.length > 1) {
+        // the tick ends between the two instructions of the superinstruction
+        // and its head is async - or inside the chain of a threaded JMP
+        cpu.instr_trigger = 0;
+        if constexpr(ExecutorProfiler::is_enabled)
+            ExecutorProfiler::executed(image->profile.get(),
+                                       cpu.instr_ptr_register);
+        Interpreter::step_head(image->instructions.data(), cpu);
+        return;
+    }
+    cpu.instr_trigger = instr.num_ticks;
+    if constexpr(ExecutorProfiler::is_enabled) profile_sync(instr);
+    Interpreter::step(image->instructions.data(), cpu);
+}
+
+// Counts the sync instruction about to be stepped and the ticks the executor
+// waits on it. A superinstruction waits on its tail.
+void ProgramExecutor::profile_sync(Instruction const& instr) {
+    ProgramProfile* const profile = image->profile.get();
+    ushort address = cpu.instr_ptr_register;
+    uchar command = instr.command;
+    if(is_fused_command(command)) {
+        ExecutorProfiler::executed(profile, address++);
+        command = (&instr)[1].command;
+    }
+    ExecutorProfiler::executed(profile, address);
+    ExecutorProfiler::stalled(profile, address,
+                              next_trigger_tick() - instr_clock);
+    sync_address = address;
+    is_sync_pending =
+        command == CommandEnum::MOVE || command == CommandEnum::DIG;
 }
 
 void ProgramExecutor::execute_sync() {
     if(has_executed_sync) return;
-    if(instr_ptr_register >= _ops.size()) return;
+    if(cpu.instr_ptr_register >= program_size()) return;
     if(!has_executed_async) return;
     has_executed_sync = true;
     SPDLOG_TRACE("Executing sync operation at instruction address: {}",
-                 instr_ptr_register);
+                 cpu.instr_ptr_register);
     execute();
 }
 
 bool ProgramExecutor::is_sync() {
-    return _ops[instr_ptr_register].num_ticks != 0;
+    return image->instructions[cpu.instr_ptr_register].num_ticks != 0;
+}
+
+bool ProgramExecutor::is_halted() const {
+    return cpu.instr_ptr_register >= program_size();
+}
+
+// The first tick after the current one that passes the trigger check in
+// execute_async
+ulong ProgramExecutor::next_trigger_tick() const {
+    ulong const period = cpu.instr_trigger + 1;
+    return (instr_clock / period + 1) * period;
+}
+
+size_t ProgramExecutor::program_size() const {
+    return image ? image->size() : 0;
 }
 
 void AsyncProgramJob::run() {
-    for(ulong i = 1; i < pe.max_instruction_per_tick &&
-                     pe.instr_ptr_register < pe._ops.size();
-        ++i) {
-        if(pe.is_sync()) {  // break if a syncronous instruction
-            break;
+    ulong executed = 0;
+    if(is_lockstep) {
+        executed = Lockstep::run(execs, count);
+    } else {
+        for(ulong i = 0; i < count; ++i) {
+            execs[i]->reset();
+            executed += execs[i]->execute_async();
         }
-        SPDLOG_TRACE("Executing async operation at instruction address: {}",
-                     pe.instr_ptr_register);
-        pe.execute();
-        SPDLOG_TRACE("Incrementing instruction pointer register to {}",
-                     pe.instr_ptr_register);
     }
+    instructions_executed += executed;
 }
 
 ant_proto::ProgramExecutor ProgramExecutor::get_proto() {
     ant_proto::ProgramExecutor msg;
-    msg.set_instr_trigger(instr_trigger);
+    msg.set_instr_trigger(cpu.instr_trigger);
     msg.set_has_executed(has_executed_sync);
     return msg;
 }
@@ -1,52 +1,64 @@
 #pragma once
 
-#include <functional>
-#include <vector>
+#include <atomic>
 
 #include "hardware.pb.h"
-#include "hardware/op_def.hpp"
-#include "utils/thread_pool.hpp"
 
 using ulong = unsigned long;
 using ushort = unsigned short;
 
 class Packer;
 class Unpacker;
+struct DualRegisters;
+struct Instruction;
+struct ProgramImage;
 struct ProgramExecutor;
 
-struct Op {
-    unsigned short num_ticks;
-    std::function<void()> fn;
-    void operator()() { fn(); };
-};
-
+// A contiguous run of executors that is handled as a single thread pool job
 struct AsyncProgramJob {
-    ProgramExecutor& pe;
-    AsyncProgramJob(ProgramExecutor& pe) : pe(pe) {}
+    ProgramExecutor* const* execs;
+    ulong count;
+    std::atomic_ulong& instructions_executed;
+    bool is_lockstep = false;  // execs are sorted by image and instruction
     void run();
 };
 
 struct ProgramExecutor {
    public:
-    std::vector<Op> _ops = {};
-    ushort& instr_ptr_register;
-    ulong instr_trigger = 0;
+    ProgramImage const* image = nullptr;  // shared - owned by HardwareManager
+    DualRegisters& cpu;  // holds the wait of the last sync instruction
     bool has_executed_async = false;
     bool has_executed_sync = false;
     ulong const& instr_clock;
     ulong max_instruction_per_tick = 0;
-    ThreadPool<AsyncProgramJob>& job_pool;
+    // a MOVE or DIG whose outcome the profile has not counted yet - the
+    // failed flag is set after the sync step and read on the next run
+    ushort sync_address = 0;
+    bool is_sync_pending = false;
+    bool is_registered = false;  // pushed to a HardwareManager
+    // the async run used its whole budget - the sync step is then the last
+    // instruction of the tick and only runs the head of a superinstruction
+    bool is_budget_spent = false;
 
     ProgramExecutor(ulong const& instr_clock, ulong max_instruction_per_tick,
-                    ushort& instr_ptr_register, ThreadPool<AsyncProgramJob>&);
-    ProgramExecutor(const ant_proto::ProgramExecutor& msg,
-                    ulong const& instr_clock, ulong max_instruction_per_tick,
-                    ushort& instr_ptr_register, ThreadPool<AsyncProgramJob>&);
+                    DualRegisters& cpu);
+    // restores the state saved by get_proto - the cpu has to be built
+    void unpack(const ant_proto::ProgramExecutor& msg);
     void reset();
-    void execute_async();
+    bool fits_image() const;
+    void restart();
+    ulong execute_async();  // returns the number of instructions executed
+    bool begin_async();
+    ulong finish_async(ulong executed);
+    // the sync instruction that ends the run counts against the tick budget
+    ulong async_budget() const { return max_instruction_per_tick - 1; }
     void execute();
+    void profile_sync(Instruction const& instr);
     void execute_sync();
     bool is_sync();
+    bool is_halted() const;
+    ulong next_trigger_tick() const;
+    size_t program_size() const;
 
     ant_proto::ProgramExecutor get_proto();
 };
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "hardware/control_flow.hpp"
+#include "hardware/instruction.hpp"
+#include "hardware/jit.hpp"
+#include "hardware/profiler.hpp"
+
+using uchar = unsigned char;
+using ulong = unsigned long;
+
+// The compiled form of one MachineCode. It does not reference any registers so
+// every worker running the same code executes the same image.
+struct ProgramImage {
+    ulong hash = 0;
+    ulong version = 0;  // order the images were added to the manager in
+    std::vector<uchar> code;  // source bytes - used to resolve hash collisions
+    std::vector<Instruction> instructions;
+    std::vector<CountedLoop> loops;  // indexed by the loop jumps
+    // stack depth at each address of the entry frame, -1 elsewhere - see
+    // ImageSwap
+    std::vector<short> entry_depths;
+    bool is_busy = false;  // never reaches a sync instruction or the end
+    std::unique_ptr<JitProgram> jit;  // null when interpreted
+    // null unless the build profiles the programs - see ExecutorProfiler
+    std::unique_ptr<ProgramProfile> profile;
+
+    // Closes the verified instructions with a halt slot. It waits like a sync
+    // instruction so an async run stops at the end of the program without
+    // checking the instruction pointer, and it is never stepped as the
+    // executor is halted once it gets there.
+    void seal() {
+        Instruction halt;
+        halt.num_ticks = 1;
+        instructions.push_back(halt);
+    }
+
+    // without the halt slot
+    size_t size() const { return instructions.size() - 1; }
+};
@@ -1,5 +1,7 @@
 #include "hardware/software_manager.hpp"
 
+#include <algorithm>
+
 #include "spdlog/spdlog.h"
 
 SoftwareManager::SoftwareManager(const ant_proto::SoftwareManager& msg,
@@ -12,6 +14,11 @@ SoftwareManager::SoftwareManager(const ant_proto::SoftwareManager& msg,
 
     for(const auto& ant_code_record : msg.ant_code_records())
         ant_mapping[ant_code_record.ant_idx()] = ant_code_record.code_idx();
+
+    for(ulong code_idx = 0; code_idx < code_list.size(); ++code_idx)
+        code_hashes.emplace(code_list[code_idx]->hash(), code_idx);
+    if(assigned_current)
+        code_hashes.emplace(current_code->hash(), code_list.size());
 }
 
 bool SoftwareManager::has_code() const { return !current_code->is_empty(); }
@@ -41,19 +48,60 @@ void SoftwareManager::get_lines(std::vector<std::string>& lines) {
     }
 }
 
+// The source lines of the current code with the counts of its profile
+void SoftwareManager::get_profile(ProgramProfile const* profile,
+                                  std::vector<ProfileLine>& lines) {
+    Status status;
+    get_profile_lines(parser, *current_code, profile, lines, status);
+    if(status.p_err) {
+        SPDLOG_ERROR("Failed to deparse program - clearing profile lines...");
+        lines.clear();
+    }
+}
+
 MachineCode& SoftwareManager::get() { return *current_code; }
 
 MachineCode& SoftwareManager::operator[](ulong ant_idx) {
-    ulong code_idx = ant_mapping[ant_idx];
+    return code_at(ant_mapping[ant_idx]);
+}
+
+MachineCode& SoftwareManager::code_at(ulong code_idx) {
     return code_idx >= code_list.size() ? *current_code
                                         : *(code_list[code_idx]);
 }
 
+// Every stored code followed by the current one - indexed like code_index
+void SoftwareManager::get_codes(std::vector<MachineCode const*>& codes) const {
+    codes.assign(code_list.begin(), code_list.end());
+    codes.push_back(current_code);
+}
+
+// Index of the ant's code in get_codes. Ants without a code use the current
+// one like operator[] does.
+ulong SoftwareManager::code_index(ulong ant_idx) const {
+    auto it = ant_mapping.find(ant_idx);
+    ulong const code_idx = it == ant_mapping.end() ? 0 : it->second;
+    return std::min<ulong>(code_idx, code_list.size());
+}
+
 void SoftwareManager::assign(ulong ant_idx) {
+    // map to an identical program if there is one so the ants share an image
+    ulong hash = current_code->hash();
+    auto [it, end] = code_hashes.equal_range(hash);
+    for(; it != end; ++it) {
+        if(code_at(it->second).code == current_code->code) {
+            SPDLOG_TRACE("Assigning existing code: {} to ant: {}", it->second,
+                         ant_idx);
+            ant_mapping[ant_idx] = it->second;
+            return;
+        }
+    }
+
     assigned_current = true;
 
     // needs to be called before current is added to the list
     ant_mapping[ant_idx] = code_list.size();
+    code_hashes.emplace(hash, code_list.size());
 }
 
 SoftwareManager::~SoftwareManager() {
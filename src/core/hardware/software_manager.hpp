@@ -1,11 +1,13 @@
 #pragma once
 
+#include <unordered_map>
 #include <vector>
 
 #include "hardware.pb.h"
 #include "hardware/command_config.hpp"
 #include "hardware/machine_code.hpp"
 #include "hardware/parser.hpp"
+#include "hardware/profiler.hpp"
 
 using ulong = unsigned long;
 
@@ -14,6 +16,8 @@ class SoftwareManager {
 
     std::vector<MachineCode*> code_list;
     std::unordered_map<ulong, ulong> ant_mapping;
+    // content hash -> code index - identical programs share one code index
+    std::unordered_multimap<ulong, ulong> code_hashes;
     MachineCode* current_code = new MachineCode();
     bool assigned_current = false;
 
@@ -27,10 +31,15 @@ class SoftwareManager {
     bool has_code() const;
     void add_lines(std::vector<std::string> const& lines);
     void get_lines(std::vector<std::string>& lines);
+    void get_profile(ProgramProfile const* profile,
+                     std::vector<ProfileLine>& lines);
     MachineCode& get();
     MachineCode& operator[](ulong ant_idx);
     void assign(ulong ant_idx);
+    void get_codes(std::vector<MachineCode const*>& codes) const;
+    ulong code_index(ulong ant_idx) const;
 
    private:
     void clear_current();
+    MachineCode& code_at(ulong code_idx);
 };
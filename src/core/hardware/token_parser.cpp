@@ -1,17 +1,35 @@
 #include "hardware/token_parser.hpp"
 
+#include <charconv>
+#include <climits>
+
 #include "spdlog/spdlog.h"
 
 using uchar = unsigned char;
 
-cpu_word_size TokenParser::integer(std::istringstream &ss) {
-    std::string word;
-    ss >> word;
-    return std::stoi(word);
+namespace {
+    // Reads the leading digits of the word like std::stoi - a sign, then
+    // digits up to the first character that is not one. Returns false if
+    // there are no digits or the number does not fit an int.
+    bool parse_int(std::string_view word, long& number) {
+        if(!word.empty() && word[0] == '+') word.remove_prefix(1);
+        auto [end, error] =
+            std::from_chars(word.data(), word.data() + word.size(), number);
+        return error == std::errc() && number >= INT_MIN && number <= INT_MAX;
+    }
+}  // namespace
+
+cpu_word_size TokenParser::integer(Lexer &lexer, Status &status) {
+    long number = 0;
+    if(!parse_int(lexer.word(), number)) {
+        status.error("Expecting an integer argument");
+        return 0;
+    }
+    return number;
 }
-uchar TokenParser::letter_idx(std::istringstream &ss) {
-    uchar firstChar;
-    ss >> firstChar;
+
+uchar TokenParser::letter_idx(Lexer &lexer) {
+    uchar const firstChar = lexer.letter();
 
     if(firstChar >= 'A' && firstChar <= 'Z') {
         SPDLOG_TRACE("Parsed register index: {}", firstChar - 'A');
@@ -26,10 +44,9 @@ uchar TokenParser::letter_idx(std::istringstream &ss) {
     return 0b111;
 }
 
-void TokenParser::direction(std::istringstream &ss, schar &dx, schar &dy,
+void TokenParser::direction(Lexer &lexer, schar &dx, schar &dy,
                             Status &status) {
-    std::string word;
-    ss >> word;
+    std::string_view const word = lexer.word();
 
     if(word == "UP") {
         dy = -1;
@@ -47,39 +64,39 @@ void TokenParser::direction(std::istringstream &ss, schar &dx, schar &dy,
     SPDLOG_DEBUG("Parsed direction from {}: dx: {}, dy: {}", word, dx, dy);
 }
 
-std::string TokenParser::get_label(std::istringstream &ss, Status &status) {
-    std::string word;
-    ss >> word;
-    if(!ss) {
+std::string_view TokenParser::get_label(Lexer &lexer, Status &status) {
+    std::string_view const word = lexer.word();
+    if(word.empty()) {
         status.error("NEED DIRECTION DEFINED FOR JMP COMMAND");
-        return "";
+        return word;
     }
     SPDLOG_DEBUG("Parsed address: {}", word);
     return word;
 }
 
-schar TokenParser::get_signed_byte(std::istringstream &ss, Status &status) {
-    std::string word;
-    ss >> word;
-    if(!ss) {
+schar TokenParser::get_signed_byte(Lexer &lexer, Status &status) {
+    std::string_view const word = lexer.word();
+    long number = 0;
+    if(word.empty()) {
         status.error("Expecting a signed integer argument - none given");
         return 0;
     }
+    if(!parse_int(word, number)) {
+        status.error("Expecting a signed integer argument");
+        return 0;
+    }
 
-    schar number = std::stoi(word);
-    SPDLOG_DEBUG("Parsed number: {}", number);
+    SPDLOG_DEBUG("Parsed number: {}", static_cast<schar>(number));
     return number;
 }
 
-void TokenParser::terminate(std::istringstream &ss, Status &status,
+void TokenParser::terminate(Lexer &lexer, Status &status,
                             std::string const &cmd_name,
-                            std::string const &err_msg) {
-    std::string word;
-    ss >> word;
-    if(ss) {
+                            char const *err_msg) {
+    if(!lexer.word().empty()) {
         status.error(err_msg);
         SPDLOG_ERROR("Additional characters remained: {} - {}", cmd_name,
                      err_msg);
     }
     (void)cmd_name;
-}
\ No newline at end of file
+}
@@ -1,9 +1,10 @@
 #pragma once
 
-#include <sstream>
 #include <string>
+#include <string_view>
 
 #include "app/globals.hpp"
+#include "hardware/lexer.hpp"
 #include "utils/status.hpp"
 
 using uchar = unsigned char;
@@ -14,24 +15,23 @@ struct Status;
 // Parser helpers
 namespace TokenParser {
     // Parse string to integer
-    cpu_word_size integer(std::istringstream& ss);
+    cpu_word_size integer(Lexer& lexer, Status& status);
 
     // Parse register names to an index
     // Register names are single characters A-Z
     // A -> 0
     // B -> 1
     // ...
-    uchar letter_idx(std::istringstream& ss);
+    uchar letter_idx(Lexer& lexer);
 
     // Parse direction keyword to a dx and dy pair
-    void direction(std::istringstream& ss, schar& dx, schar& dy,
-                   Status& status);
+    void direction(Lexer& lexer, schar& dx, schar& dy, Status& status);
 
-    schar get_signed_byte(std::istringstream& ss, Status& status);
+    schar get_signed_byte(Lexer& lexer, Status& status);
 
-    std::string get_label(std::istringstream& ss, Status& status);
+    std::string_view get_label(Lexer& lexer, Status& status);
 
     // Check that no more arguments exist to be parsed.
-    void terminate(std::istringstream& ss, Status& status,
-                   std::string const& cmd_name, std::string const& err_msg);
-}  // namespace TokenParser
\ No newline at end of file
+    void terminate(Lexer& lexer, Status& status, std::string const& cmd_name,
+                   char const* err_msg);
+}  // namespace TokenParser
@@ -0,0 +1,154 @@
+#include "hardware/verifier.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/control_flow.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+    using Program = std::vector<Instruction>;
+
+    // The rules a program is rejected for - named in the status error
+    constexpr char const* rule_fixed_depth =
+        "EVERY PATH REACHES AN INSTRUCTION WITH THE SAME STACK DEPTH - A LOOP "
+        "CAN NOT PUSH OR POP";
+    constexpr char const* rule_no_empty_pop = "NO POP BELOW THE STACK FRAME";
+    constexpr char const* rule_no_recursion = "NO RECURSIVE CALLS";
+    constexpr char const* rule_ret_in_call = "NO RET OUTSIDE OF A CALL";
+
+    // Stack words pushed inside one frame - the code after the entry of the
+    // program or of a called function up to its RET. Every instruction of a
+    // frame must be reached with the same depth, so the depth at each address
+    // is known and loops can not grow the stack.
+    class StackVerifier {
+        static constexpr int UNVISITED = -1;
+
+        struct Frame {
+            bool is_verified = false;
+            bool is_active = false;  // on the current chain of calls
+            ulong peak = 0;          // deepest the stack gets below the frame
+        };
+
+        Program const& program;
+        Status& status;
+        std::vector<Frame> frames;  // keyed by the entry address
+
+       public:
+        // depth at each address of the entry frame, UNVISITED elsewhere
+        std::vector<short> entry_depths;
+
+       private:
+
+        void error(ushort address, char const* rule) {
+            if(status.p_err) return;  // keep the first error
+            std::stringstream err;
+            err << "INSTRUCTION " << address << " BREAKS THE RULE: " << rule;
+            status.error(err.str());
+        }
+
+       public:
+        StackVerifier(Program const& program, Status& status)
+            : program(program), status(status), frames(program.size() + 1) {}
+
+        // Walks the frame starting at entry and returns its peak depth. The
+        // frames of the called functions are verified on their first CALL.
+        ulong verify_frame(ushort entry, bool is_function) {
+            Frame& frame = frames[entry];
+            if(frame.is_verified) return frame.peak;
+            frame.is_active = true;
+
+            ulong peak = 0;
+            std::vector<int> depths(program.size(), UNVISITED);
+            std::vector<ushort> pending;
+            auto reach = [&](ushort address, int depth) {
+                if(address >= program.size()) return;  // the program halts
+                if(depths[address] == UNVISITED) {
+                    depths[address] = depth;
+                    pending.push_back(address);
+                } else if(depths[address] != depth) {
+                    error(address, rule_fixed_depth);
+                }
+            };
+
+            reach(entry, 0);
+            while(!pending.empty() && !status.p_err) {
+                ushort const address = pending.back();
+                pending.pop_back();
+                Instruction const& instr = program[address];
+                int depth = depths[address];
+                switch(instr.command) {
+                    case CommandEnum::PUSH:
+                        peak = std::max<ulong>(peak, ++depth);
+                        break;
+                    case CommandEnum::POP:
+                        if(depth == 0) error(address, rule_no_empty_pop);
+                        --depth;
+                        break;
+                    case CommandEnum::CALL: {
+                        ushort const target = instr.get_target();
+                        if(frames[target].is_active) {
+                            error(address, rule_no_recursion);
+                            break;
+                        }
+                        // the return address and the base pointer
+                        ulong const callee = verify_frame(target, true);
+                        peak = std::max<ulong>(peak, depth + 2 + callee);
+                        break;
+                    }
+                    case CommandEnum::RET:
+                        if(!is_function) error(address, rule_ret_in_call);
+                        continue;
+                    case CommandEnum::JMP:
+                        reach(instr.get_target(), depth);
+                        continue;
+                    case CommandEnum::JNZ:
+                    case CommandEnum::JNF:
+                        reach(instr.get_target(), depth);
+                        break;
+                }
+                reach(address + 1, depth);
+            }
+
+            if(!is_function) entry_depths.assign(depths.begin(), depths.end());
+            frame.is_active = false;
+            frame.is_verified = true;
+            frame.peak = peak;
+            return peak;
+        }
+    };
+}  // namespace
+
+void Verifier::verify(Program const& program, Status& status,
+                      std::vector<short>& entry_depths) {
+    entry_depths.clear();
+    for(size_t i = 0; i < program.size(); ++i) {
+        Instruction const& instr = program[i];
+        if(!is_jump_command(instr.command)) continue;
+        if(instr.get_target() <= program.size()) continue;
+
+        std::stringstream err;
+        err << "INSTRUCTION " << i
+            << " BREAKS THE RULE: JUMPS LAND IN THE PROGRAM - TARGET "
+            << instr.get_target() << " IS PAST THE END";
+        status.error(err.str());
+        return;
+    }
+    if(program.empty()) return;
+
+    StackVerifier verifier(program, status);
+    ulong const peak = verifier.verify_frame(0, false);
+    if(status.p_err) return;
+    if(peak > DualRegisters::ram_size) {
+        std::stringstream err;
+        err << "PROGRAM BREAKS THE RULE: THE STACK FITS THE RAM - IT GROWS TO "
+            << peak << " WORDS AND THE RAM HOLDS " << DualRegisters::ram_size;
+        status.error(err.str());
+        return;
+    }
+    entry_depths = std::move(verifier.entry_depths);
+    SPDLOG_TRACE("Verified program - instructions: {} stack peak: {}",
+                 program.size(), peak);
+}
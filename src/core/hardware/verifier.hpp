@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include "hardware/instruction.hpp"
+#include "utils/status.hpp"
+
+// Load time checks on a decoded program. The ops index the ram through the
+// stack pointer and jump to the decoded addresses without any checks, so
+// every program is verified once here instead of on every instruction.
+namespace Verifier {
+    // Sets an error on the status unless every jump lands on an
+    // instruction or the end of the program, every POP and RET has something
+    // to take off its stack frame, no CALL recurses and the deepest chain of
+    // calls and pushes fits in the ram. The stack depth at each address of
+    // the entry frame - reached from the start without a CALL - is written to
+    // entry_depths, -1 at the other addresses.
+    void verify(std::vector<Instruction> const& program, Status& status,
+                std::vector<short>& entry_depths);
+}  // namespace Verifier
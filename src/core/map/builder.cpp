@@ -5,8 +5,8 @@
 #include "map/section_data.hpp"
 #include "spdlog/spdlog.h"
 
-BspListener::BspListener(MapSectionData &section_data)
-    : section_data(section_data), room_num(0) {
+BspListener::BspListener(MapSectionData &section_data, CounterRandom &random)
+    : section_data(section_data), random(random), room_num(0) {
     SPDLOG_TRACE("BspListener created");
 }
 
@@ -15,11 +15,10 @@ bool BspListener::visitNode(TCODBsp *node, void *user_data) {
     if(!node->isLeaf()) return true;
 
     // dig a room
-    TCODRandom *rng = TCODRandom::getInstance();
-    long w = rng->getInt(ROOM_MIN_SIZE, node->w - 2);
-    long h = rng->getInt(ROOM_MIN_SIZE, node->h - 2);
-    long x = rng->getInt(node->x + 1, node->x + node->w - w - 1);
-    long y = rng->getInt(node->y + 1, node->y + node->h - h - 1);
+    long w = random.get_int(ROOM_MIN_SIZE, node->w - 2);
+    long h = random.get_int(ROOM_MIN_SIZE, node->h - 2);
+    long x = random.get_int(node->x + 1, node->x + node->w - w - 1);
+    long y = random.get_int(node->y + 1, node->y + node->h - h - 1);
 
     SPDLOG_TRACE("Creating room {} at ({}, {}) to ({}, {})", room_num, x, y,
                  x + w - 1, y + h - 1);
@@ -41,7 +40,8 @@ bool BspListener::visitNode(TCODBsp *node, void *user_data) {
     return true;
 }
 
-RandomMapBuilder::RandomMapBuilder(Rect const &border) : border(border) {
+RandomMapBuilder::RandomMapBuilder(Rect const &border, ulong seed, ulong depth)
+    : border(border), seed(seed), depth(depth) {
     // SPDLOG_INFO("Creating RandomMapBuilder");
 }
 
@@ -57,10 +57,18 @@ void RandomMapBuilder::operator()(MapSectionData &section_data) const {
     // this creates the room partitions in our section_data
     int nb = 8;  // max level of recursion -- can make 2^nb rooms.
 
-    // TODO: save seeds by changing from NULL being passed into splitRecursive
-    // to saved seed value
-    bsp.splitRecursive(NULL, nb, ROOM_MAX_SIZE, ROOM_MAX_SIZE, 1.5f, 1.5f);
-    BspListener listener(section_data);
+    // the stream of a section is its top left corner and its depth, so the
+    // sections come out the same whichever order they are built in
+    ulong const stream = static_cast<ulong>(static_cast<uint32_t>(border.x1))
+                             << 32 |
+                         static_cast<uint32_t>(border.y1);
+    CounterRandom random(seed, stream, depth);
+    // the bsp only takes a libtcod generator - seed one from the stream rather
+    // than the shared instance
+    TCODRandom bsp_random(random());
+    bsp.splitRecursive(&bsp_random, nb, ROOM_MAX_SIZE, ROOM_MAX_SIZE, 1.5f,
+                       1.5f);
+    BspListener listener(section_data, random);
     bsp.traverseInvertedLevelOrder(&listener, NULL);
 }
 
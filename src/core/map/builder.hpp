@@ -3,22 +3,26 @@
 #include <libtcod/bsp.hpp>
 
 #include "map/section_data.hpp"
+#include "utils/random.hpp"
 
 class BspListener : public ITCODBspCallback {
    private:
     MapSectionData &section_data;  // a section_data to dig
+    CounterRandom &random;         // the stream of the section
     int room_num = 0;              // room number
     int lastx = 0, lasty = 0;      // center of the last room
 
    public:
-    BspListener(MapSectionData &section_data);
+    BspListener(MapSectionData &section_data, CounterRandom &random);
 
     bool visitNode(TCODBsp *node, void *user_data);
 };
 
 struct RandomMapBuilder {
     Rect border;
-    RandomMapBuilder(Rect const &border);
+    ulong seed;
+    ulong depth;
+    RandomMapBuilder(Rect const &border, ulong seed, ulong depth);
     void operator()(MapSectionData &section_data) const;
 };
 
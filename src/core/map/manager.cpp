@@ -30,6 +30,7 @@ bool MapManager::update_current_level(const EntityData& d) {
     cur_map.needs_update = false;
 
     map_window.set_center(d.x, d.y);
+    cur_map.prefetch(map_window.border);
     set_window_tiles();
     cur_map.update_chunks(map_window.border);
 
@@ -1,5 +1,8 @@
 #include "map/map.hpp"
 
+#include <algorithm>
+#include <utility>
+
 #include "app/globals.hpp"
 #include "spdlog/spdlog.h"
 #include "utils/math.hpp"
@@ -7,80 +10,114 @@
 using ulong = unsigned long;
 
 Chunk::Chunk(long x, long y, bool update_parity)
-    : x(x),
-      y(y),
-      update_parity(update_parity),
-      tiles(globals::CHUNK_AREA, Tile()) {}
+    : x(x), y(y), update_parity(update_parity) {}
 
 Chunk::Chunk(const ant_proto::Chunk& msg)
-    : x(msg.x()), y(msg.y()), update_parity(msg.update_parity()), tiles() {
-    tiles.reserve(globals::CHUNK_AREA);
-    ulong is_explored = msg.is_explored(), in_fov = msg.in_fov(),
-          is_wall = msg.is_wall();
-    for(ulong i = 0; i < globals::CHUNK_AREA; ++i) {
-        tiles.emplace_back((is_explored >> i) & 1UL, (in_fov >> i) & 1UL,
-                           (is_wall >> i) & 1UL);
-    }
-}
+    : x(msg.x()),
+      y(msg.y()),
+      update_parity(msg.update_parity()),
+      is_explored(msg.is_explored()),
+      in_fov(msg.in_fov()),
+      is_wall(msg.is_wall()) {}
 
-Tile& Chunk::operator[](long idx) {
-    if(idx < 0 || idx >= globals::CHUNK_AREA)
-        SPDLOG_ERROR("Invalid tile idx: {}", idx);
+ulong& Chunk::get_scents(long idx) {
+    if(!scents) scents = std::make_unique<Plane<ulong>::element_type>();
+    return (*scents)[idx];
+}
 
-    return tiles[idx];
+void Chunk::set_entity(long idx, MapEntity* entity) {
+    if(entity == nullptr) {
+        is_occupied &= ~bit(idx);
+        return;
+    }
+    if(!entities)
+        entities = std::make_unique<Plane<MapEntity*>::element_type>();
+    (*entities)[idx] = entity;
+    is_occupied |= bit(idx);
 }
 
-Tile const& Chunk::operator[](long idx) const { return tiles[idx]; }
+void Chunk::set_building(long idx, Building* building) {
+    if(!buildings)
+        buildings = std::make_unique<Plane<Building*>::element_type>();
+    (*buildings)[idx] = building;
+}
 
-ant_proto::Chunk Chunk::get_proto() {
+ant_proto::Chunk Chunk::get_proto() const {
     ant_proto::Chunk msg;
     msg.set_x(x);
     msg.set_y(y);
     msg.set_update_parity(update_parity);
-
-    ulong is_explored = 0, in_fov = 0, is_wall = 0;
-    for(ulong i = 0; i < globals::CHUNK_AREA; ++i) {
-        Tile const& tile = (*this)[i];
-        is_explored |= ((tile.is_explored & 1UL) << i);
-        in_fov |= ((tile.in_fov & 1UL) << i);
-        is_wall |= ((tile.is_wall & 1UL) << i);
-    }
-    // SPDLOG_TRACE("Packing chunk - x: {} y: {} update: {} explored: {:x} fov:
-    // {:x} walls: {:x}", obj.x, obj.y, obj.update_parity, is_explored, in_fov,
-    // is_wall);
-
     msg.set_is_explored(is_explored);
     msg.set_in_fov(in_fov);
     msg.set_is_wall(is_wall);
-
     return msg;
 }
 
-Chunks::tile_iterator& Chunks::tile_iterator::operator++() {
-    ++tile_idx;
-    // SPDLOG_TRACE("Incrementing tile iterator: {}", tile_idx);
-    if(tile_idx >= get_tiles().size()) {
-        ++map_it;
-        tile_idx = 0;
+Chunk* ChunkPool::allocate() {
+    if(!free_chunks.empty()) {
+        Chunk* chunk = free_chunks.back();
+        free_chunks.pop_back();
+        return chunk;
     }
-    return *this;
-}
-
-Tile& Chunks::tile_iterator::operator*() { return get_tiles()[tile_idx]; }
-
-bool Chunks::tile_iterator::operator!=(Chunks::tile_iterator const& other) {
-    return map_it != other.map_it || (tile_idx != other.tile_idx);
+    if(slab_used == SLAB_SIZE) {
+        SPDLOG_DEBUG("Allocating chunk slab - capacity: {}",
+                     capacity() + SLAB_SIZE);
+        slabs.push_back(std::make_unique<Chunk[]>(SLAB_SIZE));
+        slab_used = 0;
+    }
+    return &slabs.back()[slab_used++];
 }
 
-Chunks::tile_iterator::TileVector& Chunks::tile_iterator::get_tiles() {
-    return map_it->second->tiles;
+void ChunkPool::release(Chunk* chunk) {
+    *chunk = Chunk();  // frees the planes
+    free_chunks.push_back(chunk);
 }
 
 Chunks::Chunks(const ant_proto::Chunks& msg) {
     for(const auto& chunk_key_val : msg.chunk_key_vals()) {
         SPDLOG_TRACE("unpacking chunk {}", chunk_key_val.key());
-        Chunk* chunk = new Chunk(chunk_key_val.val());
-        emplace(chunk_key_val.key(), chunk);
+        emplace(chunk_key_val.key()) = Chunk(chunk_key_val.val());
+    }
+}
+
+Chunk& Chunks::emplace(ulong chunk_id) {
+    if(2 * (count + 1) > slots.size()) grow();
+    Chunk* chunk = pool.allocate();
+    insert(chunk_id, chunk);
+    ++count;
+    return *chunk;
+}
+
+void Chunks::insert(ulong chunk_id, Chunk* chunk) {
+    ulong i = chunk_id & mask();
+    while(slots[i].chunk != nullptr) i = (i + 1) & mask();
+    slots[i] = {chunk_id, chunk};
+}
+
+void Chunks::erase(ulong slot_idx) {
+    pool.release(slots[slot_idx].chunk);
+    --count;
+
+    // move back every later slot of the run that may live in the hole
+    ulong hole = slot_idx;
+    for(ulong i = (hole + 1) & mask(); slots[i].chunk != nullptr;
+        i = (i + 1) & mask()) {
+        ulong home = slots[i].id & mask();
+        // distance from home to i is at least the distance from home to hole
+        if(((i - home) & mask()) >= ((i - hole) & mask())) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole] = {};
+}
+
+void Chunks::grow() {
+    std::vector<Slot> old_slots(std::max(2 * slots.size(), MIN_SLOTS));
+    old_slots.swap(slots);
+    SPDLOG_DEBUG("Growing chunk table - slots: {}", slots.size());
+    for(Slot const& slot : old_slots) {
+        if(slot.chunk != nullptr) insert(slot.id, slot.chunk);
     }
 }
 
@@ -119,10 +156,10 @@ std::vector<ChunkMarker> Chunks::get_chunk_markers(const Rect& rect) const {
 
 ant_proto::Chunks Chunks::get_proto() const {
     ant_proto::Chunks msg;
-    for(const auto& chunk : chunks) {
+    for(const Slot& chunk : *this) {
         ant_proto::ChunkKeyVal kv_msg;
-        kv_msg.set_key(chunk.first);
-        *kv_msg.mutable_val() = chunk.second->get_proto();
+        kv_msg.set_key(chunk.id);
+        *kv_msg.mutable_val() = chunk.chunk->get_proto();
         *msg.add_chunk_key_vals() = kv_msg;
     }
     return msg;
@@ -180,89 +217,168 @@ void Map::dig(long x1, long y1, long x2, long y2) {
     if(y2 < y1) std::swap(y1, y2);
     SPDLOG_TRACE("Digging from ({}, {}) to ({}, {})", x1, y1, x2, y2);
 
-    for(int tx = x1; tx <= x2; ++tx) {
-        for(int ty = y1; ty <= y2; ++ty) {
-            get_tile(tx, ty).is_wall = false;
+    // clear the overlap with each chunk as one mask - the chunks are visited
+    // column by column so they are created in the same order as tile by tile
+    for(long cx = chunks.align(x1); cx <= x2; cx += globals::CHUNK_LENGTH) {
+        long lx1 = std::max(x1, cx) - cx;
+        long lx2 = std::min(x2, cx + globals::CHUNK_LENGTH - 1) - cx;
+        ulong row_mask = ((2UL << (lx2 - lx1)) - 1) << lx1;
+        for(long cy = chunks.align(y1); cy <= y2; cy += globals::CHUNK_LENGTH) {
+            long ly1 = std::max(y1, cy) - cy;
+            long ly2 = std::min(y2, cy + globals::CHUNK_LENGTH - 1) - cy;
+            ulong mask = 0;
+            for(long ly = ly1; ly <= ly2; ++ly)
+                mask |= row_mask << (ly * globals::CHUNK_LENGTH);
+            get_chunk(cx, cy).is_wall &= ~mask;
         }
     }
     SPDLOG_TRACE("Digging complete");
 }
 
+TileStencil::TileStencil(Map& map, long x, long y)
+    : map(map), chunk_x(map.chunks.align(x)), chunk_y(map.chunks.align(y)) {}
+
+Chunk& TileStencil::get_chunk(long x, long y) {
+    long const length = globals::CHUNK_LENGTH;
+    ulong const sx = (x - chunk_x + length) / length;
+    ulong const sy = (y - chunk_y + length) / length;
+    if(x < chunk_x - length || sx > 2 || y < chunk_y - length || sy > 2)
+        return map.get_chunk(x, y);  // outside of the stencil
+    Chunk*& chunk = chunks[sy * 3 + sx];
+    if(chunk == nullptr) chunk = &map.get_chunk(x, y);
+    return *chunk;
+}
+
+void TileStencil::resolve(long x, long y, long radius) {
+    // the square spans at most two chunks a side so its corners reach every
+    // chunk under it - visited column by column like Map::prefetch
+    get_chunk(x - radius, y - radius);
+    get_chunk(x - radius, y + radius);
+    get_chunk(x + radius, y - radius);
+    get_chunk(x + radius, y + radius);
+}
+
 bool Map::can_place(long x, long y) {
-    Tile const& tile = get_tile(x, y);
-    if(tile.is_wall) return false;
-    if(tile.entity != nullptr) {
-        tile.entity->request_move();
-        return tile.entity == nullptr;
-    }
-    return true;
+    TileStencil stencil(*this, x, y);
+    return can_place(stencil, x, y);
 }
 
-void Map::add_entity_wo_events(MapEntity& entity) {
-    EntityData& data = entity.get_data();
-    set_entity(data.x, data.y, &entity);
+bool Map::can_place(TileStencil& stencil, long x, long y) {
+    Chunk& chunk = stencil.get_chunk(x, y);
+    long idx = get_local_idx(chunk, x, y);
+    return !((chunk.is_wall | chunk.is_occupied) & Chunk::bit(idx));
 }
 
 void Map::add_entity(MapEntity& entity) {
-    add_entity_wo_events(entity);
-
-    // notify that the entity was successfully moved
-    auto entity_data = entity.get_data();
-    notify_all_moved_entity(entity_data.x, entity_data.y, entity);
+    EntityData& data = entity.get_data();
+    TileStencil stencil(*this, data.x, data.y);
+    set_entity(stencil, data.x, data.y, &entity);
+    needs_update = true;
 }
 
 void Map::remove_entity(MapEntity& entity) {
     SPDLOG_TRACE("Removing entity");
     EntityData& data = entity.get_data();
-    set_entity(data.x, data.y, nullptr);
+    TileStencil stencil(*this, data.x, data.y);
+    set_entity(stencil, data.x, data.y, nullptr);
+    needs_update = true;
+}
+
+TileStencil Map::get_stencil(MapEntity& entity) {
+    EntityData& data = entity.get_data();
+    return TileStencil(*this, data.x, data.y);
 }
 
 bool Map::move_entity(MapEntity& entity, long dx, long dy) {
     SPDLOG_DEBUG("Moving entity by - dx: {} dy: {}", dx, dy);
+    TileStencil stencil = get_stencil(entity);
+    needs_update = true;
+    announce_move(stencil, entity, dx, dy);
+
     EntityData& data = entity.get_data();
     long x = data.x, y = data.y;
+    long new_x = x + dx, new_y = y + dy;
+    SPDLOG_TRACE("Moving entity - new x: {} new y: {}", new_x, new_y);
+
+    if(is_walls_enabled && !can_place(stencil, new_x, new_y)) {
+        SPDLOG_TRACE("Cannot move entity to ({}, {})", new_x, new_y);
+        return false;
+    }
+
+    set_entity(stencil, x, y, nullptr);
+    data.x = new_x;
+    data.y = new_y;
+    set_entity(stencil, new_x, new_y, &entity);
+
+    SPDLOG_TRACE("Successfully moved the entity");
+    return true;
+}
 
+void Map::announce_move(TileStencil& stencil, MapEntity& entity, long dx,
+                        long dy) {
+    EntityData& data = entity.get_data();
+    long x = data.x, y = data.y;
     long new_x = x + dx, new_y = y + dy;
 
     SPDLOG_TRACE("Calling entity move callback");
-    ulong right_scents = get_tile(new_x + 1, new_y).scents;
-    ulong up_scents = get_tile(new_x, new_y - 1).scents;
-    ulong left_scents = get_tile(new_x - 1, new_y).scents;
-    ulong down_scents = get_tile(new_x, new_y + 1).scents;
+    // moving into a tile generates the chunks around it
+    auto neighbour_scents = [&stencil](long x, long y) {
+        Chunk const& chunk = stencil.get_chunk(x, y);
+        return chunk.get_scents(TileStencil::get_local_idx(chunk, x, y));
+    };
+    ulong right_scents = neighbour_scents(new_x + 1, new_y);
+    ulong up_scents = neighbour_scents(new_x, new_y - 1);
+    ulong left_scents = neighbour_scents(new_x - 1, new_y);
+    ulong down_scents = neighbour_scents(new_x, new_y + 1);
 
     entity.move_callback({x,
                           y,
                           new_x,
                           new_y,
                           {right_scents, up_scents, left_scents, down_scents}});
+}
 
-    SPDLOG_TRACE("Moving entity - new x: {} new y: {}", new_x, new_y);
-
-    // remove entity from map so another entity can take its place if needed
-    remove_entity(entity);
-    if(is_walls_enabled && !can_place(new_x, new_y)) {
-        SPDLOG_TRACE("Cannot move entity to ({}, {})", new_x, new_y);
-
-        // unable to move the obstacle so move the entity back
-        add_entity_wo_events(entity);
-        return false;
+void Map::move_entities(MoveIntent* intents, ulong count) {
+    SPDLOG_TRACE("Settling {} move intents", count);
+    move_states.assign(count, MOVE_BLOCKED);
+    for(ulong i = 0; i < count; ++i) {
+        if(!intents[i].is_move) continue;
+        needs_update = true;
+        move_states[i] = MOVE_PENDING;
+    }
+    if(is_walls_enabled) {
+        settle_moves(intents, count);
+    } else {
+        // nothing blocks so every entity takes its step
+        for(uchar& state : move_states) {
+            if(state == MOVE_PENDING) state = MOVED;
+        }
     }
 
-    // notify that the entity was successfully removed
-    notify_all_removed_entity(x, y);
-
-    data.x = new_x;
-    data.y = new_y;
-    add_entity(entity);
-
-    // notify that the entity was successfully moved
-    notify_all_moved_entity(new_x, new_y, entity);
-
-    SPDLOG_TRACE("Successfully moved the entity");
-    return true;
+    // every mover leaves before any arrives so the chains and cycles land
+    for(ulong i = 0; i < count; ++i) {
+        intents[i].is_moved = move_states[i] == MOVED;
+        if(!intents[i].is_moved) continue;
+        EntityData& data = intents[i].entity->get_data();
+        TileStencil stencil(*this, data.x, data.y);
+        set_entity(stencil, data.x, data.y, nullptr);
+    }
+    for(ulong i = 0; i < count; ++i) {
+        if(!intents[i].is_moved) continue;
+        EntityData& data = intents[i].entity->get_data();
+        TileStencil stencil(*this, data.x, data.y);
+        data.x += intents[i].dx;
+        data.y += intents[i].dy;
+        set_entity(stencil, data.x, data.y, intents[i].entity);
+    }
 }
 
 bool Map::dig(MapEntity& entity, long dx, long dy) {
+    TileStencil stencil = get_stencil(entity);
+    return dig(stencil, entity, dx, dy);
+}
+
+bool Map::dig(TileStencil& stencil, MapEntity& entity, long dx, long dy) {
     SPDLOG_DEBUG("Entity is digging - dx: {} dy: {}", dx, dy);
     EntityData& data = entity.get_data();
     long x = data.x, y = data.y;
@@ -270,13 +386,14 @@ bool Map::dig(MapEntity& entity, long dx, long dy) {
     long new_x = x + dx, new_y = y + dy;
     SPDLOG_TRACE("Entity digging - new x: {} new y: {}", new_x, new_y);
 
-    Tile& tile = get_tile(new_x, new_y);
-    if(!tile.is_wall) {
+    Chunk& chunk = stencil.get_chunk(new_x, new_y);
+    ulong bit = Chunk::bit(get_local_idx(chunk, new_x, new_y));
+    if(!(chunk.is_wall & bit)) {
         SPDLOG_TRACE("Failed to dig at non-wall position");
         return false;
     }
 
-    tile.is_wall = false;
+    chunk.is_wall &= ~bit;
     SPDLOG_TRACE("Entity successfully dug at - x: {} y: {}", new_x, new_y);
     return true;
 }
@@ -284,34 +401,19 @@ bool Map::dig(MapEntity& entity, long dx, long dy) {
 void Map::add_building(Building& building) {
     for(long x = building.border.x1; x <= building.border.x2; ++x) {
         for(long y = building.border.y1; y <= building.border.y2; ++y) {
-            get_tile(x, y).building = &building;
+            Chunk& chunk = get_chunk(x, y);
+            chunk.set_building(get_local_idx(chunk, x, y), &building);
         }
     }
 }
 
 Building* Map::get_building(MapEntity& entity) {
     EntityData& data = entity.get_data();
-    return get_tile(data.x, data.y).building;
+    Chunk& chunk = get_chunk(data.x, data.y);
+    return chunk.get_building(get_local_idx(chunk, data.x, data.y));
 }
 
-void Map::create_chunk(long x, long y) {
-    ulong const chunk_id = chunks.get_chunk_id(x, y);
-    auto it = chunks.find(chunk_id);
-    if(it != chunks.end()) {
-        Chunk& chunk = *it->second;
-        chunk.update_parity = chunk_update_parity;
-        return;
-    }
-
-    long aligned_x = chunks.align(x), aligned_y = chunks.align(y);
-
-    SPDLOG_DEBUG("Adding chunk ({}, {}) - id: {}", x, y, chunk_id);
-    chunks.emplace(chunk_id,
-                   new Chunk(aligned_x, aligned_y, chunk_update_parity));
-
-    // create chunk
-    generate_chunk_callback(x, y);
-}
+void Map::create_chunk(long x, long y) { get_chunk(x, y); }
 
 std::vector<ChunkMarker> Map::get_chunk_markers(const Rect& rect) const {
     return chunks.get_chunk_markers(rect);
@@ -319,15 +421,10 @@ std::vector<ChunkMarker> Map::get_chunk_markers(const Rect& rect) const {
 
 void Map::remove_unused_chunks() {
     SPDLOG_TRACE("Removing unused chunks");
-    for(auto it = chunks.begin(); it != chunks.end();) {
-        Chunk& chunk = *it->second;
-        if(chunk.update_parity == chunk_update_parity) {
-            ++it;
-            continue;
-        }
-
-        chunks.erase(it++);
-    }
+    last_chunk = nullptr;
+    chunks.erase_if([this](Chunk const& chunk) {
+        return chunk.update_parity != chunk_update_parity;
+    });
     SPDLOG_TRACE("Finished removing unused chunks");
 }
 
@@ -339,63 +436,155 @@ void Map::update_chunks(Rect const& rect) {
 }
 
 void Map::reset_fov() {
-    for(auto it = chunks.begin_tile(); it != chunks.end_tile(); ++it) {
-        Tile& tile = *it;
-        tile.in_fov = false;
-    }
+    for(auto& [chunk_id, chunk] : chunks) chunk->in_fov = 0;
 }
 
 void Map::reset_tile(long x, long y) {
-    Tile& tile = get_tile(x, y);
-    tile.in_fov = false;
+    Chunk& chunk = get_chunk(x, y);
+    chunk.in_fov &= ~Chunk::bit(get_local_idx(chunk, x, y));
 }
 
 void Map::explore(long x, long y) {
-    Tile& tile = get_tile(x, y);
-    tile.is_explored = true;
-    tile.in_fov = true;
+    Chunk& chunk = get_chunk(x, y);
+    ulong bit = Chunk::bit(get_local_idx(chunk, x, y));
+    chunk.is_explored |= bit;
+    chunk.in_fov |= bit;
 }
 
 bool Map::chunk_built(const ChunkMarker& cm) const {
-    auto c_itr = chunks.find(cm.id);
-    if(c_itr == chunks.end()) return false;
-    return c_itr->second->section_loaded;
+    Chunk const* chunk = chunks.find(cm.id);
+    return chunk != nullptr && chunk->section_loaded;
 }
 
 bool Map::chunk_built(long x, long y) const {
-    ulong id = chunks.get_chunk_id(x, y);
-    auto c_itr = chunks.find(id);
-    if(c_itr == chunks.end()) return false;
-    return c_itr->second->section_loaded;
+    Chunk const* chunk = chunks.find(chunks.get_chunk_id(x, y));
+    return chunk != nullptr && chunk->section_loaded;
 }
 
-bool Map::in_fov(long x, long y) {
-    // SPDLOG_TRACE("Checking if tile at ({}, {}) is in fov", x, y);
+void Map::prefetch(Rect const& rect) {
+    // same chunk order as visiting the tiles column by column
+    for(long x = chunks.align(rect.x1); x <= rect.x2;
+        x += globals::CHUNK_LENGTH) {
+        for(long y = chunks.align(rect.y1); y <= rect.y2;
+            y += globals::CHUNK_LENGTH) {
+            get_chunk(std::max(x, rect.x1), std::max(y, rect.y1));
+        }
+    }
+}
 
-    return get_tile(x, y).in_fov;
+bool Map::in_fov(long x, long y) const {
+    // SPDLOG_TRACE("Checking if tile at ({}, {}) is in fov", x, y);
+    Chunk const* chunk = find_chunk(x, y);
+    if(chunk == nullptr) return false;
+    return (chunk->in_fov >> get_local_idx(*chunk, x, y)) & 1;
 }
 
-bool Map::is_explored(long x, long y) {
+bool Map::is_explored(long x, long y) const {
     // SPDLOG_TRACE("Checking if tile at ({}, {}) is explored", x, y);
-    return get_tile(x, y).is_explored;
-}
+    Chunk const* chunk = find_chunk(x, y);
+    if(chunk == nullptr) return false;
+    return (chunk->is_explored >> get_local_idx(*chunk, x, y)) & 1;
+}
+
+bool Map::is_wall(long x, long y) const {
+    Chunk const* chunk = find_chunk(x, y);
+    if(chunk == nullptr) return true;
+    return (chunk->is_wall >> get_local_idx(*chunk, x, y)) & 1;
+}
+
+uchar Map::empty_neighbours(long x, long y) const {
+    long const length = globals::CHUNK_LENGTH;
+    // without walls only the entities block a move
+    ulong const wall_mask = is_walls_enabled ? ~0UL : 0;
+    Chunk const* chunk = find_chunk(x, y);
+    if(chunk != nullptr && x > chunk->x && x < chunk->x + length - 1 &&
+       y > chunk->y && y < chunk->y + length - 1) {
+        // every neighbour is in the chunk of the tile
+        ulong const empty =
+            ~((chunk->is_wall & wall_mask) | chunk->is_occupied);
+        long const idx = get_local_idx(*chunk, x, y);
+        return ((empty >> (idx + 1)) & 1) |
+               ((empty >> (idx - length)) & 1) << 1 |
+               ((empty >> (idx - 1)) & 1) << 2 |
+               ((empty >> (idx + length)) & 1) << 3;
+    }
 
-bool Map::is_wall(long x, long y) { return get_tile(x, y).is_wall; }
+    auto is_empty = [this, wall_mask](long x, long y) -> uchar {
+        Chunk const* chunk = find_chunk(x, y);
+        // not generated yet - a wall, and empty space without walls
+        if(chunk == nullptr) return !is_walls_enabled;
+        ulong const full = (chunk->is_wall & wall_mask) | chunk->is_occupied;
+        return !((full >> get_local_idx(*chunk, x, y)) & 1);
+    };
+    return is_empty(x + 1, y) | is_empty(x, y - 1) << 1 |
+           is_empty(x - 1, y) << 2 | is_empty(x, y + 1) << 3;
+}
 
 bool Map::click(long x, long y) {
-    MapEntity* entity = get_tile(x, y).entity;
+    Chunk& chunk = get_chunk(x, y);
+    MapEntity* entity = chunk.get_entity(get_local_idx(chunk, x, y));
     if(entity == nullptr) return false;
     entity->click_callback(x, y);
     return true;
 }
 
 ulong& Map::get_tile_scents(MapEntity& entity) {
+    TileStencil stencil = get_stencil(entity);
+    return get_tile_scents(stencil, entity);
+}
+
+ulong& Map::get_tile_scents(TileStencil& stencil, MapEntity& entity) {
     EntityData& data = entity.get_data();
-    return get_tile(data.x, data.y).scents;
+    Chunk& chunk = stencil.get_chunk(data.x, data.y);
+    return chunk.get_scents(get_local_idx(chunk, data.x, data.y));
 }
 
-ulong Map::get_tile_scents_by_coord(long x, long y) {
-    return get_tile(x, y).scents;
+ulong Map::get_tile_scents_by_coord(long x, long y) const {
+    Chunk const* chunk = find_chunk(x, y);
+    if(chunk == nullptr) return 0;
+    return chunk->get_scents(get_local_idx(*chunk, x, y));
+}
+
+void Map::update_scents(ulong tick) {
+    scent_updates.clear();
+    for(auto& slot : chunks) {
+        if(slot.chunk->scents) scent_updates.push_back({slot.chunk});
+    }
+
+    // scent that crosses into a chunk without any gives it an empty plane
+    ulong const num_scented = scent_updates.size();
+    for(ulong i = 0; i < num_scented; ++i) {
+        Chunk const& chunk = *scent_updates[i].chunk;
+        for(auto side : {ScentField::RIGHT, ScentField::UP, ScentField::LEFT,
+                         ScentField::DOWN}) {
+            Chunk* neighbour = find_neighbour(chunk, side);
+            if(neighbour == nullptr || neighbour->scents) continue;
+            if(!ScentField::spreads(*chunk.scents, side)) continue;
+            neighbour->scents = std::make_unique<ScentField::Plane>();
+            scent_updates.push_back({neighbour});
+        }
+    }
+
+    bool const is_evaporating = tick % ScentField::EVAPORATION_TICKS == 0;
+    for(ScentUpdate& update : scent_updates) {
+        ScentField::Neighbours neighbours;
+        for(ulong side = 0; side < neighbours.planes.size(); ++side) {
+            Chunk const* neighbour = find_neighbour(
+                *update.chunk, static_cast<ScentField::Side>(side));
+            if(neighbour) neighbours.planes[side] = neighbour->scents.get();
+        }
+        update.is_live = ScentField::step(*update.chunk->scents, neighbours,
+                                          is_evaporating, update.plane);
+    }
+
+    for(ScentUpdate& update : scent_updates) {
+        if(update.is_live) {
+            *update.chunk->scents = update.plane;
+        } else {
+            update.chunk->scents.reset();
+        }
+    }
+    if(!scent_updates.empty()) needs_update = true;
 }
 
 ant_proto::Map Map::get_proto() const {
@@ -406,73 +595,124 @@ ant_proto::Map Map::get_proto() const {
     return msg;
 }
 
-Chunk& Map::get_chunk(long x, long y) {
-    create_chunk(x, y);
-    return chunks[{x, y}];
-}
-
-Chunk const& Map::get_chunk_const(long x, long y) const {
-    return chunks.at(chunks.get_chunk_id(x, y));
+Chunk* Map::find_neighbour(Chunk const& chunk, ScentField::Side side) const {
+    long const length = globals::CHUNK_LENGTH;
+    switch(side) {
+        case ScentField::RIGHT:
+            return chunks.find(chunks.get_chunk_id(chunk.x + length, chunk.y));
+        case ScentField::UP:
+            return chunks.find(chunks.get_chunk_id(chunk.x, chunk.y - length));
+        case ScentField::LEFT:
+            return chunks.find(chunks.get_chunk_id(chunk.x - length, chunk.y));
+        case ScentField::DOWN:
+            return chunks.find(chunks.get_chunk_id(chunk.x, chunk.y + length));
+    }
+    return nullptr;
 }
 
-long Map::get_local_idx(long chunk_x, long chunk_y, long x, long y) const {
-    long local_idx = (x - chunk_x) + (y - chunk_y) * globals::CHUNK_LENGTH;
-    // SPDLOG_TRACE("Local index for tile ({}, {}) is {}", x, y, local_idx);
-    return local_idx;
-}
+Chunk& Map::get_chunk(long x, long y) {
+    // neighbouring lookups mostly land in the chunk of the previous one
+    if(last_chunk != nullptr &&
+       static_cast<ulong>(x - last_chunk->x) < globals::CHUNK_LENGTH &&
+       static_cast<ulong>(y - last_chunk->y) < globals::CHUNK_LENGTH) {
+        last_chunk->update_parity = chunk_update_parity;
+        return *last_chunk;
+    }
 
-Tile& Map::get_tile(long x, long y) {
-    Chunk& chunk = get_chunk(x, y);
-    return chunk[get_local_idx(chunk.x, chunk.y, x, y)];
-}
+    ulong const chunk_id = chunks.get_chunk_id(x, y);
+    Chunk* chunk = chunks.find(chunk_id);
+    if(chunk != nullptr) {
+        chunk->update_parity = chunk_update_parity;
+        last_chunk = chunk;
+        return *chunk;
+    }
 
-// Tile const& Map::get_tile(long x, long y) {
-//     // Chunk const& chunk = get_chunk_const(x, y);
-//     // return chunk[get_local_idx(chunk.x, chunk.y, x, y)];
-//     const Chunk& chunk = get_chunk(x, y);
-//     return chunk[get_local_idx(chunk.x, chunk.y, x, y)];
-// }
+    SPDLOG_DEBUG("Adding chunk ({}, {}) - id: {}", x, y, chunk_id);
+    Chunk& new_chunk = chunks.emplace(chunk_id);
+    new_chunk = Chunk(chunks.align(x), chunks.align(y), chunk_update_parity);
 
-uchar Map::flip_direction_bits(uchar bits) {
-    // DLUR -> URDL
-    return ((bits >> 2) | (bits << 2)) & 0b1111;
+    // the pool keeps the chunk in place while the callback adds more chunks
+    generate_chunk_callback(x, y);
+    return new_chunk;
 }
 
-void Map::notify_removed_entity(long x, long y, uchar bits) {
-    MapEntity* entity = get_tile(x, y).entity;
-    if(entity == nullptr) return;
-    entity->handle_empty_space(bits);
-}
+void Map::settle_moves(MoveIntent* intents, ulong count) {
+    auto target = [intents](ulong i) {
+        EntityData& data = intents[i].entity->get_data();
+        return std::pair{data.x + intents[i].dx, data.y + intents[i].dy};
+    };
 
-void Map::notify_moved_entity(MapEntity& source, long x, long y, uchar bits) {
-    uchar source_bits = flip_direction_bits(bits);
-    if(can_place(x, y)) {
-        source.handle_empty_space(source_bits);
-        return;
+    // every tile a mover leaves or steps onto, with the winner of the tile
+    tile_moves.clear();
+    for(ulong i = 0; i < count; ++i) {
+        if(move_states[i] != MOVE_PENDING) continue;
+        EntityData& data = intents[i].entity->get_data();
+        tile_moves[tile_key(data.x, data.y)].leaving = i;
+    }
+    for(ulong i = 0; i < count; ++i) {
+        if(move_states[i] != MOVE_PENDING) continue;
+        auto [x, y] = target(i);
+        Chunk& chunk = get_chunk(x, y);
+        if(chunk.is_wall & Chunk::bit(get_local_idx(chunk, x, y))) {
+            move_states[i] = MOVE_BLOCKED;
+            continue;
+        }
+        ulong& claimant = tile_moves[tile_key(x, y)].claimant;
+        if(claimant == NO_MOVER) {
+            claimant = i;
+        } else if(intents[i].priority < intents[claimant].priority) {
+            move_states[claimant] = MOVE_BLOCKED;
+            claimant = i;
+        } else {
+            move_states[i] = MOVE_BLOCKED;
+        }
     }
-    source.handle_full_space(source_bits);
-
-    MapEntity* entity = get_tile(x, y).entity;
-    if(entity == nullptr) return;
-    entity->handle_full_space(bits);
-}
 
-void Map::set_entity(long x, long y, MapEntity* entity) {
-    SPDLOG_DEBUG("Setting entity at ({}, {})", x, y);
-    get_tile(x, y).entity = entity;
-    needs_update = true;
+    // Each tile has one claimant so the movers form chains that end on a free
+    // or blocked tile, or close into a cycle. A chain is followed once and
+    // every mover on it shares its outcome.
+    for(ulong i = 0; i < count; ++i) {
+        if(move_states[i] != MOVE_PENDING) continue;
+        move_chain.clear();
+        ulong next = i;
+        uchar outcome;
+        while(true) {
+            if(move_states[next] == MOVE_VISITING) {
+                // two entities swapping would pass through each other
+                ulong const length =
+                    move_chain.end() -
+                    std::find(move_chain.begin(), move_chain.end(), next);
+                outcome = length > 2 ? MOVED : MOVE_BLOCKED;
+                break;
+            }
+            if(move_states[next] != MOVE_PENDING) {
+                outcome = move_states[next];
+                break;
+            }
+            move_states[next] = MOVE_VISITING;
+            move_chain.push_back(next);
+
+            auto [x, y] = target(next);
+            next = tile_moves.at(tile_key(x, y)).leaving;
+            if(next == NO_MOVER) {
+                Chunk& chunk = get_chunk(x, y);
+                ulong const bit = Chunk::bit(get_local_idx(chunk, x, y));
+                outcome = chunk.is_occupied & bit ? MOVE_BLOCKED : MOVED;
+                break;
+            }
+        }
+        for(ulong mover : move_chain) move_states[mover] = outcome;
+    }
 }
 
-void Map::notify_all_removed_entity(long x, long y) {
-    notify_removed_entity(x - 1, y, 0b0001);  // right
-    notify_removed_entity(x, y + 1, 0b0010);  // up
-    notify_removed_entity(x + 1, y, 0b0100);  // left
-    notify_removed_entity(x, y - 1, 0b1000);  // down
+long Map::get_local_idx(long chunk_x, long chunk_y, long x, long y) const {
+    long local_idx = (x - chunk_x) + (y - chunk_y) * globals::CHUNK_LENGTH;
+    // SPDLOG_TRACE("Local index for tile ({}, {}) is {}", x, y, local_idx);
+    return local_idx;
 }
 
-void Map::notify_all_moved_entity(long x, long y, MapEntity& entity) {
-    notify_moved_entity(entity, x - 1, y, 0b0001);  // right
-    notify_moved_entity(entity, x, y + 1, 0b0010);  // up
-    notify_moved_entity(entity, x + 1, y, 0b0100);  // left
-    notify_moved_entity(entity, x, y - 1, 0b1000);  // down
+void Map::set_entity(TileStencil& stencil, long x, long y, MapEntity* entity) {
+    SPDLOG_DEBUG("Setting entity at ({}, {})", x, y);
+    Chunk& chunk = stencil.get_chunk(x, y);
+    chunk.set_entity(get_local_idx(chunk, x, y), entity);
 }
@@ -1,26 +1,19 @@
 #pragma once
 
+#include <array>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
+#include "app/globals.hpp"
 #include "entity/building.hpp"
 #include "entity/entity_data.hpp"
 #include "map.pb.h"
+#include "map/scent_field.hpp"
 #include "map/section_data.hpp"
 
 using ulong = unsigned long;
 
-struct Tile {
-    bool is_explored = false;  // has this tile already been seen by the player?
-    bool in_fov = false;       // is the tile currently visible to the player?
-    bool is_wall = true;
-    MapEntity* entity = nullptr;
-    Building* building = nullptr;
-    ulong scents = 0;
-    Tile(bool is_explored = false, bool in_fov = false, bool is_wall = true)
-        : is_explored(is_explored), in_fov(in_fov), is_wall(is_wall) {}
-};
-
 struct ChunkMarker {
     long x;
     long y;
@@ -31,88 +24,199 @@ struct ChunkMarker {
     bool operator<(const ChunkMarker& rhs) const { return id < rhs.id; }
 };
 
+// The tile flags of a chunk are bitboards - bit idx is the tile at local
+// (idx % CHUNK_LENGTH, idx / CHUNK_LENGTH). The scents, entities and buildings
+// are kept in separate planes that are only allocated once they are written.
 struct Chunk {
     long x = 0, y = 0;
     bool update_parity = true;
     bool section_loaded = false;
-    std::vector<Tile> tiles;
+    ulong is_explored = 0;  // has the tile already been seen by the player?
+    ulong in_fov = 0;       // is the tile currently visible to the player?
+    ulong is_wall = ~0UL;
+    ulong is_occupied = 0;  // is there an entity on the tile?
+
+    template <class T>
+    using Plane = std::unique_ptr<std::array<T, globals::CHUNK_AREA>>;
+    Plane<ulong> scents;
+    Plane<MapEntity*> entities;
+    Plane<Building*> buildings;
 
     Chunk() = default;
     Chunk(long x, long y, bool update_parity);
     Chunk(const ant_proto::Chunk& msg);
 
-    Tile& operator[](long idx);
-    Tile const& operator[](long idx) const;
+    static ulong bit(long idx) { return 1UL << idx; }
+
+    ulong get_scents(long idx) const { return scents ? (*scents)[idx] : 0; }
+    ulong& get_scents(long idx);
+    MapEntity* get_entity(long idx) const {
+        return is_occupied & bit(idx) ? (*entities)[idx] : nullptr;
+    }
+    void set_entity(long idx, MapEntity* entity);
+    Building* get_building(long idx) const {
+        return buildings ? (*buildings)[idx] : nullptr;
+    }
+    void set_building(long idx, Building* building);
 
-    ant_proto::Chunk get_proto();
+    ant_proto::Chunk get_proto() const;
 };
 
-class Chunks {
-    using ChunkMap = std::unordered_map<ulong, Chunk*>;
+// Chunks are handed out from fixed size slabs so they never move once created.
+// Released chunks are reused before another slab is allocated.
+class ChunkPool {
+    static constexpr ulong SLAB_SIZE = 64;
+    std::vector<std::unique_ptr<Chunk[]>> slabs;
+    std::vector<Chunk*> free_chunks;
+    ulong slab_used = SLAB_SIZE;  // chunks handed out from the last slab
 
    public:
-    class tile_iterator {
-        using TileVector = std::vector<Tile>;
-
-       public:
-        tile_iterator(ChunkMap::iterator const& map_it)
-            : map_it(map_it), tile_idx(0) {}
+    Chunk* allocate();
+    void release(Chunk* chunk);
+    ulong capacity() const { return slabs.size() * SLAB_SIZE; }
+};
 
-        tile_iterator& operator++();
+// Open addressing table from the spiral chunk id to the pooled chunk. The ids
+// are stored inline so a probe only touches the slot array, and erased slots
+// are filled by shifting the rest of the probe run back (no tombstones).
+class Chunks {
+   public:
+    struct Slot {
+        ulong id = 0;
+        Chunk* chunk = nullptr;  // nullptr for an empty slot
+    };
 
-        Tile& operator*();
-        bool operator!=(tile_iterator const& other);
+    template <class SlotT>
+    class Iterator {
+        SlotT* slot;
+        SlotT* last;
 
-       private:
-        TileVector& get_tiles();
+        void skip_empty() {
+            while(slot != last && slot->chunk == nullptr) ++slot;
+        }
 
-        ChunkMap::iterator map_it;
-        ulong tile_idx;
+       public:
+        Iterator(SlotT* slot, SlotT* last) : slot(slot), last(last) {
+            skip_empty();
+        }
+        SlotT& operator*() const { return *slot; }
+        SlotT* operator->() const { return slot; }
+        Iterator& operator++() {
+            ++slot;
+            skip_empty();
+            return *this;
+        }
+        bool operator==(Iterator const& other) const {
+            return slot == other.slot;
+        }
+        bool operator!=(Iterator const& other) const {
+            return slot != other.slot;
+        }
     };
 
     Chunks() = default;
 
     Chunks(const ant_proto::Chunks& msg);
 
-    tile_iterator begin_tile() { return tile_iterator(chunks.begin()); }
-    tile_iterator end_tile() { return tile_iterator(chunks.end()); }
-
-    ChunkMap::iterator begin() { return chunks.begin(); }
-    ChunkMap::const_iterator begin() const { return chunks.begin(); }
-    ChunkMap::iterator end() { return chunks.end(); }
-    ChunkMap::const_iterator end() const { return chunks.end(); }
+    Iterator<Slot> begin() {
+        return {slots.data(), slots.data() + slots.size()};
+    }
+    Iterator<Slot const> begin() const {
+        return {slots.data(), slots.data() + slots.size()};
+    }
+    Iterator<Slot> end() {
+        return {slots.data() + slots.size(), slots.data() + slots.size()};
+    }
+    Iterator<Slot const> end() const {
+        return {slots.data() + slots.size(), slots.data() + slots.size()};
+    }
 
-    ChunkMap::iterator find(ulong chunk_id) { return chunks.find(chunk_id); }
-    ChunkMap::const_iterator find(ulong chunk_id) const {
-        return chunks.find(chunk_id);
+    Chunk* find(ulong chunk_id) const {
+        if(slots.empty()) return nullptr;
+        for(ulong i = chunk_id & mask();; i = (i + 1) & mask()) {
+            Slot const& slot = slots[i];
+            if(slot.chunk == nullptr) return nullptr;
+            if(slot.id == chunk_id) return slot.chunk;
+        }
     }
 
-    void create_chunk(const ChunkMarker& cm);
     std::vector<ChunkMarker> get_chunk_markers(const Rect& rect) const;
 
-    void erase(ChunkMap::iterator it) { chunks.erase(it); }
+    template <class Predicate>
+    void erase_if(Predicate pred) {
+        for(ulong i = 0; i < slots.size(); ++i) {
+            // the slot is refilled by the shift so check it again
+            while(slots[i].chunk != nullptr && pred(*slots[i].chunk)) erase(i);
+        }
+    }
     long align(long pos) const;  // takes a tile pos and aligns it to chunk
     ulong get_chunk_id(long x, long y) const;
-    Chunk& operator[](ulong chunk_id) { return *chunks[chunk_id]; }
-    Chunk& operator[](std::pair<long, long> p) {
-        return *chunks[get_chunk_id(p.first, p.second)];
-    }
-    Chunk const& at(ulong chunk_id) const { return *chunks.at(chunk_id); }
-    void emplace(ulong chunk_id, Chunk* chunk) {
-        chunks.emplace(chunk_id, chunk);
-    }
+    Chunk const& at(ulong chunk_id) const { return *find(chunk_id); }
+    // the chunk id must not be in the table yet
+    Chunk& emplace(ulong chunk_id);
+    ulong size() const { return count; }
 
     ant_proto::Chunks get_proto() const;
 
    private:
-    ChunkMap chunks;
+    static constexpr ulong MIN_SLOTS = 64;
+
+    ulong mask() const { return slots.size() - 1; }
+    void insert(ulong chunk_id, Chunk* chunk);
+    void erase(ulong slot_idx);
+    void grow();
+
+    std::vector<Slot> slots;  // power of two, at most half full
+    ulong count = 0;
+    ChunkPool pool;
+};
+
+class Map;
+
+// The 3x3 chunks around a home tile. An operation on an entity resolves each
+// chunk once through the map and then indexes the stencil for every other
+// tile it touches. Chunks are still generated lazily on first use, so the
+// generation order is the same as looking each tile up in the map.
+class TileStencil {
+    Map& map;
+    long chunk_x, chunk_y;              // origin of the home chunk
+    std::array<Chunk*, 9> chunks = {};  // row major, home chunk in the middle
+
+   public:
+    TileStencil(Map& map, long x, long y);
+
+    // the tile must lie in the home chunk or one of its neighbours
+    Chunk& get_chunk(long x, long y);
+    // Resolves the chunks under the square of the radius around the tile,
+    // generating the missing ones. Once every tile an operation touches is
+    // resolved the stencil no longer goes through the map, so it can be used
+    // away from the main thread.
+    void resolve(long x, long y, long radius);
+    static long get_local_idx(Chunk const& chunk, long x, long y) {
+        return (x - chunk.x) + (y - chunk.y) * globals::CHUNK_LENGTH;
+    }
+};
+
+// A step an entity wants to take this tick. A batch of them is settled by
+// Map::move_entities at once, so the outcome does not depend on their order.
+struct MoveIntent {
+    MapEntity* entity;
+    long dx, dy;
+    ulong priority;          // the lowest one wins a tile several step onto
+    bool is_move = false;    // entities that stay still are skipped
+    bool is_moved = false;   // set by Map::move_entities
 };
 
 class Map {
+    friend class TileStencil;
     using f_xy_t = std::function<void(long, long)>;
     f_xy_t generate_chunk_callback;
 
    public:
+    // The tiles a move, dig or scent update of an entity reads or writes are
+    // at most this many steps from where the entity stands
+    static constexpr long ACTION_REACH = 2;
+
     bool needs_update = true;
     bool chunk_update_parity = false;
 
@@ -125,15 +229,30 @@ class Map {
     void load_section(MapSectionData const& section_data);
     void dig(long x1, long y1, long x2, long y2);
     bool can_place(long x, long y);
-    void add_entity_wo_events(MapEntity& entity);
     void add_entity(MapEntity& entity);
     void remove_entity(MapEntity& entity);
     bool move_entity(MapEntity& entity, long dx, long dy);
     bool dig(MapEntity& entity, long dx, long dy);
+    // stencil centred on the entity - it covers every tile a move, dig and
+    // scent update of the entity touches
+    TileStencil get_stencil(MapEntity& entity);
+    // Hands the entity the scents around the tile it steps onto. Only reads
+    // the map so it can run on several threads once the stencils are resolved.
+    void announce_move(TileStencil& stencil, MapEntity& entity, long dx,
+                       long dy);
+    // Settles the moves of a batch - announced beforehand - and applies them.
+    // An entity steps onto a free tile, onto the tile of an entity that moves
+    // away, or around a cycle of at least three entities. Two entities do not
+    // swap and the lowest priority wins a contested tile.
+    void move_entities(MoveIntent* intents, ulong count);
+    bool dig(TileStencil& stencil, MapEntity& entity, long dx, long dy);
     void add_building(Building& building);
     Building* get_building(MapEntity& entity);
     void create_chunk(long x, long y);
     std::vector<ChunkMarker> get_chunk_markers(const Rect& rect) const;
+    ulong get_chunk_id(long x, long y) const {
+        return chunks.get_chunk_id(x, y);
+    }
     void remove_unused_chunks();
     void update_chunks(Rect const& rect);
     void reset_fov();
@@ -141,26 +260,82 @@ class Map {
     void explore(long x, long y);
     bool chunk_built(const ChunkMarker& cm) const;
     bool chunk_built(long x, long y) const;
-    bool in_fov(long x, long y);
-    bool is_explored(long x, long y);
-    bool is_wall(long x, long y);
+    // generates every chunk under the rect ahead of the reads below
+    void prefetch(Rect const& rect);
+    // Read only queries never generate chunks, so they are safe to call from
+    // the render and fov paths. Space that was not generated yet reads as an
+    // unexplored wall without scents.
+    bool in_fov(long x, long y) const;
+    bool is_explored(long x, long y) const;
+    bool is_wall(long x, long y) const;
+    // DLUR bits of the tiles around the tile that hold neither a wall nor an
+    // entity - one chunk is read away from the chunk borders. The walls only
+    // count when they are enabled, as in the moves.
+    uchar empty_neighbours(long x, long y) const;
     bool click(long x, long y);
     ulong& get_tile_scents(MapEntity& entity);
-    ulong get_tile_scents_by_coord(long x, long y);
+    ulong& get_tile_scents(TileStencil& stencil, MapEntity& entity);
+    ulong get_tile_scents_by_coord(long x, long y) const;
+    // Spreads the scents of every chunk that has some to the tiles around
+    // them and lets them evaporate. The new planes are computed from the old
+    // ones, so the order the chunks are visited in does not matter.
+    void update_scents(ulong tick);
     ant_proto::Map get_proto() const;
 
    private:
     Chunk& get_chunk(long x, long y);
-    Chunk const& get_chunk_const(long x, long y) const;
+    Chunk const* find_chunk(long x, long y) const {
+        return chunks.find(chunks.get_chunk_id(x, y));
+    }
+    // the chunk next to the chunk on the side - nullptr if not generated
+    Chunk* find_neighbour(Chunk const& chunk, ScentField::Side side) const;
     long get_local_idx(long chunk_x, long chunk_y, long x, long y) const;
-    Tile& get_tile(long x, long y);
-    uchar flip_direction_bits(uchar bits);
-    void notify_removed_entity(long x, long y, uchar bits);
-    void notify_moved_entity(MapEntity& source, long x, long y, uchar bits);
-    void set_entity(long x, long y, MapEntity* entity);
-    void notify_all_removed_entity(long x, long y);
-    void notify_all_moved_entity(long x, long y, MapEntity& entity);
+    long get_local_idx(Chunk const& chunk, long x, long y) const {
+        return get_local_idx(chunk.x, chunk.y, x, y);
+    }
+    bool can_place(TileStencil& stencil, long x, long y);
+    void set_entity(TileStencil& stencil, long x, long y, MapEntity* entity);
+    static ulong tile_key(long x, long y) {
+        return static_cast<ulong>(static_cast<uint32_t>(x)) << 32 |
+               static_cast<uint32_t>(y);
+    }
+
+    // Settles the pending moves in move_states - the chains that reach a free
+    // tile and the cycles of at least three end up MOVED
+    void settle_moves(MoveIntent* intents, ulong count);
+
+    // scratch of move_entities kept between ticks
+    enum MoveState : uchar { MOVE_PENDING, MOVE_VISITING, MOVED, MOVE_BLOCKED };
+    static constexpr ulong NO_MOVER = ~0UL;
+    struct TileMoves {
+        ulong leaving = NO_MOVER;   // intent of the entity standing on it
+        ulong claimant = NO_MOVER;  // intent that wins the tile
+    };
+    std::unordered_map<ulong, TileMoves> tile_moves;
+    std::vector<uchar> move_states;
+    std::vector<ulong> move_chain;
+
+    // scratch of update_scents kept between ticks
+    struct ScentUpdate {
+        Chunk* chunk;
+        ScentField::Plane plane = {};
+        bool is_live = false;  // does the new plane hold any scent
+    };
+    std::vector<ScentUpdate> scent_updates;
 
     Chunks chunks;
+    Chunk* last_chunk = nullptr;  // chunk of the last get_chunk hit
     bool is_walls_enabled;
 };
+
+// The four tiles around an entity. They are read from the bitboards of its map
+// when asked, so nothing is tracked while the entity does not look.
+struct Surroundings {
+    Map const* map = nullptr;
+    EntityData const* data = nullptr;
+
+    // DLUR bits of the empty neighbours - all empty off the map
+    uchar empty_bits() const {
+        return map ? map->empty_neighbours(data->x, data->y) : 0b1111;
+    }
+};
@@ -0,0 +1,152 @@
+#include "map/scent_field.hpp"
+
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace ScentField;
+
+namespace {
+    constexpr long LENGTH = globals::CHUNK_LENGTH;
+    constexpr ulong LOW_BITS = 0x0101010101010101;
+    constexpr ulong HIGH_BITS = 0x8080808080808080;
+    constexpr unsigned char SHARE_MASK = 0xFF >> SPREAD_SHIFT;
+
+    // A tile keeps what it does not hand to its four neighbours, and the
+    // shares of a full channel and its neighbours add up to at most 255 - so
+    // the byte lanes never carry into each other
+    static_assert(SPREAD_SHIFT >= 2);
+
+    // the part of each channel handed to one neighbour
+    ulong share(ulong scents) {
+        return (scents >> SPREAD_SHIFT) & (SHARE_MASK * LOW_BITS);
+    }
+
+#ifdef __AVX2__
+    __m256i share(__m256i scents) {
+        return _mm256_and_si256(_mm256_srli_epi16(scents, SPREAD_SHIFT),
+                                _mm256_set1_epi8(SHARE_MASK));
+    }
+#elif defined(__SSE2__)
+    __m128i share(__m128i scents) {
+        return _mm_and_si128(_mm_srli_epi16(scents, SPREAD_SHIFT),
+                             _mm_set1_epi8(SHARE_MASK));
+    }
+#else
+    // one in the low bit of every channel that is not zero
+    ulong nonzero_channels(ulong scents) {
+        ulong const low = (scents & ~HIGH_BITS) + ~HIGH_BITS;
+        return ((low | scents) & HIGH_BITS) >> 7;
+    }
+#endif
+
+    // Spreads one row of tiles into out. The row is padded with the tile left
+    // of it in front and the tile right of it behind.
+    void spread_row(ulong const* padded, ulong const* up, ulong const* down,
+                    bool is_evaporating, ulong* out) {
+        ulong const* center = padded + 1;
+#ifdef __AVX2__
+        static_assert(LENGTH % 4 == 0);
+        __m256i const evaporation = _mm256_set1_epi8(is_evaporating);
+        for(long i = 0; i < LENGTH; i += 4) {
+            auto load = [i](ulong const* row) {
+                return _mm256_loadu_si256(
+                    reinterpret_cast<__m256i const*>(row + i));
+            };
+            __m256i const scents = load(center);
+            __m256i const spread =
+                _mm256_add_epi8(_mm256_add_epi8(share(load(padded)),
+                                                share(load(padded + 2))),
+                                _mm256_add_epi8(share(load(up)),
+                                                share(load(down))));
+            __m256i const kept =
+                _mm256_sub_epi8(scents, _mm256_slli_epi16(share(scents), 2));
+            __m256i const result =
+                _mm256_subs_epu8(_mm256_add_epi8(kept, spread), evaporation);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+        }
+#elif defined(__SSE2__)
+        static_assert(LENGTH % 2 == 0);
+        __m128i const evaporation = _mm_set1_epi8(is_evaporating);
+        for(long i = 0; i < LENGTH; i += 2) {
+            auto load = [i](ulong const* row) {
+                return _mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(row + i));
+            };
+            __m128i const scents = load(center);
+            __m128i const spread = _mm_add_epi8(
+                _mm_add_epi8(share(load(padded)), share(load(padded + 2))),
+                _mm_add_epi8(share(load(up)), share(load(down))));
+            __m128i const kept =
+                _mm_sub_epi8(scents, _mm_slli_epi16(share(scents), 2));
+            __m128i const result =
+                _mm_subs_epu8(_mm_add_epi8(kept, spread), evaporation);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+        }
+#else
+        // eight channels at a time in a ulong
+        ulong const evaporation_bits = is_evaporating ? LOW_BITS : 0;
+        for(long i = 0; i < LENGTH; ++i) {
+            ulong const spread = share(padded[i]) + share(padded[i + 2]) +
+                                 share(up[i]) + share(down[i]);
+            ulong const kept = center[i] - (share(center[i]) << 2);
+            ulong const sum = kept + spread;
+            out[i] = sum - (nonzero_channels(sum) & evaporation_bits);
+        }
+#endif
+    }
+}  // namespace
+
+ulong ScentField::add_saturated(ulong lhs, ulong rhs) {
+    // add the low seven bits of the channels, then the high bits without
+    // carrying them into the next channel
+    ulong const sum =
+        ((lhs & ~HIGH_BITS) + (rhs & ~HIGH_BITS)) ^ ((lhs ^ rhs) & HIGH_BITS);
+    ulong const overflow = ((lhs & rhs) | ((lhs | rhs) & ~sum)) & HIGH_BITS;
+    return sum | (overflow >> 7) * 0xFF;
+}
+
+bool ScentField::spreads(Plane const& plane, Side side) {
+    for(long i = 0; i < LENGTH; ++i) {
+        long const idx = side == RIGHT  ? i * LENGTH + LENGTH - 1
+                         : side == UP   ? i
+                         : side == LEFT ? i * LENGTH
+                                        : globals::CHUNK_AREA - LENGTH + i;
+        if(share(plane[idx]) != 0) return true;
+    }
+    return false;
+}
+
+bool ScentField::step(Plane const& plane, Neighbours const& neighbours,
+                      bool is_evaporating, Plane& out) {
+    static constexpr Plane none = {};
+    auto side = [&neighbours](Side side) -> Plane const& {
+        Plane const* neighbour = neighbours.planes[side];
+        return neighbour ? *neighbour : none;
+    };
+    Plane const& right = side(RIGHT);
+    Plane const& up = side(UP);
+    Plane const& left = side(LEFT);
+    Plane const& down = side(DOWN);
+
+    ulong padded[LENGTH + 2];
+    for(long y = 0; y < LENGTH; ++y) {
+        long const row = y * LENGTH;
+        padded[0] = left[row + LENGTH - 1];
+        std::memcpy(padded + 1, plane.data() + row, LENGTH * sizeof(ulong));
+        padded[LENGTH + 1] = right[row];
+        ulong const* up_row = y > 0 ? plane.data() + row - LENGTH
+                                    : up.data() + globals::CHUNK_AREA - LENGTH;
+        ulong const* down_row =
+            y + 1 < LENGTH ? plane.data() + row + LENGTH : down.data();
+        spread_row(padded, up_row, down_row, is_evaporating, out.data() + row);
+    }
+
+    ulong scents = 0;
+    for(ulong tile_scents : out) scents |= tile_scents;
+    return scents != 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+
+#include "app/globals.hpp"
+
+using ulong = unsigned long;
+
+// Scents are eight 8 bit channels packed into one ulong per tile, and a chunk
+// keeps them in a plane of its tiles. Every tick a tile hands 1/16 of each
+// channel to each of its four neighbours, and every EVAPORATION_TICKS ticks
+// each channel loses one unit. Deposits saturate at 255.
+namespace ScentField {
+    using Plane = std::array<ulong, globals::CHUNK_AREA>;
+
+    constexpr int SPREAD_SHIFT = 4;          // a neighbour gets 1/16
+    constexpr ulong EVAPORATION_TICKS = 64;  // a unit evaporates this often
+
+    enum Side { RIGHT, UP, LEFT, DOWN };
+
+    // The planes of the neighbouring chunks - null where the chunk has no
+    // scent. The scent a tile hands to a chunk that was not generated is lost.
+    struct Neighbours {
+        std::array<Plane const*, 4> planes = {};  // indexed by Side
+    };
+
+    // per channel sum clamped to 255
+    ulong add_saturated(ulong lhs, ulong rhs);
+    // does any tile on the side hand scent over it
+    bool spreads(Plane const& plane, Side side);
+    // Spreads and evaporates the plane into out - returns false once every
+    // channel of out is zero
+    bool step(Plane const& plane, Neighbours const& neighbours,
+              bool is_evaporating, Plane& out);
+}  // namespace ScentField
@@ -3,7 +3,6 @@
 #include <algorithm>
 #include <climits>
 #include <cstdint>
-#include <libtcod/mersenne.hpp>
 
 #include "app/globals.hpp"
 #include "entity/ant.hpp"
@@ -13,18 +12,20 @@
 #include "map/section_data.hpp"
 #include "map/window.hpp"
 
-Level::Level(const Map& map, ulong depth) : map(map), depth(depth) {}
+Level::Level(Map&& map, ulong depth) : map(std::move(map)), depth(depth) {}
 
-Level::Level(const ant_proto::Level& msg, const ulong& instr_clock,
-             const ItemInfoMap& item_map,
-             ThreadPool<AsyncProgramJob>& thread_pool, bool is_walls_enabled,
-             f_xy_t pre_chunk_generation_callback)
+Level::Level(const ant_proto::Level& msg, ulong depth,
+             const ulong& instr_clock, const ItemInfoMap& item_map, ulong seed,
+             bool is_walls_enabled, f_xy_t pre_chunk_generation_callback)
     : workers{},
       buildings{},
-      map(msg.map(), is_walls_enabled, pre_chunk_generation_callback) {
-    for(const auto& worker_msg : msg.workers())
-        workers.emplace_back(
-            new Worker(worker_msg, instr_clock, item_map, thread_pool));
+      map(msg.map(), is_walls_enabled, pre_chunk_generation_callback),
+      depth(depth) {
+    for(const auto& worker_msg : msg.workers()) {
+        workers.emplace_back(new Worker(worker_msg, instr_clock, item_map));
+        workers.back()->random_seed = seed;
+        workers.back()->set_map(map);
+    }
 
     for(const auto& building_msg : msg.buildings()) add_building(building_msg);
 }
@@ -70,7 +71,7 @@ Peaceful_Cavern::Peaceful_Cavern()
 
 void Peaceful_Cavern::build_section(Level& l, Section_Plan& sp) {
     MapSectionData section(sp.border);
-    RandomMapBuilder(Rect(sp.border))(section);
+    RandomMapBuilder(Rect(sp.border), sp.seed, l.depth)(section);
     l.map.load_section(section);
 }
 
@@ -134,17 +135,6 @@ void Region::place_zone(chunk_assignments_t& chunk_assignments, long x, long y,
     }
 }
 
-class shuffle_randomizer {
-    TCODRandom& r;
-
-   public:
-    shuffle_randomizer(TCODRandom& r) : r(r) {}
-    using result_type = uint;
-    static constexpr result_type min() { return 0; }
-    static constexpr result_type max() { return INT_MAX; }
-    result_type operator()() { return r.getInt(min(), max()); }
-};
-
 void Region::do_blueprint_planning() {
     // randomly partition world into smaller columns.
     // These columns will then be sliced into
@@ -171,7 +161,7 @@ void Region::do_blueprint_planning() {
     }
 
     std::vector<Zone*> shapes = {new Peaceful_Cavern()};
-    std::shuffle(shapes.begin(), shapes.end(), shuffle_randomizer(randomizer));
+    std::shuffle(shapes.begin(), shapes.end(), randomizer);
 
     uint failed_attempts = 0;
     while(failed_attempts < 10) {
@@ -180,7 +170,8 @@ void Region::do_blueprint_planning() {
             bool placed = false;
             long shape_width = shape->w;
             long shape_height = shape->h;
-            for(long z = 0; z <= globals::MAX_LEVEL_DEPTH; ++z) {
+            long shape_depth = shape->depth;
+            for(long z = 0; z <= globals::MAX_LEVEL_DEPTH - shape_depth; ++z) {
                 for(long x = 0; x <= xy_length - shape_width; ++x) {
                     for(long y = 0; y <= xy_length - shape_height; ++y) {
                         if(can_place_zone(chunk_assignments, x, y, z, *shape)) {
@@ -199,8 +190,7 @@ void Region::do_blueprint_planning() {
             if(placed) successful_attempt = true;
         }
         if(!successful_attempt) failed_attempts++;
-        std::shuffle(shapes.begin(), shapes.end(),
-                     shuffle_randomizer(randomizer));
+        std::shuffle(shapes.begin(), shapes.end(), randomizer);
     }
 
     // Plan out the sections in each level
@@ -239,21 +229,34 @@ void Region::do_blueprint_planning() {
                          (zone_placement.chunk_y * globals::CHUNK_LENGTH),
                      zone_placement.zone->w * globals::CHUNK_LENGTH,
                      zone_placement.zone->h * globals::CHUNK_LENGTH),
-                z - zone_placement.chunk_z, zone_placement.zone->build_section);
+                z - zone_placement.chunk_z, get_section_seed(),
+                zone_placement.zone->build_section);
         }
     }
 }
 
 uint32_t Region::get_seed() { return seed_x ^ seed_y; }
 
-Region::Region(const Rect& perimeter)
-    : perimeter(perimeter), is_first_region(true) {
-    // NO Seeds provided so generate them
-    TCODRandom* rng = TCODRandom::getInstance();
-    seed_x = rng->getInt(0, INT_MAX);
-    seed_y = rng->getInt(0, INT_MAX);
-    randomizer = TCODRandom(get_seed());
+ulong Region::get_section_seed() const {
+    return static_cast<ulong>(seed_x) << 32 | seed_y;
+}
+
+namespace {
+    // the sections stream from their corner so the planning takes one no
+    // chunk aligned corner can reach
+    constexpr ulong planning_stream = ~0UL;
 
+    uint32_t draw_seed(CounterRandom&& random) {
+        return random.get_int(0, INT_MAX);
+    }
+}  // namespace
+
+Region::Region(const Rect& perimeter, ulong world_seed)
+    : seed_x(draw_seed(CounterRandom(world_seed, planning_stream, 0))),
+      seed_y(draw_seed(CounterRandom(world_seed, planning_stream, 1))),
+      perimeter(perimeter),
+      randomizer(get_section_seed(), planning_stream, 0),
+      is_first_region(true) {
     do_blueprint_planning();
 }
 
@@ -261,7 +264,7 @@ Region::Region(uint32_t seed_x, uint32_t seed_y, const Rect& perimeter)
     : seed_x(seed_x),
       seed_y(seed_y),
       perimeter(perimeter),
-      randomizer(get_seed()),
+      randomizer(get_section_seed(), planning_stream, 0),
       is_first_region(false) {
     do_blueprint_planning();
 }
@@ -270,6 +273,7 @@ Region::Region(const ant_proto::Region& msg)
     : seed_x(msg.seed_x()),
       seed_y(msg.seed_y()),
       perimeter(msg.perimeter()),
+      randomizer(get_section_seed(), planning_stream, 0),
       is_first_region(msg.is_first_region()) {}
 
 ant_proto::Region Region::get_proto() {
@@ -287,26 +291,28 @@ struct Generate_Chunk_Callback {
     }
 };
 
-MapWorld::MapWorld(const Rect& border, bool is_walls_enabled)
-    : levels{}, regions(), map_window(border) {
+MapWorld::MapWorld(const Rect& border, bool is_walls_enabled, ulong seed)
+    : seed(seed), levels{}, regions(seed), map_window(border) {
     // Ensure that levels are created
     for(size_t i = 0; i < globals::MAX_LEVEL_DEPTH; ++i)
         levels.emplace_back(
             Level(Map(is_walls_enabled, Generate_Chunk_Callback{i, *this}), i));
 }
 
-MapWorld::MapWorld(const ant_proto::MapWorld& msg,
-                   ThreadPool<AsyncProgramJob>& thread_pool,
-                   bool is_walls_enabled)
-    : levels{},
+MapWorld::MapWorld(const ant_proto::MapWorld& msg, bool is_walls_enabled)
+    : seed(msg.seed()),
+      levels{},
+      regions(seed),
       map_window(msg.map_window()),
       current_depth(msg.current_depth()),
       item_info_map(),
       instr_action_clock(msg.instr_action_clock()) {
+    levels.reserve(msg.levels().size());
     for(int i = 0; i < msg.levels().size(); ++i) {
         auto cb = Generate_Chunk_Callback{static_cast<ulong>(i), *this};
-        levels[i] = Level(msg.levels()[i], instr_action_clock, item_info_map,
-                          thread_pool, is_walls_enabled, cb);
+        // the levels are saved in depth order
+        levels.emplace_back(msg.levels()[i], i, instr_action_clock,
+                            item_info_map, seed, is_walls_enabled, cb);
     }
 }
 
@@ -318,6 +324,7 @@ ant_proto::MapWorld MapWorld::get_proto() const {
     ant_proto::MapWorld msg;
     for(const auto& level : levels) *msg.add_levels() = level.get_proto();
     msg.set_current_depth(current_depth);
+    msg.set_seed(seed);
     *msg.mutable_map_window() = map_window.get_proto();
 
     return msg;
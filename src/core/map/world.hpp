@@ -1,6 +1,5 @@
 #pragma once
 
-#include <libtcod/mersenne.hpp>
 #include <optional>
 
 #include "app/globals.hpp"
@@ -11,7 +10,7 @@
 #include "map/map.hpp"
 #include "map/window.hpp"
 #include "utils/math.hpp"
-#include "utils/thread_pool.hpp"
+#include "utils/random.hpp"
 
 struct Worker;
 struct Building;
@@ -22,11 +21,13 @@ struct Section_Plan {
     using buildf_t = std::function<void(Level&, Section_Plan&)>;
     Rect border;
     ulong depth_in_zone;
+    ulong seed;  // of the region - the section draws from its own stream
     bool in_construction;
-    Section_Plan(const Rect& border, ulong depth_in_zone,
+    Section_Plan(const Rect& border, ulong depth_in_zone, ulong seed,
                  buildf_t _build_section)
         : border(border),
           depth_in_zone(depth_in_zone),
+          seed(seed),
           in_construction(false),
           _build_section(_build_section) {}
     buildf_t _build_section;
@@ -47,10 +48,10 @@ struct Level {
     Map map;
     ulong depth;
 
-    Level(const Map& map, ulong depth);
-    Level(const ant_proto::Level& msg, const ulong& instr_clock,
-          const ItemInfoMap& item_map, ThreadPool<AsyncProgramJob>& thread_pool,
-          bool is_walls_enabled, f_xy_t pre_chunk_generation_callback);
+    Level(Map&& map, ulong depth);
+    Level(const ant_proto::Level& msg, ulong depth, const ulong& instr_clock,
+          const ItemInfoMap& item_map, ulong seed, bool is_walls_enabled,
+          f_xy_t pre_chunk_generation_callback);
 
     ant_proto::Level get_proto() const;
 
@@ -86,12 +87,12 @@ struct Region {
     uint32_t seed_x;
     uint32_t seed_y;
     Rect perimeter;
-    TCODRandom randomizer;
+    CounterRandom randomizer;
     bool is_first_region;
     std::vector<std::vector<Section_Plan>> section_plans = {};
 
     Region() = delete;
-    Region(const Rect& perimeter);
+    Region(const Rect& perimeter, ulong world_seed);
     Region(uint32_t seed_x, uint32_t seed_y, const Rect& perimeter);
     Region(const ant_proto::Region& msg);
     ant_proto::Region get_proto();
@@ -133,6 +134,7 @@ struct Region {
     }
 
     uint32_t get_seed();
+    ulong get_section_seed() const;
     bool can_place_zone(chunk_assignments_t& chunk_assignemnts, long x, long y,
                         long z, Zone& zone);
     void place_zone(chunk_assignments_t& chunk_assignemnts, long x, long y,
@@ -199,14 +201,18 @@ struct Regions {
         }
     }
 
-    Regions() : rmap() {
-        rmap.emplace(Region_Key{0, 0}, Region(Rect(0, 0, globals::WORLD_LENGTH,
-                                                   globals::WORLD_LENGTH)));
+    explicit Regions(ulong world_seed) : rmap() {
+        rmap.emplace(Region_Key{0, 0},
+                     Region(Rect(0, 0, globals::WORLD_LENGTH,
+                                 globals::WORLD_LENGTH),
+                            world_seed));
     }
 };
 
 class MapWorld {
    public:
+    // every random number of the world is drawn from a stream of the seed
+    ulong seed;
     std::vector<Level> levels;
     Regions regions;
     MapWindow map_window;
@@ -214,10 +220,9 @@ class MapWorld {
     ItemInfoMap item_info_map = {};
     ulong instr_action_clock = 0;
 
-    MapWorld(const Rect& border,
-             bool is_walls_enabled);  // guaranteed first world
-    MapWorld(const ant_proto::MapWorld& msg,
-             ThreadPool<AsyncProgramJob>& thread_pool, bool is_walls_enabled);
+    MapWorld(const Rect& border, bool is_walls_enabled,
+             ulong seed);  // guaranteed first world
+    MapWorld(const ant_proto::MapWorld& msg, bool is_walls_enabled);
     ant_proto::MapWorld get_proto() const;
 
     Level& current_level();
@@ -8,6 +8,17 @@
 #include "spdlog/spdlog.h"
 #include "ui/debug_graphics.hpp"
 
+// Short form of a profile count so it fits at the end of an editor line
+static std::string compact_count(ulong count) {
+    char const* suffixes[] = {"", "K", "M", "G", "T"};
+    ulong suffix = 0;
+    while(count >= 1000 && suffix < 4) {
+        count /= 1000;
+        ++suffix;
+    }
+    return std::to_string(count) + suffixes[suffix];
+}
+
 struct Box {
     ulong x, y, w, h;
     std::vector<std::string> &asciiGrid;
@@ -76,7 +87,7 @@ tcodRenderer::tcodRenderer(bool is_debug_graphics)
         use_default_tile_rendering();
 }
 
-void tcodRenderer::render_map(LayoutBox const &box, Map &map,
+void tcodRenderer::render_map(LayoutBox const &box, Map const &map,
                               MapWindow const &window) {
     std::unique_ptr<MapTileRenderer> tile_renderer =
         generate_tile_renderer(map);
@@ -102,7 +113,7 @@ void tcodRenderer::render_map(LayoutBox const &box, Map &map,
         is_debug_graphics);
 }
 
-DebugMapTileRenderer::DebugMapTileRenderer(Map &map) : map(map) {}
+DebugMapTileRenderer::DebugMapTileRenderer(Map const &map) : map(map) {}
 
 void DebugMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
     TCOD_ColorRGBA darkWall = color::light_black;
@@ -116,7 +127,7 @@ void DebugMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
     }
 }
 
-TcodMapTileRenderer::TcodMapTileRenderer(Map &map) : map(map) {}
+TcodMapTileRenderer::TcodMapTileRenderer(Map const &map) : map(map) {}
 
 void TcodMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
     // SPDLOG_TRACE("Rendering map");
@@ -137,7 +148,7 @@ void TcodMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
     }
 }
 
-ScentMapTileRenderer::ScentMapTileRenderer(Map &map, ulong scent_idx)
+ScentMapTileRenderer::ScentMapTileRenderer(Map const &map, ulong scent_idx)
     : map(map), scent_idx(scent_idx) {
     SPDLOG_TRACE("Created scent map tile renderer with scent_idx: {}",
                  scent_idx);
@@ -161,8 +172,8 @@ void ScentMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
     }
 }
 
-void tcodRenderer::render_ant(LayoutBox const &box, Map &map, EntityData &a,
-                              MapWindow const &window) {
+void tcodRenderer::render_ant(LayoutBox const &box, Map const &map,
+                              EntityData &a, MapWindow const &window) {
     // SPDLOG_TRACE("Rendering ant at ({}, {})", a.x, a.y);
     long x, y;
     bool is_valid;
@@ -261,6 +272,22 @@ void tcodRenderer::render_text_editor(LayoutBox const &box,
                  globals::TEXTBOXHEIGHT + globals::REGBOXHEIGHT + 3),
         result, color::white, color::black, TCOD_LEFT, TCOD_BKGND_SET);
 
+    // executed counts of the profiled lines - red where an instruction failed
+    for(long row = 0; row < globals::TEXTBOXHEIGHT; ++row) {
+        size_t const line_idx = editor.get_offset_y() + row;
+        if(line_idx >= editor.profile.size()) break;
+        ProfileLine const &line = editor.profile[line_idx];
+        if(line.executed == 0) continue;
+
+        std::string const count = compact_count(line.executed);
+        tcod::print_rect(
+            root_console,
+            get_rect(box, globals::TEXTBOXWIDTH + 1 - count.size(), row + 1,
+                     count.size(), 1),
+            count, line.failed ? color::red : color::grey, color::black,
+            TCOD_LEFT, TCOD_BKGND_SET);
+    }
+
     tcod::print_rect(
         root_console,
         get_rect(box, editor.get_cursor_x() + 1 - editor.get_offset_x(),
@@ -316,21 +343,21 @@ const std::array<int, 4> tcodRenderer::get_rect(LayoutBox const &box, long x,
 
 void tcodRenderer::use_default_tile_rendering() {
     SPDLOG_INFO("Using default map tile renderer");
-    generate_tile_renderer = [](Map &map) {
+    generate_tile_renderer = [](Map const &map) {
         return std::make_unique<TcodMapTileRenderer>(map);
     };
 }
 
 void tcodRenderer::use_debug_tile_rendering() {
     SPDLOG_INFO("Using default map tile renderer");
-    generate_tile_renderer = [](Map &map) {
+    generate_tile_renderer = [](Map const &map) {
         return std::make_unique<DebugMapTileRenderer>(map);
     };
 }
 
 void tcodRenderer::use_scent_tile_rendering(ulong scent_idx) {
     SPDLOG_INFO("Using scent map tile renderer - scent index: {}", scent_idx);
-    generate_tile_renderer = [scent_idx](Map &map) {
+    generate_tile_renderer = [scent_idx](Map const &map) {
         return std::make_unique<ScentMapTileRenderer>(map, scent_idx);
     };
 }
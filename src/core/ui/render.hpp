@@ -13,8 +13,8 @@
 
 class Renderer {
    public:
-    virtual void render_map(LayoutBox const&, Map&, MapWindow const&) = 0;
-    virtual void render_ant(LayoutBox const& box, Map& map, EntityData& a,
+    virtual void render_map(LayoutBox const&, Map const&, MapWindow const&) = 0;
+    virtual void render_ant(LayoutBox const& box, Map const& map, EntityData& a,
                             MapWindow const&) = 0;
     virtual void render_building(LayoutBox const& box, Building& b,
                                  MapWindow const&) = 0;
@@ -32,8 +32,9 @@ class Renderer {
 class NoneRenderer : public Renderer {
    public:
     NoneRenderer() { SPDLOG_INFO("NoneRenderer initialized"); }
-    void render_map(LayoutBox const&, Map&, MapWindow const&) {};
-    void render_ant(LayoutBox const&, Map&, EntityData&, MapWindow const&) {};
+    void render_map(LayoutBox const&, Map const&, MapWindow const&) {};
+    void render_ant(LayoutBox const&, Map const&, EntityData&,
+                    MapWindow const&) {};
     void render_building(LayoutBox const&, Building&, MapWindow const&) {};
     void render_text_editor(LayoutBox const&, TextEditor const&, size_t) {};
     void render_help_boxes(LayoutBox const&) {};
@@ -52,30 +53,30 @@ struct MapTileRenderer {
 };
 
 struct TcodMapTileRenderer : public MapTileRenderer {
-    Map& map;
+    Map const& map;
     bool is_debug_graphics;
-    TcodMapTileRenderer(Map& map);
+    TcodMapTileRenderer(Map const& map);
     void operator()(TCOD_ConsoleTile& tile, long x, long y);
 };
 
 struct ScentMapTileRenderer : public MapTileRenderer {
-    Map& map;
+    Map const& map;
     ulong scent_idx;
-    ScentMapTileRenderer(Map& map, ulong scent_idx);
+    ScentMapTileRenderer(Map const& map, ulong scent_idx);
     void operator()(TCOD_ConsoleTile& tile, long x, long y);
 };
 
 struct DebugMapTileRenderer : public MapTileRenderer {
-    Map& map;
-    DebugMapTileRenderer(Map& map);
+    Map const& map;
+    DebugMapTileRenderer(Map const& map);
     void operator()(TCOD_ConsoleTile& tile, long x, long y);
 };
 
 class tcodRenderer : public Renderer {
    public:
     tcodRenderer(bool is_debug_graphics);
-    void render_map(LayoutBox const&, Map&, MapWindow const&);
-    void render_ant(LayoutBox const& box, Map& map, EntityData& a,
+    void render_map(LayoutBox const&, Map const&, MapWindow const&);
+    void render_ant(LayoutBox const& box, Map const& map, EntityData& a,
                     MapWindow const&);
     void render_building(LayoutBox const& box, Building& b, MapWindow const&);
     void render_text_editor(LayoutBox const& box, TextEditor const& editor,
@@ -97,6 +98,6 @@ class tcodRenderer : public Renderer {
     bool is_debug_graphics = false;
     tcod::Context context;
     tcod::Console root_console;
-    std::function<std::unique_ptr<MapTileRenderer>(Map&)>
+    std::function<std::unique_ptr<MapTileRenderer>(Map const&)>
         generate_tile_renderer;
 };
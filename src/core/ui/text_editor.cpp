@@ -1,17 +1,23 @@
 #include "ui/text_editor.hpp"
 
 #include "app/globals.hpp"
+#include "hardware/hardware_manager.hpp"
 #include "hardware/software_manager.hpp"
 #include "spdlog/spdlog.h"
 
-TextEditor::TextEditor(SoftwareManager& software_manager)
-    : software_manager(software_manager) {
+TextEditor::TextEditor(SoftwareManager& software_manager,
+                       HardwareManager const& hardware_manager)
+    : software_manager(software_manager), hardware_manager(hardware_manager) {
     reset();
 }
 
 void TextEditor::open() {
     SPDLOG_INFO("Opening the editor");
     software_manager.get_lines(lines);
+    if constexpr(ExecutorProfiler::is_enabled) {
+        software_manager.get_profile(
+            hardware_manager.find_profile(software_manager.get()), profile);
+    }
     go_to_text_y();
     SPDLOG_TRACE("Successfully opened the editor");
 }
@@ -19,6 +25,7 @@ void TextEditor::open() {
 void TextEditor::close() {
     SPDLOG_DEBUG("Closing the text editor");
     software_manager.add_lines(lines);
+    profile.clear();
 
     reset();
     SPDLOG_INFO("The text editor closed successfully");
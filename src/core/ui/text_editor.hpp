@@ -3,13 +3,20 @@
 #include <string>
 #include <vector>
 
+#include "hardware/profiler.hpp"
+
 class SoftwareManager;
+struct HardwareManager;
 
 struct TextEditor {
     SoftwareManager& software_manager;
+    HardwareManager const& hardware_manager;
     std::vector<std::string> lines;
+    // counts of the lines as they were when the editor opened - empty unless
+    // the build profiles the programs
+    std::vector<ProfileLine> profile;
 
-    TextEditor(SoftwareManager&);
+    TextEditor(SoftwareManager&, HardwareManager const&);
     void open();
     void close();
     void go_to_text_x();
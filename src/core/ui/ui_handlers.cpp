@@ -62,6 +62,17 @@ void CreateAntHandler::operator()(KeyboardEvent const&) {
     entity_manager.create_ant(hardware_manager, software_manager);
 }
 
+ReprogramAntsHandler::ReprogramAntsHandler(EntityManager& entity_manager,
+                                           HardwareManager& hardware_manager,
+                                           SoftwareManager& software_manager)
+    : entity_manager(entity_manager),
+      hardware_manager(hardware_manager),
+      software_manager(software_manager) {}
+
+void ReprogramAntsHandler::operator()(KeyboardEvent const&) {
+    entity_manager.reprogram_level(hardware_manager, software_manager);
+}
+
 ReloadGameHandler::ReloadGameHandler(bool& is_reload_game)
     : is_reload_game(is_reload_game) {}
 
@@ -70,6 +70,19 @@ class CreateAntHandler : public Subscriber<KeyboardEvent> {
     void operator()(KeyboardEvent const&);
 };
 
+class ReprogramAntsHandler : public Subscriber<KeyboardEvent> {
+    EntityManager& entity_manager;
+    HardwareManager& hardware_manager;
+    SoftwareManager& software_manager;
+
+   public:
+    ReprogramAntsHandler(EntityManager& entity_manager,
+                         HardwareManager& hardware_manager,
+                         SoftwareManager& software_manager);
+
+    void operator()(KeyboardEvent const&);
+};
+
 class ReloadGameHandler : public Subscriber<KeyboardEvent> {
    public:
     ReloadGameHandler(bool& is_reload_game);
@@ -0,0 +1,55 @@
+#include "utils/random.hpp"
+
+#include <utility>
+
+namespace {
+    constexpr uint32_t round_multiplier0 = 0xD2511F53;
+    constexpr uint32_t round_multiplier1 = 0xCD9E8D57;
+    constexpr uint32_t key_increment0 = 0x9E3779B9;  // golden ratio
+    constexpr uint32_t key_increment1 = 0xBB67AE85;  // sqrt(3) - 1
+    constexpr int num_rounds = 10;
+}  // namespace
+
+Philox::Counter Philox::generate(Counter counter, Key key) {
+    for(int round = 0; round < num_rounds; ++round) {
+        uint64_t const product0 =
+            static_cast<uint64_t>(round_multiplier0) * counter[0];
+        uint64_t const product1 =
+            static_cast<uint64_t>(round_multiplier1) * counter[2];
+        counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                   static_cast<uint32_t>(product1),
+                   static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                   static_cast<uint32_t>(product0)};
+        key[0] += key_increment0;
+        key[1] += key_increment1;
+    }
+    return counter;
+}
+
+CounterRandom::CounterRandom(ulong seed, ulong stream, ulong position)
+    : key{static_cast<uint32_t>(seed),
+          static_cast<uint32_t>(seed >> 32) ^
+              static_cast<uint32_t>(position >> 32)},
+      counter{0, static_cast<uint32_t>(position),
+              static_cast<uint32_t>(stream),
+              static_cast<uint32_t>(stream >> 32)} {}
+
+CounterRandom::result_type CounterRandom::operator()() {
+    if(used == block.size()) {
+        block = Philox::generate(counter, key);
+        ++counter[0];
+        used = 0;
+    }
+    return block[used++];
+}
+
+ulong CounterRandom::below(ulong bound) {
+    // the high word of the 128 bit product of a 64 bit draw and the bound
+    ulong const draw = static_cast<ulong>((*this)()) << 32 | (*this)();
+    return static_cast<unsigned __int128>(draw) * bound >> 64;
+}
+
+long CounterRandom::get_int(long min, long max) {
+    if(max < min) std::swap(min, max);
+    return min + static_cast<long>(below(max - min + 1));
+}
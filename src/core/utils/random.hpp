@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+using ulong = unsigned long;
+
+// Philox4x32-10 from "Parallel random numbers: as easy as 1, 2, 3" (Salmon et
+// al.). A block of four words is a pure function of the counter and the key,
+// so there is no state to share between threads.
+namespace Philox {
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    Counter generate(Counter counter, Key key);
+}  // namespace Philox
+
+// The random numbers of one stream - an ant or a section of the map - at one
+// position such as the tick. The numbers only depend on the seed, the stream
+// and the position, so streams can be drawn on any thread in any order and a
+// run is reproduced from its seed.
+class CounterRandom {
+    Philox::Key key;
+    Philox::Counter counter;  // the first word counts the blocks drawn
+    Philox::Counter block = {};
+    unsigned used = 4;  // words of the block handed out
+
+   public:
+    // satisfies UniformRandomBitGenerator so it works with std::shuffle
+    using result_type = uint32_t;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    CounterRandom(ulong seed, ulong stream, ulong position);
+
+    result_type operator()();
+    // uniform in [0, bound) - bound has to be positive
+    ulong below(ulong bound);
+    // uniform in [min, max] - the bounds are swapped if max is below min
+    long get_int(long min, long max);
+};
@@ -1,3 +0,0 @@
-#include "thread_pool.hpp"
-
-std::mutex globals::threadpool_mutex;
@@ -3,144 +3,190 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
-#include <chrono>
-#include <ctime>
+#include <condition_variable>
+#include <cstddef>
 #include <deque>
 #include <list>
 #include <mutex>
+#include <new>
 #include <optional>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
-#include "app/globals.hpp"
 #include "spdlog/spdlog.h"
 
 using ulong = unsigned long;
 
+// A job deque owned by one thread. The owner pops from the back so it keeps
+// working on what it was handed last, other threads steal from the front.
 template <class ThreadTask>
-class ThreadWork {
-    std::atomic_bool& is_working;
-    std::atomic_bool const& threadpool_active;
-    std::atomic_bool running_task;
-    std::deque<ThreadTask>& pending_jobs;
-    std::optional<ThreadTask> active_task;
-    // TODO: consolidate counts into one for just the number of unfinished jobs
-    std::atomic_ullong& pending_jobs_count;
-    std::atomic_ullong& active_worker_count;
+class WorkQueue {
+    std::mutex mutex;
+    std::deque<ThreadTask> jobs;
 
    public:
-    explicit ThreadWork(std::atomic_bool& is_working,
-                        std::atomic_bool const& threadpool_active,
-                        std::deque<ThreadTask>& pending_jobs,
-                        std::atomic_ullong& pending_jobs_count,
-                        std::atomic_ullong& active_worker_count)
-        : is_working(is_working),
-          threadpool_active(threadpool_active),
-          running_task(false),
-          pending_jobs(pending_jobs),
-          active_task(),
-          pending_jobs_count(pending_jobs_count),
-          active_worker_count(active_worker_count) {}
-
-    void operator()() {
-        std::chrono::nanoseconds initial_backoff(10);
-        std::chrono::nanoseconds max_backoff(1000);
-        std::chrono::nanoseconds backoff(initial_backoff);
-        while(threadpool_active) {
-            {
-                std::scoped_lock lock(globals::threadpool_mutex);
-                if(!pending_jobs.empty()) {
-                    active_task.emplace(std::move(pending_jobs.front()));
-                    pending_jobs.pop_front();
-                    ++active_worker_count;
-                    --pending_jobs_count;
-                    SPDLOG_TRACE("Threadwork acquired task");
-                    backoff = initial_backoff;
-                }
-            }
-            if(active_task.has_value()) {
-                running_task = true;
-                active_task->run();
-                --active_worker_count;
-                running_task = false;
-                active_task.reset();  // Clear the active task after it's done
-            } else {
-                std::this_thread::sleep_for(backoff);
-                backoff *= 2;
-                if(backoff > max_backoff) backoff = max_backoff;
-            }
-        }
+    void push(ThreadTask&& task) {
+        std::scoped_lock lock(mutex);
+        jobs.push_back(std::move(task));
+    }
+
+    std::optional<ThreadTask> pop() {
+        std::scoped_lock lock(mutex);
+        if(jobs.empty()) return std::nullopt;
+        std::optional<ThreadTask> task(std::move(jobs.back()));
+        jobs.pop_back();
+        return task;
+    }
+
+    std::optional<ThreadTask> steal() {
+        std::scoped_lock lock(mutex);
+        if(jobs.empty()) return std::nullopt;
+        std::optional<ThreadTask> task(std::move(jobs.front()));
+        jobs.pop_front();
+        return task;
     }
 };
 
-class ThreadWorker {
-    std::atomic_bool _is_working;
-    std::thread _thread;
+// Any trivially copyable job with a run() member, stored inline so one pool
+// can run the different jobs of a tick on the same threads without an
+// allocation per job
+class PoolJob {
+    static constexpr ulong capacity = 48;
+    alignas(std::max_align_t) unsigned char storage[capacity];
+    void (*run_job)(void*);
 
    public:
-    template <class ThreadTask>
-    ThreadWorker(std::atomic_bool const& threadpool_active,
-                 std::deque<ThreadTask>& pending_jobs,
-                 std::atomic_ullong& pending_jobs_count,
-                 std::atomic_ullong& active_worker_count)
-        : _is_working(false), _thread([&]() {
-              ThreadWork<ThreadTask> thread_work(
-                  _is_working, threadpool_active, pending_jobs,
-                  pending_jobs_count, active_worker_count);
-              thread_work();
-          }) {}
-
-    bool is_working() const { return _is_working; }
-
-    ~ThreadWorker() {
-        if(_thread.joinable()) {
-            _thread.join();
-        }
+    template <class Job>
+    PoolJob(Job const& job) {
+        static_assert(sizeof(Job) <= capacity, "job does not fit a PoolJob");
+        static_assert(std::is_trivially_copyable_v<Job>,
+                      "a PoolJob is copied byte by byte");
+        new(storage) Job(job);
+        run_job = [](void* stored) { static_cast<Job*>(stored)->run(); };
     }
 
-    // Delete the copy constructor and copy assignment operator
-    ThreadWorker(const ThreadWorker&) = delete;
-    ThreadWorker& operator=(const ThreadWorker&) = delete;
+    void run() { run_job(storage); }
 };
 
+// Jobs are spread over one queue per thread. Idle threads steal from the other
+// queues and park on a condition variable once every queue is empty. Parked
+// threads are woken when the batch is awaited rather than on every submit, and
+// the thread calling await_jobs runs jobs as well until the batch is finished.
 template <class ThreadTask>
 class ThreadPool {
-    std::list<ThreadWorker> workers;
-    std::deque<ThreadTask> pending_jobs;
+    std::vector<WorkQueue<ThreadTask>> queues;  // last queue is the caller's
+    std::list<std::thread> workers;
     std::atomic_bool is_active;
-    std::atomic_ullong pending_jobs_count;
-    std::atomic_ullong active_worker_count;
+    std::atomic_ulong unfinished_jobs;  // submitted but not finished
+    ulong next_queue = 0;               // round robin for submit_job
+
+    // parking for idle workers and the thread waiting in await_jobs
+    std::mutex park_mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_finished;
+    std::atomic_ulong work_generation;  // bumped on every submission
+    std::atomic_ulong parked_workers;
 
    public:
-    ThreadPool(ulong number_threads)
-        : workers(),
-          pending_jobs(),
+    // number_threads includes the thread calling await_jobs, so 1 runs every
+    // job on the calling thread
+    explicit ThreadPool(ulong number_threads)
+        : queues(std::max(number_threads, 1UL)),
           is_active(true),
-          pending_jobs_count(),
-          active_worker_count() {
-        for(ulong i = 0; i < number_threads; ++i) {
-            workers.emplace_back(is_active, pending_jobs, pending_jobs_count,
-                                 active_worker_count);
+          unfinished_jobs(0),
+          work_generation(0),
+          parked_workers(0) {
+        for(ulong i = 0; i + 1 < queues.size(); ++i) {
+            workers.emplace_back([this, i]() { work(i); });
         }
+        SPDLOG_DEBUG("Thread pool created - threads: {}", queues.size());
     }
 
     // Delete the copy constructor and copy assignment operator
     ThreadPool(const ThreadPool<ThreadTask>&) = delete;
     ThreadPool& operator=(const ThreadPool<ThreadTask>&) = delete;
 
-    void await_jobs() const {
-        while(active_worker_count > 0 || pending_jobs_count > 0) {
-            /*do nothing */
-        }
+    ulong num_threads() const { return queues.size(); }
+
+    // the job is converted to the pool's task type - see PoolJob
+    template <class Job>
+    void submit_job(Job& job) {
+        ++unfinished_jobs;
+        queues[next_queue].push(ThreadTask(std::move(job)));
+        next_queue = (next_queue + 1) % queues.size();
+        ++work_generation;
     }
 
-    void submit_job(ThreadTask& task) {
-        ++pending_jobs_count;
-        std::scoped_lock lock(globals::threadpool_mutex);
-        pending_jobs.push_back(std::move(task));
+    // Blocks until every submitted job has finished. The calling thread takes
+    // part in running the jobs.
+    void await_jobs() {
+        ulong const caller_idx = queues.size() - 1;
+        if(parked_workers > 0) {
+            // a parked worker holds the lock until it is waiting
+            std::scoped_lock lock(park_mutex);
+            work_available.notify_all();
+        }
+        while(unfinished_jobs > 0) {
+            std::optional<ThreadTask> task = find_task(caller_idx);
+            if(task.has_value()) {
+                run(*task);
+                continue;
+            }
+            // the remaining jobs are running on the workers
+            std::unique_lock lock(park_mutex);
+            work_finished.wait(lock, [this]() { return unfinished_jobs == 0; });
+        }
     }
 
     ~ThreadPool() {
-        is_active = false;
-        assert(pending_jobs.empty());
+        {
+            std::scoped_lock lock(park_mutex);
+            is_active = false;
+        }
+        work_available.notify_all();
+        for(std::thread& worker : workers) worker.join();
+        assert(unfinished_jobs == 0);
+    }
+
+   private:
+    // own queue first then steal from the others
+    std::optional<ThreadTask> find_task(ulong queue_idx) {
+        std::optional<ThreadTask> task = queues[queue_idx].pop();
+        if(task.has_value()) return task;
+        for(ulong i = 1; i < queues.size(); ++i) {
+            std::optional<ThreadTask> stolen =
+                queues[(queue_idx + i) % queues.size()].steal();
+            if(stolen.has_value()) return stolen;
+        }
+        return std::nullopt;
+    }
+
+    void run(ThreadTask& task) {
+        task.run();
+        if(--unfinished_jobs == 0) {
+            std::scoped_lock lock(park_mutex);
+            work_finished.notify_all();
+        }
+    }
+
+    void work(ulong queue_idx) {
+        while(is_active) {
+            ulong const generation = work_generation;
+            std::optional<ThreadTask> task = find_task(queue_idx);
+            if(task.has_value()) {
+                SPDLOG_TRACE("Thread {} acquired task", queue_idx);
+                run(*task);
+                continue;
+            }
+
+            // park until a job is submitted after the queues were checked
+            std::unique_lock lock(park_mutex);
+            ++parked_workers;
+            work_available.wait(lock, [&]() {
+                return !is_active || work_generation != generation;
+            });
+            --parked_workers;
+        }
     }
 };
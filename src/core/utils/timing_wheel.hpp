@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+using ulong = unsigned long;
+
+// Hierarchical timing wheel over a tick counter. Level 0 has a slot per tick
+// and each level above has a slot per full turn of the level below. An entry
+// waits in the lowest level whose current turn contains its due tick and
+// drops down a level whenever the wheel turns onto its slot, so a tick only
+// visits the entries that are due and the ones cascading down.
+template <class T>
+class TimingWheel {
+    static constexpr ulong SLOT_BITS = 6;
+    static constexpr ulong NUM_SLOTS = 1UL << SLOT_BITS;
+    static constexpr ulong NUM_LEVELS = 3;  // 2^18 ticks ahead
+
+    struct Entry {
+        ulong due;
+        T value;
+    };
+    using Slot = std::vector<Entry>;
+
+    std::array<std::array<Slot, NUM_SLOTS>, NUM_LEVELS> levels;
+    Slot cascading;  // reused so cascading does not allocate
+    ulong current = 0;
+    ulong count = 0;
+
+    // entries further ahead than the top level can see wait a full turn of
+    // it and are placed again
+    void insert(Entry const& entry) {
+        ulong const highest_bit = std::bit_width((entry.due ^ current) | 1) - 1;
+        ulong const level = std::min(highest_bit / SLOT_BITS, NUM_LEVELS - 1);
+        ulong const slot = (entry.due >> (level * SLOT_BITS)) & (NUM_SLOTS - 1);
+        levels[level][slot].push_back(entry);
+    }
+
+    void cascade() {
+        for(ulong level = NUM_LEVELS - 1; level > 0; --level) {
+            ulong const shift = level * SLOT_BITS;
+            if((current & ((1UL << shift) - 1)) != 0) continue;
+
+            std::swap(cascading, levels[level][(current >> shift) &
+                                               (NUM_SLOTS - 1)]);
+            for(Entry const& entry : cascading) insert(entry);
+            cascading.clear();
+        }
+    }
+
+   public:
+    ulong now() const { return current; }
+    size_t size() const { return count; }
+
+    void schedule(ulong due, T value) {
+        assert(due > current);
+        insert(Entry{due, value});
+        ++count;
+    }
+
+    // Turns the wheel forward to tick and appends the values that came due
+    void advance(ulong tick, std::vector<T>& due) {
+        if(count == 0) current = std::max(current, tick);
+        while(current < tick) {
+            ++current;
+            cascade();
+
+            Slot& slot = levels[0][current & (NUM_SLOTS - 1)];
+            for(Entry const& entry : slot) due.push_back(entry.value);
+            count -= slot.size();
+            slot.clear();
+        }
+    }
+};
@@ -6,6 +6,10 @@
 
 int main(int argc, char* argv[]) {
     AntGameFacade core(argc, argv);
+    if(core.is_headless()) {
+        core.run_headless();
+        return 0;
+    }
     while(1) {
         core.update();
     }
@@ -1,12 +1,21 @@
 #include "app/facade.hpp"
 
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 namespace py = pybind11;
 
 PYBIND11_MODULE(ant_core, m){
     m.doc() = "the interface for the core ant engine"; // Optional docstring
 
+    py::class_<ProfileLine>(m, "ProfileLine")
+        .def_readonly("text", &ProfileLine::text)
+        .def_readonly("is_instruction", &ProfileLine::is_instruction)
+        .def_readonly("executed", &ProfileLine::executed)
+        .def_readonly("stalls", &ProfileLine::stalls)
+        .def_readonly("failed", &ProfileLine::failed);
+
     py::class_<AntGameFacade>(m, "AntGameFacade")
         .def(py::init<>())   // our constructor
-        .def("update", &AntGameFacade::update);      // Expose member methods
+        .def("update", &AntGameFacade::update)      // Expose member methods
+        .def("get_profile", &AntGameFacade::get_profile);
 }
\ No newline at end of file